@@ -6,6 +6,10 @@
 #include "lib_funcs.h"
 #include "inc_texts.h"
 #include "lib_puffers.h"
+#include "lib_mailbox.h"
+#include "lib_fiber.h"
+#include "lib_skiplist.h"
+#include "lib_arena.h"
 
 /*
 void cmp_tors_start();
@@ -62,6 +66,11 @@ void cmp_handshake_dtor(handshake_t*);
 #define CMP_DEF_VAR(TYPE, NAME) TYPE* NAME = NULL;
 #define CMP_STAT_DEF_VAR(TYPE, NAME) static TYPE* NAME = NULL;
 
+//polls of a puffer component before its waiting caller sleeps
+#ifndef CMP_PUFFER_WAIT_SPINS
+#define CMP_PUFFER_WAIT_SPINS 128
+#endif
+
 #define CMP_DEF_PUFFER_RECV_WAIT(										 \
 								cmp_name, 								 \
 								cmp_type,								 \
@@ -73,13 +82,11 @@ void cmp_handshake_dtor(handshake_t*);
 	{																	 \
 		CMP_DEF_THIS(cmp_type, cmp_var);								 \
 		datapuffer_t    *puffer = this->puffer;							 \
-		signal_t        *signal = this->signal;							 \
-		bool_t  		 was_empty;										 \
+		uint32_t         key;											 \
+		bool_t  		 is_full;										 \
 																		 \
-		/*CMP_PUFFER_RECV_PROC_WAIT(cmp_name, item_type, puffer, signal,*/ \
-				/*item, puffer->is_empty, was_empty, puffer->is_full);	 */\
-		CMP_PUFFER_RECV_PROC_WAIT(cmp_name, item_type, puffer, signal,   \
-				item, datapuffer_isempty(puffer), was_empty, datapuffer_isfull(puffer));\
+		CMP_PUFFER_RECV_PROC_WAIT(cmp_name, item_type, puffer, this->spin, \
+				this->not_empty, this->not_full, item, key, is_full);	 \
 																		 \
 	}/*#PROC_NAME end*/										 		     \
 
@@ -96,86 +103,109 @@ void cmp_handshake_dtor(handshake_t*);
 		CMP_DEF_THIS(cmp_type, cmp_var);								 \
 		item_type       *result = NULL;									 \
 		datapuffer_t    *puffer = this->puffer;							 \
-		signal_t        *signal = this->signal;							 \
-		bool_t  		 was_full;										 \
+		uint32_t         key;											 \
+		bool_t  		 is_empty;										 \
 																		 \
-		/*CMP_PUFFER_SUPPLY_PROC_WAIT(cmp_name, item_type, puffer, signal,*/ \
-				/*result, puffer->is_empty, puffer->is_full, was_full);*/	 \
-		CMP_PUFFER_SUPPLY_PROC_WAIT(cmp_name, item_type, puffer, signal, \
-				result, datapuffer_isempty(puffer), datapuffer_isfull(puffer), was_full);	 \
+		CMP_PUFFER_SUPPLY_PROC_WAIT(cmp_name, item_type, puffer, this->spin, \
+				this->not_empty, this->not_full, result, key, is_empty); \
 		return result;													 \
 	}/*#PROC_NAME end*/										 		     \
 
 
 
+//The puffer is guarded by the spin lock, the callers wait on eventcounts
+//outside of it. A notify costs nothing while nobody waits.
 #define CMP_PUFFER_SUPPLY_PROC_WAIT(									 	 \
 									name,									 \
 									type, 								 	 \
 									puffer, 								 \
-									signal, 								 \
+									spin,	 								 \
+									not_empty, 								 \
+									not_full, 								 \
 									item,									 \
-									is_empty, 								 \
-									is_full, 								 \
-									was_full								 \
+									key,	 								 \
+									is_empty								 \
 									)										 \
-	signal_lock(signal);											    	 \
-	if(is_empty == BOOL_TRUE){											     \
+	for(;;){															     \
+		spin_lock(spin);											    	 \
+		is_empty = datapuffer_isempty(puffer);							     \
+		if(is_empty == BOOL_FALSE){										     \
+			item = (type*) datapuffer_read(puffer);						  	 \
+		}																     \
+		spin_unlock(spin);     											 	 \
+		if(is_empty == BOOL_FALSE){										     \
+			break;														     \
+		}																     \
 		/*logging("%s is empty", name);*/			 		 	 			 \
-		signal_wait(signal);										     	 \
-	}																	     \
-																		     \
-    was_full = is_full;														 \
-	item = (type*) datapuffer_read(puffer);						  			 \
-																		     \
-	if(was_full == BOOL_TRUE){											     \
-		signal_set(signal);										    		 \
+		key = eventcount_prepare_wait(not_empty);						     \
+		spin_lock(spin);											    	 \
+		is_empty = datapuffer_isempty(puffer);							     \
+		spin_unlock(spin);     											 	 \
+		if(is_empty == BOOL_TRUE){										     \
+			eventcount_commit_wait(not_empty, key);						     \
+		}else{															     \
+			eventcount_cancel_wait(not_empty);							     \
+		}																     \
 	}																	     \
 	/*CMP_SUPPLY(name, item);*/												 \
-	signal_unlock(signal);     												 \
+	eventcount_notify(not_full);										     \
 
 
 #define CMP_PUFFER_RECV_PROC_WAIT(									         \
 								   name,									 \
 								   type, 								     \
 								   puffer, 								     \
-								   signal, 								     \
+								   spin,	 							     \
+								   not_empty, 							     \
+								   not_full, 							     \
 								   item,									 \
-								   is_empty, 						     	 \
-								   was_empty, 							     \
+								   key,	 						     	 	 \
 								   is_full									 \
 								)			 							     \
-	signal_lock(signal);													 \
 	/*CMP_RECEIVE(name, item);*/									 		 \
-	if(is_full == BOOL_TRUE){												 \
+	for(;;){															     \
+		spin_lock(spin);											    	 \
+		is_full = datapuffer_isfull(puffer);							     \
+		if(is_full == BOOL_FALSE){										     \
+			datapuffer_write(puffer, (void*) item);						 	 \
+		}																     \
+		spin_unlock(spin);     											 	 \
+		if(is_full == BOOL_FALSE){										     \
+			break;														     \
+		}																     \
 		runtime_warning("%s is full", name);				 		 	 	 \
-		signal_wait(signal);												 \
-	}																		 \
-		 	 	 	 	 	 	 	 	 	 	 	 	 	 	 	 	     \
-    was_empty = is_empty;													 \
-	datapuffer_write(puffer, (void*) item);								 	 \
-																		     \
-	if(was_empty == BOOL_TRUE){											 	 \
-		signal_set(signal);													 \
-	}																		 \
-																			 \
-	signal_unlock(signal);										     		 \
+		key = eventcount_prepare_wait(not_full);						     \
+		spin_lock(spin);											    	 \
+		is_full = datapuffer_isfull(puffer);							     \
+		spin_unlock(spin);     											 	 \
+		if(is_full == BOOL_TRUE){										     \
+			eventcount_commit_wait(not_full, key);						     \
+		}else{															     \
+			eventcount_cancel_wait(not_full);							     \
+		}																     \
+	}																	     \
+	eventcount_notify(not_empty);										     \
+
 
+//Items passed between components are allocated from the arena of the
+//producing thread and can be disposed by the consuming one.
+#define CMP_ITEM_NEW(TYPE) ARENA_NEW(TYPE)
+#define CMP_ITEM_DISPOSE(ITEM) arena_free(ITEM)
 
+//components are allocated from the arena of the constructing thread
 #define CMP_CTOR_PROC(type, var, name)                      			\
 		PRINTING_CONSTRUCTING_SG(name);									\
 		if(var != NULL){												\
 			runtime_warning("%s is already constructed", name);			\
 			return;														\
 		}																\
-		var = (type*) malloc(sizeof(type));								\
-		BZERO(var, sizeof(type));										\
+		var = ARENA_NEW(type);											\
 		PRINTING_SG_IS_CONSTRUCTED(name);
 
 
 #define CMP_MCTOR_PROC(TYPE, VALUE, CMP_NAME)                      		\
 		PRINTING_CONSTRUCTING_SG(CMP_NAME);								\
-		VALUE = (TYPE*) malloc(sizeof(TYPE));							\
-		BZERO(VALUE, sizeof(TYPE));										\
+		VALUE = ARENA_NEW(TYPE);										\
 		PRINTING_SG_IS_CONSTRUCTED(CMP_NAME);							\
 
 
@@ -222,7 +252,7 @@ void cmp_handshake_dtor(handshake_t*);
 			logging("%s", CMP_NAME" is already destructed or never exists");  \
 			return;														\
 		}																\
-		free(VALUE);													\
+		arena_free(VALUE);												\
 		PRINTING_SG_IS_DESTRUCTED(CMP_NAME);							\
 
 
@@ -336,7 +366,9 @@ void cmp_handshake_dtor(handshake_t*);
 		datapuffer_t* puffer; 												\
 		void         (*receiver)(ITEM_TYPE*); 								\
 		ITEM_TYPE*   (*supplier)(); 										\
-		signal_t      *signal; 												\
+		spin_t       *spin; 												\
+		eventcount_t *not_empty; 											\
+		eventcount_t *not_full; 											\
 	}TYPE_NAME##_t;
 
 
@@ -346,10 +378,10 @@ void cmp_handshake_dtor(handshake_t*);
 		datapuffer_t* puffer; 												\
 		void         (*receiver)(ITEM_TYPE*); 								\
 		ITEM_TYPE*   (*supplier)(); 										\
-		spin_t      *spin; 													\
+		adaptivelock_t *lock; 												\
 	}TYPE_NAME##_t;
 
-//declare and define a puffer component using signals
+//declare and define a puffer component using eventcounts
 #define CMP_DEF_SGPUFFER(DECL_TYPE,											\
 				 ITEM_TYPE,													\
 				 ITEM_DTOR,													\
@@ -384,7 +416,9 @@ void cmp_handshake_dtor(handshake_t*);
 	void CMP_VAR##_init()													\
 	{																		\
 		CMP_VAR->puffer = datapuffer_ctor(PUFFER_LENGTH);					\
-		CMP_VAR->signal = signal_ctor();									\
+		CMP_VAR->spin = spin_ctor();										\
+		CMP_VAR->not_empty = eventcount_ctor(CMP_PUFFER_WAIT_SPINS);		\
+		CMP_VAR->not_full = eventcount_ctor(CMP_PUFFER_WAIT_SPINS);			\
 		CMP_BIND(CMP_VAR->receiver, CMP_VAR##_process_receiver)			    \
 		CMP_BIND(CMP_VAR->supplier, CMP_VAR##_process_supplier)				\
 	}																		\
@@ -394,7 +428,9 @@ void cmp_handshake_dtor(handshake_t*);
 		datapuffer_t*  puffer = CMP_VAR->puffer;							\
 		GEN_PUFF_CLEAR_PROC(puffer, ITEM_TYPE, ITEM_DTOR);					\
 		datapuffer_dtor(CMP_VAR->puffer);									\
-		signal_dtor(CMP_VAR->signal);										\
+		eventcount_dtor(CMP_VAR->not_full);									\
+		eventcount_dtor(CMP_VAR->not_empty);								\
+		spin_dtor(CMP_VAR->spin);											\
 	}																		\
 
 
@@ -432,14 +468,14 @@ void cmp_handshake_dtor(handshake_t*);
         {                                                                                                                                               \
                 CMP_DEF_THIS(CMP_VAR##_t, CMP_VAR);                                                                     \
                 datapuffer_t    *puffer = this->puffer;                                                         \
-                spin_t          *spin = this->spin;                                                                     \
-                spin_lock(spin);                                                                                                        \
+                adaptivelock_t  *lock = this->lock;                                                                     \
+                adaptivelock_lock(lock);                                                                                                \
                                                                                                                                                         \
                 /*CMP_RECEIVE(CMP_NAME, item);  */                                                                      \
                 /*if(puffer->is_full == BOOL_TRUE){                                                               */\
                 if(datapuffer_isfull(puffer) == BOOL_TRUE){                                                     \
                         runtime_warning("%s is full", CMP_NAME);                                                \
-                        spin_unlock(spin);                                                                                      \
+                        adaptivelock_unlock(lock);                                                                              \
                         ITEM_DTOR(item);                                                                                                \
                         return;                                                                                                                 \
                 }                                                                                                                                       \
@@ -447,7 +483,7 @@ void cmp_handshake_dtor(handshake_t*);
                 ITEM_CLEAN(item);                                                                                                       \
                 datapuffer_write(puffer, (void*) item);                                                         \
                                                                                                                                                         \
-                spin_unlock(spin);                                                                                              \
+                adaptivelock_unlock(lock);                                                                                      \
         }/*#PROC_NAME end*/                                                                                                             \
                                                                                                                                                         \
         static ITEM_TYPE* CMP_VAR##_process_supplier()                                                  \
@@ -455,13 +491,13 @@ void cmp_handshake_dtor(handshake_t*);
                 CMP_DEF_THIS(CMP_VAR##_t, CMP_VAR);                                                                     \
                 ITEM_TYPE       *result = NULL;                                                                         \
                 datapuffer_t    *puffer = this->puffer;                                                         \
-                spin_t          *spin = this->spin;                                                                     \
+                adaptivelock_t  *lock = this->lock;                                                                     \
                                                                                                                                                         \
-                spin_lock(spin);                                                                                                \
+                adaptivelock_lock(lock);                                                                                        \
                 /*if(puffer->is_empty == BOOL_TRUE){                                                      */\
             if(datapuffer_isempty(puffer) == BOOL_TRUE){                                                \
                         logging("%s is empty", CMP_NAME);                                                               \
-                        spin_unlock(spin);                                                                                              \
+                        adaptivelock_unlock(lock);                                                                                      \
                         result = ITEM_CTOR();                                                                                   \
                         return result;                                                                                                  \
                 }                                                                                                                                       \
@@ -469,14 +505,14 @@ void cmp_handshake_dtor(handshake_t*);
                 result = (ITEM_TYPE*) datapuffer_read(puffer);                                          \
                                                                                                                                                         \
                 /*CMP_SUPPLY(CMP_NAME, result);*/                                                                       \
-                spin_unlock(spin);                                                                                              \
+                adaptivelock_unlock(lock);                                                                                      \
                 return result;                                                                                                          \
         }/*#PROC_NAME end*/                                                                                                     \
                                                                                                                                                         \
         void CMP_VAR##_init()                                                                                                   \
         {                                                                                                                                               \
                 CMP_VAR->puffer = datapuffer_ctor(PUFFER_LENGTH);                                       \
-                CMP_VAR->spin = spin_ctor();                                                                            \
+                CMP_VAR->lock = adaptivelock_ctor();                                                                    \
                 CMP_BIND(CMP_VAR->receiver, CMP_VAR##_process_receiver)                     \
                 CMP_BIND(CMP_VAR->supplier, CMP_VAR##_process_supplier)                         \
         }                                                                                                                                               \
@@ -486,12 +522,25 @@ void cmp_handshake_dtor(handshake_t*);
                 datapuffer_t*  puffer = CMP_VAR->puffer;                                                        \
                 GEN_PUFF_CLEAR_PROC(puffer, ITEM_TYPE, ITEM_DTOR);                                      \
                 datapuffer_dtor(CMP_VAR->puffer);                                                                       \
-                spin_dtor(CMP_VAR->spin);                                                                                       \
+                adaptivelock_dtor(CMP_VAR->lock);                                                                               \
         }                                                                                                                                               \
 
 
 
 
+//The component of a thread placed on a numa node is constructed with the
+//memory policy of the node, so its buffers are allocated node-locally and
+//the started thread inherits the policy.
+#define CMP_NUMA_ENTER(THREAD)										\
+	if((THREAD)->attrs.numa_node >= 0){								\
+		numa_set_preferred((THREAD)->attrs.numa_node);				\
+	}
+
+#define CMP_NUMA_LEAVE(THREAD)										\
+	if((THREAD)->attrs.numa_node >= 0){								\
+		numa_set_preferred(-1);										\
+	}
+
 #define CMP_THREAD(													\
 				DECL_TYPE,											\
 				CMP_TYPE,											\
@@ -523,10 +572,13 @@ DECL_TYPE void* THR_START_THREAD_PROC_NAME() 						\
 {																	\
 	PRINTING_STARTING_SG(CMP_NAME);									\
 																	\
+	_thr_##CMP_UNIQUE = make_configured_thread(_thr_##CMP_UNIQUE##_entrypoint, NULL, #CMP_UNIQUE); \
+	CMP_NUMA_ENTER(_thr_##CMP_UNIQUE);								\
 	_cmp_##CMP_UNIQUE##_ctor();										\
-	_thr_##CMP_UNIQUE = make_thread(_thr_##CMP_UNIQUE##_entrypoint, _cmp_##CMP_UNIQUE); \
+	_thr_##CMP_UNIQUE->arg = _cmp_##CMP_UNIQUE;						\
 																	\
 	start_thread(_thr_##CMP_UNIQUE);								\
+	CMP_NUMA_LEAVE(_thr_##CMP_UNIQUE);								\
 																	\
 	PRINTING_SG_IS_STARTED(CMP_NAME);								\
 																	\
@@ -549,6 +601,85 @@ DECL_TYPE void* THR_STOP_THREAD_PROC_NAME() 						\
 }																	\
 
 
+//Same as CMP_THREAD, but the main procedure runs as repeated tasks
+//of an executor instead of an own thread. THR_MAIN_PROC_NAME is called
+//once per task, so it must return after a bounded amount of work.
+#define CMP_TASK(													\
+				DECL_TYPE,											\
+				CMP_TYPE,											\
+				CMP_UNIQUE,											\
+				CMP_NAME,											\
+				CMP_INIT_PROC_NAME, 								\
+				CMP_DEINIT_PROC_NAME, 								\
+				THR_START_THREAD_PROC_NAME, 						\
+				THR_STOP_THREAD_PROC_NAME, 							\
+				THR_MAIN_PROC_NAME,									\
+				EXECUTOR											\
+				)													\
+	DECL_TYPE thread_t* _thr_##CMP_UNIQUE = NULL;					\
+	LIB_DEF_TASK(_thr_##CMP_UNIQUE##_entrypoint, 					\
+		   __THR_NO_INIT_PROC__,      								\
+		   THR_MAIN_PROC_NAME,  						 			\
+		   __THR_NO_DEINIT_PROC__         							\
+		  );														\
+	CMP_DEF(DECL_TYPE,												\
+				CMP_TYPE,       									\
+				CMP_NAME,   										\
+				_cmp_##CMP_UNIQUE,									\
+				_cmp_##CMP_UNIQUE##_ctor,           				\
+				_cmp_##CMP_UNIQUE##_dtor,           				\
+				 CMP_INIT_PROC_NAME,              					\
+				 __NO_TEST_FUNC_,             						\
+				 CMP_DEINIT_PROC_NAME               				\
+				);													\
+DECL_TYPE void* THR_START_THREAD_PROC_NAME() 						\
+{																	\
+	PRINTING_STARTING_SG(CMP_NAME);									\
+																	\
+	_cmp_##CMP_UNIQUE##_ctor();										\
+	_thr_##CMP_UNIQUE = thread_ctor();								\
+	setup_thread(_thr_##CMP_UNIQUE, _thr_##CMP_UNIQUE##_entrypoint, _cmp_##CMP_UNIQUE); \
+	_thr_##CMP_UNIQUE->executor = EXECUTOR;							\
+																	\
+	start_thread(_thr_##CMP_UNIQUE);								\
+																	\
+	PRINTING_SG_IS_STARTED(CMP_NAME);								\
+																	\
+	return NULL;													\
+}																	\
+																	\
+DECL_TYPE void* THR_STOP_THREAD_PROC_NAME() 						\
+{																	\
+	CMP_TYPE *cmp = _cmp_##CMP_UNIQUE;								\
+	thread_t *thread = _thr_##CMP_UNIQUE;							\
+	PRINTING_STOPPING_SG(CMP_NAME);									\
+																	\
+	if(!stop_thread(thread)){										\
+		/*the task may still run, its memory is left allocated*/	\
+		WARNINGPRINT("Task is not stopped, it is not disposed");	\
+	}else{															\
+		thread_dtor(thread);										\
+		_cmp_##CMP_UNIQUE##_dtor(cmp);								\
+	}																\
+	_thr_##CMP_UNIQUE = NULL;										\
+	_cmp_##CMP_UNIQUE = NULL;										\
+	PRINTING_SG_IS_STOPPED(CMP_NAME);								\
+																	\
+	return NULL;													\
+}																	\
+
+
+//Items received by a push threader wait in a mailbox of this size, the
+//receiver blocks only if it is full. The thread sends at most
+//CMP_PUSH_THREADER_BATCH items per wakeup.
+#ifndef CMP_PUSH_THREADER_MAILBOX_SIZE
+#define CMP_PUSH_THREADER_MAILBOX_SIZE 256
+#endif
+#ifndef CMP_PUSH_THREADER_BATCH
+#define CMP_PUSH_THREADER_BATCH 32
+#endif
+#define CMP_PUSH_THREADER_IDLE_WAIT_MS 100
+
 #define CMP_PUSH_THREADER(											\
 				ITEM_TYPE,											\
 				CMP_UNIQUE,											\
@@ -559,10 +690,11 @@ DECL_TYPE void* THR_STOP_THREAD_PROC_NAME() 						\
 																	\
 typedef struct _cmp_##CMP_UNIQUE##_struct_t							\
 {																	\
-	signal_t *signal;												\
-	void     (*receiver)(ITEM_TYPE*);								\
-	ITEM_TYPE* item;												\
-	void     (*send)(ITEM_TYPE*);									\
+	eventcount_t    *ready;           /*wakes the sleeping thread*/	\
+	eventcount_t    *space;           /*wakes receivers of a full mailbox*/ \
+	void           (*receiver)(ITEM_TYPE*);							\
+	mailbox_t       *mailbox;										\
+	void           (*send)(ITEM_TYPE*);								\
 }_cmp_##CMP_UNIQUE##_t;												\
 static void _cmp_##CMP_UNIQUE##_receiver(ITEM_TYPE*);				\
 static void _cmp_##CMP_UNIQUE##_init();								\
@@ -583,34 +715,67 @@ CMP_THREAD(															\
 void _cmp_##CMP_UNIQUE##_init()										\
 {																	\
 	CMP_DEF_THIS(_cmp_##CMP_UNIQUE##_t, _cmp_##CMP_UNIQUE);			\
-	this->signal = signal_ctor();									\
-	this->item = NULL;												\
+	this->ready = eventcount_ctor(CMP_PUFFER_WAIT_SPINS);			\
+	this->space = eventcount_ctor(0);								\
+	this->mailbox = make_mailbox(CMP_PUSH_THREADER_MAILBOX_SIZE);	\
 	CMP_BIND(_cmp_##CMP_UNIQUE->receiver, _cmp_##CMP_UNIQUE##_receiver); \
 }																	\
 void _cmp_##CMP_UNIQUE##_deinit()									\
 {																	\
 	CMP_DEF_THIS(_cmp_##CMP_UNIQUE##_t, _cmp_##CMP_UNIQUE);			\
-	signal_dtor(this->signal);										\
+	mailbox_dtor(this->mailbox);									\
+	eventcount_dtor(this->space);									\
+	eventcount_dtor(this->ready);									\
 }																	\
 void _cmp_##CMP_UNIQUE##_receiver(ITEM_TYPE *item)					\
 {																	\
 	CMP_DEF_THIS(_cmp_##CMP_UNIQUE##_t, _cmp_##CMP_UNIQUE);			\
-	signal_lock(this->signal);										\
-	this->item = item;												\
-	signal_set(this->signal);										\
-	signal_unlock(this->signal);									\
+	while(!mailbox_post(this->mailbox, item)){						\
+		/*nothing empties the mailbox once the thread is stopped*/	\
+		if(_thr_##CMP_UNIQUE == NULL ||								\
+		   (_thr_##CMP_UNIQUE->state != THREAD_STATE_STARTED &&		\
+		    _thr_##CMP_UNIQUE->state != THREAD_STATE_RUN)){			\
+			WARNINGPRINT("%s is not running, the item is dropped", CMP_NAME); \
+			return;													\
+		}															\
+		eventcount_commit_timedwait(this->space,					\
+				eventcount_prepare_wait(this->space), 1);			\
+	}																\
+	eventcount_notify(this->ready);									\
+}																	\
+static void _thr_##CMP_UNIQUE##_send_all(_cmp_##CMP_UNIQUE##_t *this, bool_t once) \
+{																	\
+	ITEM_TYPE *items[CMP_PUSH_THREADER_BATCH];						\
+	int32_t    index, num;											\
+	do{																\
+		num = mailbox_fetch_batch(this->mailbox, (ptr_t*) items, CMP_PUSH_THREADER_BATCH); \
+		if(num > 0){												\
+			eventcount_notify_all(this->space);						\
+		}															\
+		for(index = 0; index < num; ++index){						\
+			this->send(items[index]);								\
+		}															\
+	}while(!once && num > 0);										\
 }																	\
 void _thr_##CMP_UNIQUE##_main_proc(thread_t *thread)				\
 {																	\
 	CMP_DEF_THIS(_cmp_##CMP_UNIQUE##_t, (_cmp_##CMP_UNIQUE##_t*) thread->arg);		\
+	uint32_t key;													\
 	do																\
 	{																\
-		signal_lock(this->signal);									\
-		signal_wait(this->signal);									\
-		/*CMP_SEND(CMP_NAME, this->send, this->item);*/				\
-		this->send(this->item);										\
-		signal_unlock(this->signal);								\
+		if(!mailbox_is_empty(this->mailbox)){						\
+			_thr_##CMP_UNIQUE##_send_all(this, BOOL_TRUE);			\
+			continue;												\
+		}															\
+		key = eventcount_prepare_wait(this->ready);					\
+		if(mailbox_is_empty(this->mailbox)){						\
+			eventcount_commit_timedwait(this->ready, key, CMP_PUSH_THREADER_IDLE_WAIT_MS); \
+		}else{														\
+			eventcount_cancel_wait(this->ready);					\
+		}															\
 	}while(thread->state == THREAD_STATE_RUN);						\
+	/*items received before the stop are still passed on*/			\
+	_thr_##CMP_UNIQUE##_send_all(this, BOOL_FALSE);					\
 }																	\
 
 
@@ -645,7 +810,7 @@ void _thr_##CMP_UNIQUE##_main_proc(thread_t *thread)				\
 			);														\
 typedef struct _thrs_##CMP_UNIQUE##_struct_t						\
 {																	\
-	thread_t*      threads[NTRT_MAX_THREAD_NUM];						\
+	thread_t*      threads[PROGRAM_MAX_THREAD_NUM];						\
 	rwmutex_t*     rwmutex;											\
 }_thrs_##CMP_UNIQUE##_t;											\
 																	\
@@ -654,7 +819,7 @@ DECL_TYPE void CHAIN_CTOR_PROC_NAME()								\
 {																	\
 	int32_t  index;													\
 	_thrs_##CMP_UNIQUE.rwmutex = rwmutex_ctor();					\
-	for(index = 0; index < NTRT_MAX_THREAD_NUM; ++index){			\
+	for(index = 0; index < PROGRAM_MAX_THREAD_NUM; ++index){			\
 		_thrs_##CMP_UNIQUE.threads[index] = NULL;					\
 	}																\
 }																	\
@@ -691,9 +856,9 @@ DECL_TYPE void _wrunlock_##CMP_UNIQUE()								\
 DECL_TYPE bool_t CHAIN_ITR_PROC_NAME(int32_t* index, thread_t **thread) \
 {																	\
 	*thread = NULL;													\
-	for(; *index < NTRT_MAX_THREAD_NUM								\
+	for(; *index < PROGRAM_MAX_THREAD_NUM								\
 		&& _thrs_##CMP_UNIQUE.threads[*index] == NULL; ++(*index)); \
-	if(*index == NTRT_MAX_THREAD_NUM){								\
+	if(*index == PROGRAM_MAX_THREAD_NUM){								\
 		return BOOL_FALSE;											\
 	}																\
 	*thread = _thrs_##CMP_UNIQUE.threads[*index];					\
@@ -712,16 +877,25 @@ DECL_TYPE void* THR_START_THREAD_PROC_NAME(THR_ACTIVATOR_TYPE *activator) 	\
 	thread_t *thread;												\
 	PRINTING_STARTING_SG(CMP_NAME);									\
 																	\
+	thread = make_configured_thread(_thr_##CMP_UNIQUE##_entrypoint, NULL, #CMP_UNIQUE); \
+	CMP_NUMA_ENTER(thread);											\
 	cmp = _cmp_##CMP_UNIQUE##_ctor();								\
-	thread = make_thread(_thr_##CMP_UNIQUE##_entrypoint, cmp);		\
+	thread->arg = cmp;												\
 	cmp->CMP_ACTIVATOR_ATTR = activator;							\
-	_rdlock_##CMP_UNIQUE();											\
-	for(index = 0; _thrs_##CMP_UNIQUE.threads[index] != NULL; ++index); \
-	_rdunlock_##CMP_UNIQUE();										\
 	_wrlock_##CMP_UNIQUE();											\
+	for(index = 0; index < PROGRAM_MAX_THREAD_NUM					\
+		&& _thrs_##CMP_UNIQUE.threads[index] != NULL; ++index);		\
+	if(index == PROGRAM_MAX_THREAD_NUM){							\
+		_wrunlock_##CMP_UNIQUE();									\
+		runtime_warning("No more instance of %s can be started", CMP_NAME); \
+		CMP_NUMA_LEAVE(thread);										\
+		_cmp_##CMP_UNIQUE##_dtor(cmp);								\
+		return NULL;												\
+	}																\
 	_thrs_##CMP_UNIQUE.threads[index] = thread;						\
 	_wrunlock_##CMP_UNIQUE();										\
 	start_thread(thread);											\
+	CMP_NUMA_LEAVE(thread);											\
 																	\
 	PRINTING_SG_IS_STARTED(CMP_NAME);								\
 																	\
@@ -743,6 +917,7 @@ DECL_TYPE void* THR_STOP_THREAD_PROC_NAME(THR_ACTIVATOR_TYPE *activator) 		\
 		if(cmp->CMP_ACTIVATOR_ATTR == activator){break;}			\
 	}																\
 	if(thread == NULL){												\
+		_wrunlock_##CMP_UNIQUE();									\
 		runtime_warning("Didn't find component for activator %p",	\
 						activator);  								\
 		return NULL; 												\
@@ -758,4 +933,327 @@ DECL_TYPE void* THR_STOP_THREAD_PROC_NAME(THR_ACTIVATOR_TYPE *activator) 		\
 }																	\
 
 
+//Runs between the minimum and the maximum number of workers of SCALER as
+//instances of the component, all serving the same queue. A supervisor thread
+//calls DEPTH_PROC_NAME(), which returns the number of items waiting in the
+//queue, in every period of the scaler and starts or retires instances as
+//threadscaler_sample() decides. THR_MAIN_PROC_NAME(thread_t*) returns once
+//the state of its thread is not THREAD_STATE_RUN, so a retired instance
+//stops after its current item, and it may pass the time it spent on an item
+//to threadscaler_report(). An instance retired while it waits for items is
+//taken back if workers are needed again before it stopped.
+#define CMP_THREADS_AUTOSCALE_JOIN_MS 1000
+#define CMP_THREADS_AUTOSCALE(										\
+				DECL_TYPE,											\
+				CMP_TYPE,											\
+				CMP_UNIQUE,											\
+				CMP_NAME,											\
+				THR_INIT_PROC_NAME, 								\
+				CMP_INIT_PROC_NAME,									\
+				THR_DEINIT_PROC_NAME,								\
+				CMP_DEINIT_PROC_NAME, 								\
+				THR_MAIN_PROC_NAME,									\
+				DEPTH_PROC_NAME,									\
+				THR_START_PROC_NAME, 								\
+				THR_STOP_PROC_NAME 									\
+				)													\
+	CMP_MDEF(DECL_TYPE,												\
+			CMP_TYPE,       									  	\
+			CMP_NAME,   										    \
+			_cmp_##CMP_UNIQUE##_ctor,           					\
+			_cmp_##CMP_UNIQUE##_dtor,           					\
+			 CMP_INIT_PROC_NAME,              						\
+			 __NO_TEST_FUNC_,             							\
+			 CMP_DEINIT_PROC_NAME               					\
+			);														\
+typedef struct _scaled_##CMP_UNIQUE##_struct_t						\
+{																	\
+	thread_t*       workers[PROGRAM_MAX_THREAD_NUM];				\
+	int32_t         workers_num;									\
+	thread_t*       retired[PROGRAM_MAX_THREAD_NUM];   /*asked to stop, not disposed yet*/ \
+	int32_t         retired_num;									\
+	threadscaler_t* scaler;											\
+	thread_t*       supervisor;										\
+	eventcount_t*   wakeup;          /*ends the wait of the supervisor*/ \
+}_scaled_##CMP_UNIQUE##_t;											\
+																	\
+static _scaled_##CMP_UNIQUE##_t _scaled_##CMP_UNIQUE;				\
+																	\
+LIB_DEF_THREAD(_thr_##CMP_UNIQUE##_entrypoint, 						\
+		   THR_INIT_PROC_NAME,      								\
+		   THR_MAIN_PROC_NAME,  						 			\
+		   THR_DEINIT_PROC_NAME         							\
+		  );														\
+																	\
+static void _scaled_##CMP_UNIQUE##_dispose(thread_t *thread)		\
+{																	\
+	CMP_TYPE *cmp = (CMP_TYPE*) thread->arg;						\
+	dmap_wrlock_table_thr();										\
+	dmap_rem_thr(thread);											\
+	dmap_wrunlock_table_thr();										\
+	_cmp_##CMP_UNIQUE##_dtor(cmp);									\
+}																	\
+																	\
+static void _scaled_##CMP_UNIQUE##_grow()							\
+{																	\
+	_scaled_##CMP_UNIQUE##_t *this = &_scaled_##CMP_UNIQUE;			\
+	thread_t *thread;												\
+	if(this->retired_num && __sync_bool_compare_and_swap(			\
+			&this->retired[this->retired_num - 1]->state,			\
+			THREAD_STATE_STOP, THREAD_STATE_RUN)){					\
+		this->workers[this->workers_num++] = this->retired[--this->retired_num]; \
+		return;														\
+	}																\
+	if(this->workers_num + this->retired_num == PROGRAM_MAX_THREAD_NUM){ \
+		runtime_warning("No more instance of %s can be started", CMP_NAME); \
+		return;														\
+	}																\
+	thread = make_configured_thread(_thr_##CMP_UNIQUE##_entrypoint, NULL, #CMP_UNIQUE); \
+	CMP_NUMA_ENTER(thread);											\
+	thread->arg = _cmp_##CMP_UNIQUE##_ctor();						\
+	start_thread(thread);											\
+	CMP_NUMA_LEAVE(thread);											\
+	this->workers[this->workers_num++] = thread;					\
+}																	\
+																	\
+static void _scaled_##CMP_UNIQUE##_shrink()							\
+{																	\
+	_scaled_##CMP_UNIQUE##_t *this = &_scaled_##CMP_UNIQUE;			\
+	thread_t *thread;												\
+	int32_t   index;												\
+	for(index = this->workers_num - 1; 0 <= index					\
+		&& this->workers[index]->state != THREAD_STATE_RUN; --index); \
+	if(index < 0){													\
+		return;														\
+	}																\
+	thread = this->workers[index];									\
+	this->workers[index] = this->workers[--this->workers_num];		\
+	retire_thread(thread);											\
+	this->retired[this->retired_num++] = thread;					\
+}																	\
+																	\
+/*disposes the instances whose thread has exited*/					\
+static void _scaled_##CMP_UNIQUE##_reap(thread_t **threads, int32_t *threads_num) \
+{																	\
+	thread_t *thread;												\
+	int32_t   index;												\
+	for(index = 0; index < *threads_num; ){							\
+		thread = threads[index];									\
+		if(!thread_tryjoin(thread)){								\
+			++index;												\
+			continue;												\
+		}															\
+		threads[index] = threads[--(*threads_num)];					\
+		_scaled_##CMP_UNIQUE##_dispose(thread);						\
+	}																\
+}																	\
+																	\
+static void _scaled_##CMP_UNIQUE##_supervise(thread_t *thread)		\
+{																	\
+	_scaled_##CMP_UNIQUE##_t *this = &_scaled_##CMP_UNIQUE;			\
+	int32_t change;													\
+	uint32_t key;													\
+	while(thread->state == THREAD_STATE_RUN){						\
+		key = eventcount_prepare_wait(this->wakeup);				\
+		if(thread->state == THREAD_STATE_RUN){						\
+			eventcount_commit_timedwait(this->wakeup, key, this->scaler->period_ms); \
+		}else{														\
+			eventcount_cancel_wait(this->wakeup);					\
+		}															\
+		if(thread->state != THREAD_STATE_RUN){						\
+			break;													\
+		}															\
+		_scaled_##CMP_UNIQUE##_reap(this->retired, &this->retired_num); \
+		_scaled_##CMP_UNIQUE##_reap(this->workers, &this->workers_num); \
+		change = threadscaler_sample(this->scaler, this->workers_num, DEPTH_PROC_NAME()); \
+		for(; 0 < change; --change){								\
+			_scaled_##CMP_UNIQUE##_grow();							\
+		}															\
+		for(; change < 0; ++change){								\
+			_scaled_##CMP_UNIQUE##_shrink();						\
+		}															\
+	}																\
+}																	\
+																	\
+LIB_DEF_THREAD(_thr_##CMP_UNIQUE##_supervisor, 						\
+		   __THR_NO_INIT_PROC__,      								\
+		   _scaled_##CMP_UNIQUE##_supervise,  						\
+		   __THR_NO_DEINIT_PROC__         							\
+		  );														\
+																	\
+DECL_TYPE void* THR_START_PROC_NAME(threadscaler_t *scaler) 		\
+{																	\
+	_scaled_##CMP_UNIQUE##_t *this = &_scaled_##CMP_UNIQUE;			\
+	PRINTING_STARTING_SG(CMP_NAME);									\
+	if(this->supervisor != NULL){									\
+		runtime_warning("%s is already started", CMP_NAME);			\
+		return NULL;												\
+	}																\
+	this->scaler = scaler;											\
+	this->wakeup = eventcount_ctor(0);								\
+	while(this->workers_num < scaler->min_workers){					\
+		_scaled_##CMP_UNIQUE##_grow();								\
+	}																\
+	this->supervisor = make_thread(_thr_##CMP_UNIQUE##_supervisor, NULL); \
+	start_thread(this->supervisor);									\
+	PRINTING_SG_IS_STARTED(CMP_NAME);								\
+																	\
+	return NULL;													\
+}																	\
+																	\
+DECL_TYPE void* THR_STOP_PROC_NAME() 								\
+{																	\
+	_scaled_##CMP_UNIQUE##_t *this = &_scaled_##CMP_UNIQUE;			\
+	int32_t index;													\
+	PRINTING_STOPPING_SG(CMP_NAME);									\
+	if(this->supervisor == NULL){									\
+		runtime_warning("%s is not started", CMP_NAME);				\
+		return NULL;												\
+	}																\
+	/*the supervisor waits for its next period, it is woken up*/	\
+	retire_thread(this->supervisor);								\
+	eventcount_notify_all(this->wakeup);							\
+	if(this->supervisor->state != THREAD_STATE_STOPPED){			\
+		stop_thread(this->supervisor);								\
+	}																\
+	if(thread_timedjoin(this->supervisor, CMP_THREADS_AUTOSCALE_JOIN_MS)){ \
+		dmap_wrlock_table_thr();									\
+		dmap_rem_thr(this->supervisor);								\
+		dmap_wrunlock_table_thr();									\
+		eventcount_dtor(this->wakeup);								\
+	}else{															\
+		runtime_warning("The supervisor of %s does not exit, it is not disposed", CMP_NAME); \
+	}																\
+	this->supervisor = NULL;										\
+	this->wakeup = NULL;											\
+	/*all of the instances are asked first, so they stop together*/	\
+	for(index = 0; index < this->workers_num; ++index){				\
+		retire_thread(this->workers[index]);						\
+		this->retired[this->retired_num++] = this->workers[index];	\
+	}																\
+	this->workers_num = 0;											\
+	for(index = 0; index < this->retired_num; ++index){				\
+		if(this->retired[index]->state != THREAD_STATE_STOPPED){	\
+			stop_thread(this->retired[index]);						\
+		}															\
+		/*the thread is disposed after it has exited*/				\
+		if(!thread_timedjoin(this->retired[index], CMP_THREADS_AUTOSCALE_JOIN_MS)){ \
+			runtime_warning("An instance of %s does not exit, it is not disposed", CMP_NAME); \
+			continue;												\
+		}															\
+		_scaled_##CMP_UNIQUE##_dispose(this->retired[index]);		\
+	}																\
+	this->retired_num = 0;											\
+	PRINTING_SG_IS_STOPPED(CMP_NAME);								\
+																	\
+	return NULL;													\
+}																	\
+
+
+//Same as CMP_THREADS, but every instance runs as a fiber of FIBERSCHED
+//instead of an own thread, so a component can have as many instances as
+//there are flows. FBR_MAIN_PROC_NAME(fiber_t*) finds its component in
+//fiber->arg and returns once fiber_is_stopping(fiber). Signal and puffer
+//waits park the fiber only; the instances are kept by their activators.
+#define CMP_FIBERS(													\
+				DECL_TYPE,											\
+				CMP_TYPE,											\
+				CMP_UNIQUE,											\
+				CMP_NAME,											\
+				CHAIN_CTOR_PROC_NAME,								\
+				CHAIN_DTOR_PROC_NAME,								\
+				CMP_INIT_PROC_NAME,									\
+				CMP_DEINIT_PROC_NAME, 								\
+				FBR_MAIN_PROC_NAME,									\
+				FBR_ACTIVATOR_TYPE, 								\
+				CMP_ACTIVATOR_ATTR, 								\
+				FIBERSCHED,											\
+				FBR_START_PROC_NAME, 								\
+				FBR_STOP_PROC_NAME 									\
+				)													\
+	CMP_MDEF(DECL_TYPE,												\
+			CMP_TYPE,       									  	\
+			CMP_NAME,   										    \
+			_cmp_##CMP_UNIQUE##_ctor,           					\
+			_cmp_##CMP_UNIQUE##_dtor,           					\
+			 CMP_INIT_PROC_NAME,              						\
+			 __NO_TEST_FUNC_,             							\
+			 CMP_DEINIT_PROC_NAME               					\
+			);														\
+static skiplist_t* _fbrs_##CMP_UNIQUE = NULL;						\
+																	\
+static int32_t _fbrs_##CMP_UNIQUE##_cmp(ptr_t a, ptr_t b)			\
+{																	\
+	return a < b ? -1 : a > b;										\
+}																	\
+																	\
+static void* _fbr_##CMP_UNIQUE##_entrypoint(void *arg)				\
+{																	\
+	FBR_MAIN_PROC_NAME(fiber_current());							\
+	return NULL;													\
+}																	\
+																	\
+DECL_TYPE void CHAIN_CTOR_PROC_NAME()								\
+{																	\
+	_fbrs_##CMP_UNIQUE = make_skiplist(_fbrs_##CMP_UNIQUE##_cmp, NULL); \
+}																	\
+																	\
+DECL_TYPE void CHAIN_DTOR_PROC_NAME()								\
+{																	\
+	skiplist_dtor(_fbrs_##CMP_UNIQUE);								\
+	_fbrs_##CMP_UNIQUE = NULL;										\
+}																	\
+																	\
+DECL_TYPE void* FBR_START_PROC_NAME(FBR_ACTIVATOR_TYPE *activator) 	\
+{																	\
+	CMP_TYPE *cmp;													\
+	fiber_t  *fiber;												\
+	PRINTING_STARTING_SG(CMP_NAME);									\
+																	\
+	cmp = _cmp_##CMP_UNIQUE##_ctor();								\
+	cmp->CMP_ACTIVATOR_ATTR = activator;							\
+	fiber = fiber_spawn(FIBERSCHED, _fbr_##CMP_UNIQUE##_entrypoint, cmp); \
+	if(fiber == NULL){												\
+		_cmp_##CMP_UNIQUE##_dtor(cmp);								\
+		return NULL;												\
+	}																\
+	if(!skiplist_insert(_fbrs_##CMP_UNIQUE, activator, fiber)){		\
+		runtime_warning("Component is already started for activator %p", \
+						activator);  								\
+		fiber_stop(fiber);											\
+		fiber_join(fiber);											\
+		fiber_dtor(fiber);											\
+		_cmp_##CMP_UNIQUE##_dtor(cmp);								\
+		return NULL;												\
+	}																\
+																	\
+	PRINTING_SG_IS_STARTED(CMP_NAME);								\
+																	\
+	return NULL;													\
+}																	\
+																	\
+DECL_TYPE void* FBR_STOP_PROC_NAME(FBR_ACTIVATOR_TYPE *activator) 	\
+{																	\
+	CMP_TYPE *cmp;													\
+	fiber_t  *fiber;												\
+	PRINTING_STOPPING_SG(CMP_NAME);									\
+																	\
+	/*only the caller which removes the activator gets the fiber*/	\
+	fiber = (fiber_t*) skiplist_remove(_fbrs_##CMP_UNIQUE, activator); \
+	if(fiber == NULL){												\
+		runtime_warning("Didn't find component for activator %p",	\
+						activator);  								\
+		return NULL; 												\
+	}																\
+	cmp = (CMP_TYPE*) fiber->arg;									\
+	fiber_stop(fiber);												\
+	fiber_join(fiber);												\
+	fiber_dtor(fiber);												\
+	_cmp_##CMP_UNIQUE##_dtor(cmp);									\
+	PRINTING_SG_IS_STOPPED(CMP_NAME);								\
+																	\
+	return NULL;													\
+}																	\
+
+
 #endif /* INCGUARD_CMP_PREDEFS_H_ */
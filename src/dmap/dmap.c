@@ -7,7 +7,10 @@
 #include "lib_threading.h"
 #include "inc_texts.h"
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include "lib_debuglog.h"
+#include "dmap_store.h"
 
 //----------------------------- Static declarations ---------------------
 /*
@@ -17,10 +20,10 @@ static dmap_row_t* _make_dmap_row(void *item, void (*dtor)(void*));
 static void        _dmap_table_init(dmap_table_t *table, int32_t size, char_t *name)      __attribute__((nonnull (1)));
 static void        _dmap_table_deinit(dmap_table_t *table);                               __attribute__((nonnull (1)))
 static bool_t      _dmap_itr_table(dmap_table_t *table, int32_t *index, dmap_row_t **row) __attribute__((nonnull (1,2,3)));
-static void*       _dmap_get_item(dmap_table_t *table, int32_t dmap_index)                __attribute__((nonnull (1)));
+static void*       _dmap_get_item(dmap_table_t *table, dmap_handle_t handle)              __attribute__((nonnull (1)));
 static void        _dmap_rem_item(dmap_table_t *table, void *item)                        __attribute__((nonnull (1)));
-static void        _dmap_rem(dmap_table_t *table, int32_t dmap_index)                     __attribute__((nonnull (1)));
-static int32_t     _dmap_add_row(dmap_table_t *table, dmap_row_t *row)                    __attribute__((nonnull (1)));
+static void        _dmap_rem(dmap_table_t *table, dmap_handle_t handle)                   __attribute__((nonnull (1)));
+static dmap_handle_t _dmap_add_row(dmap_table_t *table, dmap_row_t *row)                  __attribute__((nonnull (1)));
 */
 
 //------------------------------------------------------------------------------------------------
@@ -34,13 +37,13 @@ DMAP_DEF_SPECT_TABLE(																	 		 \
 	thread_dtor,		   /*name of the destructor for the specified data*/					 \
 	_dmap_table_thr,	   /*name of the variable reference to the table*/						 \
 	DMAP_NAME_TABLE_THR,   /*name of the table*/						 	     				 \
-	PROGRAM_MAX_THREAD_NUM,    /*maximal number of item the table can contain. */                    \
+	PROGRAM_MAX_THREAD_NUM,    /*number of items the table is preallocated for. */                     \
 	dmap_init_table_thr,   /*name of the process initialize the table*/                          \
 	dmap_deinit_table_thr, /*name of the process deinitialze the table*/                         \
 	dmap_get_table_thr,	   /*name of the process gets the table*/								 \
-	dmap_get_thr,		   /*name of the process gets an item from the table by index*/			 \
-	dmap_add_thr,		   /*name of the process adds an item and returns with its index*/  	 \
-	dmap_rem_thr_byindex,  /*name of the process remove an item from the table by index*/   	 \
+	dmap_get_thr,		   /*name of the process gets an item from the table by handle*/			 \
+	dmap_add_thr,		   /*name of the process adds an item and returns with its handle*/  	 \
+	dmap_rem_thr_byindex,  /*name of the process remove an item from the table by handle*/   	 \
 	dmap_rem_thr, 		   /*name of the process remove an item from the table by pointer*/ 	 \
 	dmap_rdlock_table_thr,  /*name of the process lock the table for reading*/					 \
 	dmap_rdunlock_table_thr,/*name of the process unlock the table from reading*/				 \
@@ -50,14 +53,19 @@ DMAP_DEF_SPECT_TABLE(																	 		 \
 );
 
 
-DMAP_DEF_ITEM(																				 	 \
+DMAP_DEF_VERSIONED_ITEM(																	 \
 		sysdat_t,			   /*name of the specific data type*/								 \
-		_dmap_sysdat,		   /*name of the variable reference to the data*/					 \
-		_dmap_sysdat_mutex,	   /*name of the variable reference to the mutex*/					 \
+		_dmap_sysdat,		   /*name of the variable reference to the current version*/		 \
+		_dmap_sysdat_mutex,	   /*name of the variable reference to the mutex of the writers*/	 \
 		DMAP_NAME_SYSDAT,	   /*name of the item*/												 \
-		dmap_get_sysdat,	   /*name of the process gets the table*/							 \
-		dmap_lock_sysdat,      /*name of the process lock the table*/							 \
-		dmap_unlock_sysdat 	   /*name of the process unlock the table*/							 \
+		dmap_init_sysdat,	   /*name of the process initialize the item*/						 \
+		dmap_deinit_sysdat,	   /*name of the process deinitialize the item*/					 \
+		dmap_get_sysdat,	   /*name of the process gets the current version*/					 \
+		dmap_begin_sysdat,     /*name of the process gets a copy to change*/					 \
+		dmap_commit_sysdat,    /*name of the process publishes the changed copy*/				 \
+		dmap_abort_sysdat,	   /*name of the process drops the changed copy*/					 \
+		dmap_subscribe_sysdat, /*name of the process subscribes to the commits*/				 \
+		dmap_unsubscribe_sysdat /*name of the process unsubscribes from the commits*/			 \
 	);
 
 
@@ -74,7 +82,8 @@ void dmap_init()
 
 	//example:
 //	dmap_init_table_operations();
-	_dmap_sysdat_mutex = mutex_ctor();
+	dmap_init_sysdat();
+	dmap_init_table_thr();
 
 	PRINTING_SG_IS_CONSTRUCTED(DMAP_NAME);
 }
@@ -82,7 +91,8 @@ void dmap_init()
 void dmap_deinit()
 {
 	PRINTING_DESTRUCTING_SG(DMAP_NAME);
-	mutex_dtor(_dmap_sysdat_mutex);
+	dmap_deinit_sysdat();
+	dmap_deinit_table_thr();
 
 	//Here you deinit all datamap you used
 	//dmap_deinit_table_operations();
@@ -102,6 +112,110 @@ void dmap_itr_do(bool_t (*dmap_iterator)(int32_t*, void*), void* (*action)(void*
 	}
 }
 
+//Collects the items of the rows from the slot at index up to end, at most
+//size of them, and continues at the next slot. The slots ahead and the items
+//collected are prefetched, so they arrive while the previous ones are used.
+//The slot ahead is not read, a row pointer loaded from it would be a miss.
+int32_t dmap_itr_batch(dmap_table_t *table, int32_t *dmap_index, int32_t end, void **items, int32_t size)
+{
+	dmap_row_t *row;
+	int32_t     result = 0;
+	if(table->size < end){
+		end = table->size;
+	}
+	for(; *dmap_index < end && result < size; ++(*dmap_index)){
+		if(*dmap_index + DMAP_PREFETCH_DISTANCE < end){
+			__builtin_prefetch(dmap_table_slot(table, *dmap_index + DMAP_PREFETCH_DISTANCE));
+		}
+		row = dmap_table_slot(table, *dmap_index)->row;
+		if(row == NULL || row->item == NULL){
+			continue;
+		}
+		__builtin_prefetch(row->item);
+		items[result++] = row->item;
+	}
+	return result;
+}
+
+//a call of dmap_parallel_for, freed by the last of the caller and the tasks
+typedef struct dmap_parallel_struct_t{
+	dmap_table_t     *table;
+	void            (*action)(void **items, int32_t items_num, void *arg);
+	void             *arg;
+	int32_t           parts_num;
+	volatile int32_t  next_part;
+	volatile int32_t  done_parts;
+	volatile int32_t  refs;
+	eventcount_t     *done;
+}dmap_parallel_t;
+
+static void _dmap_parallel_release(dmap_parallel_t *parallel)
+{
+	if(__atomic_sub_fetch(&parallel->refs, 1, __ATOMIC_ACQ_REL)){
+		return;
+	}
+	eventcount_dtor(parallel->done);
+	free(parallel);
+}
+
+//takes the parts not taken yet, so the caller never waits for a task not started
+static void _dmap_parallel_run(dmap_parallel_t *parallel)
+{
+	void    *items[DMAP_BATCH_SIZE];
+	int32_t  part, index, end, items_num;
+	while((part = __atomic_fetch_add(&parallel->next_part, 1, __ATOMIC_RELAXED)) < parallel->parts_num){
+		index = part * DMAP_PARALLEL_PART;
+		end = index + DMAP_PARALLEL_PART;
+		while(0 < (items_num = dmap_itr_batch(parallel->table, &index, end, items, DMAP_BATCH_SIZE))){
+			parallel->action(items, items_num, parallel->arg);
+		}
+		if(__atomic_add_fetch(&parallel->done_parts, 1, __ATOMIC_ACQ_REL) == parallel->parts_num){
+			eventcount_notify_all(parallel->done);
+		}
+	}
+}
+
+static void* _dmap_parallel_task(void *arg)
+{
+	_dmap_parallel_run((dmap_parallel_t*) arg);
+	_dmap_parallel_release((dmap_parallel_t*) arg);
+	return NULL;
+}
+
+//Applies the action to batches of the items on the workers of the executor
+//and on the calling thread, and returns when every item was processed. The
+//table is split into parts of contiguous slots and a part is done by one
+//thread, so the action may run concurrently for different batches. The caller
+//holds the read lock of the table. Without an executor the caller does all.
+void dmap_parallel_for(dmap_table_t *table, executor_t *executor,
+                       void (*action)(void **items, int32_t items_num, void *arg), void *arg)
+{
+	dmap_parallel_t *parallel;
+	int32_t          index, tasks_num;
+	uint32_t         key;
+	parallel = (dmap_parallel_t*) calloc(1, sizeof(dmap_parallel_t));
+	parallel->table = table;
+	parallel->action = action;
+	parallel->arg = arg;
+	parallel->parts_num = (table->size + DMAP_PARALLEL_PART - 1) / DMAP_PARALLEL_PART;
+	parallel->done = eventcount_ctor(0);
+	tasks_num = executor && 1 < parallel->parts_num ? MIN(executor->workers_num, parallel->parts_num - 1) : 0;
+	parallel->refs = tasks_num + 1;
+	for(index = 0; index < tasks_num; ++index){
+		executor_submit(executor, _dmap_parallel_task, parallel);
+	}
+	_dmap_parallel_run(parallel);
+	while(__atomic_load_n(&parallel->done_parts, __ATOMIC_ACQUIRE) < parallel->parts_num){
+		key = eventcount_prepare_wait(parallel->done);
+		if(parallel->parts_num <= __atomic_load_n(&parallel->done_parts, __ATOMIC_ACQUIRE)){
+			eventcount_cancel_wait(parallel->done);
+			break;
+		}
+		eventcount_commit_wait(parallel->done, key);
+	}
+	_dmap_parallel_release(parallel);
+}
+
 //------------------------------------------------------------------------------------------------
 //------------------------------------ Functions ------------------------------------------
 //------------------------------------------------------------------------------------------------
@@ -138,19 +252,596 @@ dmap_row_t* _make_dmap_row(void *item, void (*dtor)(void*))
 	return result;
 }
 
+static uint32_t _dmap_items_home(dmap_table_t *table, void *item)
+{
+	uint64_t key = (uint64_t)(uintptr_t) item >> 3;
+	return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (table->items_size - 1);
+}
+
+static void _dmap_items_add(dmap_table_t *table, void *item, int32_t slot)
+{
+	uint32_t index;
+	for(index = _dmap_items_home(table, item);
+		table->items[index].item != NULL;
+		index = (index + 1) & (table->items_size - 1));
+	table->items[index].item = item;
+	table->items[index].slot = slot;
+}
+
+static int32_t _dmap_items_find(dmap_table_t *table, void *item)
+{
+	uint32_t index;
+	for(index = _dmap_items_home(table, item);
+		table->items[index].item != NULL;
+		index = (index + 1) & (table->items_size - 1)){
+		if(table->items[index].item == item){
+			return table->items[index].slot;
+		}
+	}
+	return -1;
+}
+
+//the following references are shifted back to the hole, so lookups
+//never stop early at an emptied place
+static void _dmap_items_rem(dmap_table_t *table, void *item, int32_t slot)
+{
+	uint32_t mask = table->items_size - 1;
+	uint32_t index, next, home;
+	for(index = _dmap_items_home(table, item);
+		table->items[index].item != NULL
+		&& (table->items[index].item != item || table->items[index].slot != slot);
+		index = (index + 1) & mask);
+	if(table->items[index].item == NULL){
+		return;
+	}
+	for(next = (index + 1) & mask; table->items[next].item != NULL; next = (next + 1) & mask){
+		home = _dmap_items_home(table, table->items[next].item);
+		if(((next - index) & mask) <= ((next - home) & mask)){
+			table->items[index] = table->items[next];
+			index = next;
+		}
+	}
+	table->items[index].item = NULL;
+}
+
+static void _dmap_index_add(dmap_index_t *index, void *item, int32_t slot, uint32_t hash)
+{
+	uint32_t position;
+	for(position = hash & (index->size - 1);
+		index->refs[position].item != NULL;
+		position = (position + 1) & (index->size - 1));
+	index->refs[position].item = item;
+	index->refs[position].slot = slot;
+	index->refs[position].hash = hash;
+	++index->refs_num;
+}
+
+static void _dmap_index_grow(dmap_index_t *index)
+{
+	dmap_indexref_t *refs = index->refs;
+	uint32_t         position, size = index->size;
+	index->size = size << 1;
+	index->refs = (dmap_indexref_t*) calloc(index->size, sizeof(dmap_indexref_t));
+	index->refs_num = 0;
+	for(position = 0; position < size; ++position){
+		if(refs[position].item != NULL){
+			_dmap_index_add(index, refs[position].item, refs[position].slot, refs[position].hash);
+		}
+	}
+	free(refs);
+}
+
+//same backward shift as at the index of the items
+static void _dmap_index_rem(dmap_index_t *index, void *item, int32_t slot)
+{
+	uint32_t mask = index->size - 1;
+	uint32_t position, next, home;
+	for(position = index->hash(index->key(item)) & mask;
+		index->refs[position].item != NULL
+		&& (index->refs[position].item != item || index->refs[position].slot != slot);
+		position = (position + 1) & mask);
+	if(index->refs[position].item == NULL){
+		return;
+	}
+	for(next = (position + 1) & mask; index->refs[next].item != NULL; next = (next + 1) & mask){
+		home = index->refs[next].hash & mask;
+		if(((next - position) & mask) <= ((next - home) & mask)){
+			index->refs[position] = index->refs[next];
+			position = next;
+		}
+	}
+	index->refs[position].item = NULL;
+	--index->refs_num;
+}
+
+static void _dmap_indexes_add(dmap_table_t *table, void *item, int32_t slot)
+{
+	dmap_index_t *index;
+	for(index = table->indexes; index; index = index->next){
+		if(index->size < 2 * (uint32_t)(index->refs_num + 1)){
+			_dmap_index_grow(index);
+		}
+		_dmap_index_add(index, item, slot, index->hash(index->key(item)));
+	}
+}
+
+static void _dmap_indexes_rem(dmap_table_t *table, void *item, int32_t slot)
+{
+	dmap_index_t *index;
+	for(index = table->indexes; index; index = index->next){
+		_dmap_index_rem(index, item, slot);
+	}
+}
+
+//attaches the index to an initialized table and indexes the rows already in it
+void _dmap_index_init(dmap_table_t *table, dmap_index_t *index, char_t *name,
+		const void* (*key)(void*), uint32_t (*hash)(const void*), bool_t (*equal)(const void*, const void*))
+{
+	int32_t     slot;
+	dmap_row_t *row;
+	BZERO(index, sizeof(dmap_index_t));
+	strncpy(index->name, name, sizeof(index->name) - 1);
+	index->key = key;
+	index->hash = hash;
+	index->equal = equal;
+	index->size = 1 << DMAP_TABLE_CHUNK_SHIFT;
+	index->refs = (dmap_indexref_t*) calloc(index->size, sizeof(dmap_indexref_t));
+	index->next = table->indexes;
+	table->indexes = index;
+	for(slot = 0; _dmap_itr_table(table, &slot, &row) == BOOL_TRUE; ++slot){
+		if(row->item == NULL){
+			continue;
+		}
+		if(index->size < 2 * (uint32_t)(index->refs_num + 1)){
+			_dmap_index_grow(index);
+		}
+		_dmap_index_add(index, row->item, slot, hash(key(row->item)));
+	}
+}
+
+//returns with an item having the key, or NULL if there is none
+void* _dmap_index_get(dmap_index_t *index, const void *key)
+{
+	uint32_t hash = index->hash(key);
+	uint32_t position;
+	for(position = hash & (index->size - 1);
+		index->refs[position].item != NULL;
+		position = (position + 1) & (index->size - 1)){
+		if(index->refs[position].hash == hash && index->equal(key, index->key(index->refs[position].item))){
+			return index->refs[position].item;
+		}
+	}
+	return NULL;
+}
+
+//FNV-1a
+uint32_t dmap_hash_str(const char_t *key)
+{
+	uint32_t result = 2166136261U;
+	for(; *key; ++key){
+		result = (result ^ (uint8_t) *key) * 16777619U;
+	}
+	return result ^ (result >> 16);
+}
+
+uint32_t dmap_hash_int32(const int32_t *key)
+{
+	return (uint32_t)(((uint64_t)(uint32_t) *key * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+bool_t dmap_equal_str(const char_t *key1, const char_t *key2)
+{
+	return strcmp(key1, key2) == 0 ? BOOL_TRUE : BOOL_FALSE;
+}
+
+bool_t dmap_equal_int32(const int32_t *key1, const int32_t *key2)
+{
+	return *key1 == *key2 ? BOOL_TRUE : BOOL_FALSE;
+}
+
+//doubles the index of the items, the rows are not touched
+static void _dmap_items_grow(dmap_table_t *table)
+{
+	dmap_itemref_t *items = table->items;
+	uint32_t        index, items_size = table->items_size;
+	table->items_size = items_size << 1;
+	table->items = (dmap_itemref_t*) calloc(table->items_size, sizeof(dmap_itemref_t));
+	for(index = 0; index < items_size; ++index){
+		if(items[index].item != NULL){
+			_dmap_items_add(table, items[index].item, items[index].slot);
+		}
+	}
+	free(items);
+}
+
+//allocates the next chunk and puts its slots into the free list. The slots
+//are cut at the limit of the table; a chunk cut at a former limit is
+//completed first by a copy, the lock-free readers may still use the old one.
+static bool_t _dmap_table_grow(dmap_table_t *table)
+{
+	dmap_slot_t *chunk, *cut;
+	int32_t      index, end, last, used, length;
+	if(table->limit && table->limit <= table->size){
+		return BOOL_FALSE;
+	}
+	end = (1 << (table->chunks_num + DMAP_TABLE_CHUNK_SHIFT)) - (1 << DMAP_TABLE_CHUNK_SHIFT);
+	if(table->size < end){
+		last = table->chunks_num - 1;
+		used = table->size - ((1 << (last + DMAP_TABLE_CHUNK_SHIFT)) - (1 << DMAP_TABLE_CHUNK_SHIFT));
+		length = end - table->size;
+	}else if(table->chunks_num < DMAP_TABLE_CHUNKS){
+		last = table->chunks_num;
+		used = 0;
+		length = 1 << (last + DMAP_TABLE_CHUNK_SHIFT);
+	}else{
+		return BOOL_FALSE;
+	}
+	if(table->limit && table->limit - table->size < length){
+		length = table->limit - table->size;
+	}
+	chunk = (dmap_slot_t*) malloc(sizeof(dmap_slot_t) * (used + length));
+	if(chunk == NULL){
+		return BOOL_FALSE;
+	}
+	cut = used ? table->chunks[last] : NULL;
+	if(cut){
+		memcpy(chunk, cut, sizeof(dmap_slot_t) * used);
+	}
+	for(index = 0; index < length; ++index){
+		chunk[used + index].row = NULL;
+		chunk[used + index].generation = 1;
+		chunk[used + index].next_free = table->size + index + 1;
+	}
+	chunk[used + length - 1].next_free = table->free_first;
+	table->free_first = table->size;
+	__atomic_store_n(&table->chunks[last], chunk, __ATOMIC_RELEASE);
+	if(cut){
+		ebr_retire(cut, free);
+	}else{
+		++table->chunks_num;
+	}
+	__atomic_store_n(&table->size, table->size + length, __ATOMIC_RELEASE);
+	return BOOL_TRUE;
+}
+
+//allocates the slots for the given number of rows at once
+bool_t dmap_table_reserve(dmap_table_t *table, int32_t rows_num)
+{
+	while(table->size < rows_num){
+		if(_dmap_table_grow(table) == BOOL_FALSE){
+			return BOOL_FALSE;
+		}
+	}
+	while(table->items_size < 2 * (uint32_t) rows_num){
+		_dmap_items_grow(table);
+	}
+	return BOOL_TRUE;
+}
+
+//bounds the number of rows, 0 removes the bound; rows already added are kept
+void dmap_table_limit(dmap_table_t *table, int32_t limit)
+{
+	table->limit = limit;
+}
+
+static void _dmap_row_dispose(void *row)
+{
+	_dmap_row_dtor((dmap_row_t*) row);
+}
+
+//Publishes the rows of the table once for the changes made since the last
+//publish, so a write lock adding or removing many rows copies them once. The
+//rows removed meanwhile are retired after it, as the replaced snapshot and
+//its readers may still hold their items.
+void _dmap_snapshot_publish(dmap_table_t *table)
+{
+	dmap_snapshot_t *result;
+	int32_t          index;
+	dmap_row_t      *row;
+	if(table->snapshot_stale == BOOL_FALSE){
+		return;
+	}
+	result = (dmap_snapshot_t*) malloc(sizeof(dmap_snapshot_t) + sizeof(dmap_snaprow_t) * table->rows_num);
+	if(result == NULL){
+		EXERROR("Snapshot of a dmap table can not be allocated", EXIT_FAILURE);
+	}
+	result->rows_num = 0;
+	for(index = 0; _dmap_itr_table(table, &index, &row) == BOOL_TRUE; ++index){
+		result->rows[result->rows_num].item = row->item;
+		result->rows[result->rows_num++].handle = _dmap_get_handle(table, index);
+	}
+	table->snapshot_stale = BOOL_FALSE;
+	ebr_publish((void *volatile*) &table->snapshot, result, free);
+	for(index = 0; index < table->retired_num; ++index){
+		ebr_retire(table->retired[index], _dmap_row_dispose);
+	}
+	table->retired_num = 0;
+}
+
+//keeps a removed row until the next snapshot is published
+static void _dmap_snapshot_retire(dmap_table_t *table, dmap_row_t *row)
+{
+	if(table->retired_num == table->retired_size){
+		table->retired_size = table->retired_size ? 2 * table->retired_size : 1 << DMAP_TABLE_CHUNK_SHIFT;
+		table->retired = (dmap_row_t**) realloc(table->retired, table->retired_size * sizeof(dmap_row_t*));
+		if(table->retired == NULL){
+			EXERROR("Removed rows of a dmap table can not be kept", EXIT_FAILURE);
+		}
+	}
+	table->retired[table->retired_num++] = row;
+}
+
+//Starts to publish the rows for the readers of dmap_snapshot_enter. The rows
+//are copied once per write lock changing them, when it is released or the
+//table is flushed, so it suits tables read much more often than changed.
+//Called with the table locked for writing.
+void dmap_table_snapshots(dmap_table_t *table)
+{
+	if(table->snapshots == BOOL_TRUE){
+		return;
+	}
+	table->snapshots = BOOL_TRUE;
+	table->snapshot_stale = BOOL_TRUE;
+	_dmap_snapshot_publish(table);
+}
+
+//The snapshot and the items in it stay valid until dmap_snapshot_leave,
+//even if the rows are removed meanwhile. Returns with NULL if the table
+//does not keep snapshots.
+dmap_snapshot_t* dmap_snapshot_enter(dmap_table_t *table)
+{
+	ebr_enter();
+	return (dmap_snapshot_t*) ebr_read((void *volatile*) &table->snapshot);
+}
+
+void dmap_snapshot_leave()
+{
+	ebr_leave();
+}
+
+//finds the item of a handle without locking the table, only between
+//dmap_snapshot_enter and dmap_snapshot_leave of a table keeping snapshots
+void* dmap_snapshot_get(dmap_table_t *table, dmap_handle_t handle)
+{
+	int32_t      slot = DMAP_HANDLE_SLOT(handle);
+	uint32_t     generation = DMAP_HANDLE_GENERATION(handle);
+	dmap_slot_t *target;
+	dmap_row_t  *row;
+	if(handle < 0 || __atomic_load_n(&table->size, __ATOMIC_ACQUIRE) <= slot){
+		return NULL;
+	}
+	target = dmap_table_slot(table, slot);
+	if(__atomic_load_n(&target->generation, __ATOMIC_ACQUIRE) != generation){
+		return NULL;
+	}
+	row = __atomic_load_n(&target->row, __ATOMIC_ACQUIRE);
+	//the row may belong to the next handle of the slot if it was removed meanwhile
+	if(row == NULL || __atomic_load_n(&target->generation, __ATOMIC_ACQUIRE) != generation){
+		return NULL;
+	}
+	return row->item;
+}
+
+//batch is the number of events delivered at once at most, 1 delivers every
+//event as it happens and only then the item of a removed row is still valid
+void dmap_subscription_init(dmap_subscription_t *subscription, uint32_t events,
+                            void (*callback)(dmap_event_t *events, int32_t events_num, void *arg),
+                            void *arg, int32_t batch)
+{
+	BZERO(subscription, sizeof(dmap_subscription_t));
+	subscription->events = events;
+	subscription->callback = callback;
+	subscription->arg = arg;
+	subscription->batch = batch < 1 ? 1 : batch;
+	if(1 < subscription->batch){
+		subscription->pending = (dmap_event_t*) calloc(subscription->batch, sizeof(dmap_event_t));
+	}
+}
+
+void dmap_subscription_deinit(dmap_subscription_t *subscription)
+{
+	free(subscription->pending);
+	subscription->pending = NULL;
+	subscription->pending_num = 0;
+}
+
+static void _dmap_subscription_flush(dmap_subscription_t *subscription)
+{
+	int32_t events_num = subscription->pending_num;
+	if(events_num == 0){
+		return;
+	}
+	subscription->pending_num = 0;
+	subscription->callback(subscription->pending, events_num, subscription->arg);
+}
+
+static void _dmap_subscription_post(dmap_subscription_t *subscription, uint32_t type, dmap_handle_t handle, void *item)
+{
+	dmap_event_t *event;
+	int32_t       index;
+	for(index = 0; index < subscription->pending_num; ++index){
+		event = &subscription->pending[index];
+		if(event->handle != handle){
+			continue;
+		}
+		if(type == DMAP_EVENT_REMOVE){
+			//the item is freed together with its row
+			event->item = NULL;
+		}
+		if((subscription->events & DMAP_EVENT_COALESCE) == 0){
+			continue;
+		}
+		if(type == DMAP_EVENT_UPDATE){
+			event->item = item;
+			return;
+		}
+		if(event->type == DMAP_EVENT_UPDATE && (subscription->events & DMAP_EVENT_REMOVE)){
+			event->type = DMAP_EVENT_REMOVE;
+			return;
+		}
+		--subscription->pending_num;
+		memmove(event, event + 1, sizeof(dmap_event_t) * (subscription->pending_num - index));
+		return;
+	}
+	if((subscription->events & type) == 0){
+		return;
+	}
+	if(subscription->batch == 1){
+		dmap_event_t single = {type, handle, item};
+		subscription->callback(&single, 1, subscription->arg);
+		return;
+	}
+	event = &subscription->pending[subscription->pending_num++];
+	event->type = type;
+	event->handle = handle;
+	event->item = item;
+	if(subscription->pending_num == subscription->batch){
+		_dmap_subscription_flush(subscription);
+	}
+}
+
+void _dmap_subscribe(dmap_subscription_t **subscriptions, dmap_subscription_t *subscription)
+{
+	subscription->next = *subscriptions;
+	*subscriptions = subscription;
+}
+
+//the pending events of the subscription are delivered before it is removed
+void _dmap_unsubscribe(dmap_subscription_t **subscriptions, dmap_subscription_t *subscription)
+{
+	for(; *subscriptions; subscriptions = &(*subscriptions)->next){
+		if(*subscriptions == subscription){
+			_dmap_subscription_flush(subscription);
+			*subscriptions = subscription->next;
+			subscription->next = NULL;
+			return;
+		}
+	}
+}
+
+void _dmap_notify(dmap_subscription_t *subscriptions, uint32_t type, dmap_handle_t handle, void *item)
+{
+	for(; subscriptions; subscriptions = subscriptions->next){
+		_dmap_subscription_post(subscriptions, type, handle, item);
+	}
+}
+
+void _dmap_flush(dmap_subscription_t *subscriptions)
+{
+	for(; subscriptions; subscriptions = subscriptions->next){
+		_dmap_subscription_flush(subscriptions);
+	}
+}
+
+//The callback of the subscription is called by the writers of the table,
+//so it must not lock or change the table. Called with the table locked for
+//writing, as well as the unsubscribe.
+void dmap_table_subscribe(dmap_table_t *table, dmap_subscription_t *subscription)
+{
+	_dmap_subscribe(&table->subscriptions, subscription);
+}
+
+void dmap_table_unsubscribe(dmap_table_t *table, dmap_subscription_t *subscription)
+{
+	_dmap_unsubscribe(&table->subscriptions, subscription);
+}
+
+//tells the subscribers that the item of a row was changed in place
+void dmap_table_update(dmap_table_t *table, dmap_handle_t handle)
+{
+	void *item = _dmap_get_item(table, handle);
+	if(item == NULL){
+		return;
+	}
+	_dmap_notify(table->subscriptions, DMAP_EVENT_UPDATE, handle, item);
+}
+
+//delivers the batched events and publishes the snapshot of the changes, the
+//write unlock of the table does it as well
+void dmap_table_flush(dmap_table_t *table)
+{
+	_dmap_flush(table->subscriptions);
+	_dmap_snapshot_publish(table);
+}
+
+rwmutex_t* _dmap_table_stripe(dmap_table_t *table, dmap_handle_t handle)
+{
+	return table->stripes[DMAP_HANDLE_SLOT(handle) & (table->stripes_num - 1)];
+}
+
+//takes every stripe of a striped table in their order, the lock of the others
+void _dmap_table_lock(dmap_table_t *table, bool_t write)
+{
+	int32_t index;
+	if(table->stripes_num == 0){
+		if(write == BOOL_TRUE){
+			rwmutex_write_lock(table->rwmutex);
+		}else{
+			rwmutex_read_lock(table->rwmutex);
+		}
+		return;
+	}
+	for(index = 0; index < table->stripes_num; ++index){
+		if(write == BOOL_TRUE){
+			rwmutex_write_lock(table->stripes[index]);
+		}else{
+			rwmutex_read_lock(table->stripes[index]);
+		}
+	}
+}
+
+void _dmap_table_unlock(dmap_table_t *table, bool_t write)
+{
+	int32_t index;
+	if(write == BOOL_TRUE){
+		dmap_table_flush(table);
+	}
+	if(table->stripes_num == 0){
+		if(write == BOOL_TRUE){
+			rwmutex_write_unlock(table->rwmutex);
+		}else{
+			rwmutex_read_unlock(table->rwmutex);
+		}
+		return;
+	}
+	for(index = table->stripes_num - 1; 0 <= index; --index){
+		if(write == BOOL_TRUE){
+			rwmutex_write_unlock(table->stripes[index]);
+		}else{
+			rwmutex_read_unlock(table->stripes[index]);
+		}
+	}
+}
+
+//size is the number of rows preallocated, the table grows over it
 void _dmap_table_init(dmap_table_t *table, int32_t size, char_t *name)
+{
+	_dmap_striped_table_init(table, size, name, 0);
+}
+
+//Splits the lock of the table into stripes_num locks, rounded up to a power
+//of two, a table of 0 stripes has one lock. A row belongs to the stripe of
+//its slot, so the rows of different stripes are read and changed in parallel;
+//adding, removing and iterating rows take every stripe in their order.
+void _dmap_striped_table_init(dmap_table_t *table, int32_t size, char_t *name, int32_t stripes_num)
 {
 	int32_t index;
 	logging("%s: %s", GET_TEXT_INIT_SG("dmap_table"), name);
 	BZERO(table, sizeof(dmap_table_t));
-	table->rwmutex = rwmutex_ctor();
-	table->size = size;
-	table->rows = (dmap_row_t**) malloc(sizeof(dmap_row_t*) * table->size);
-	for(index = 0; index < table->size; index++)
-	{
-		table->rows[index] = NULL;
+	if(0 < stripes_num){
+		for(table->stripes_num = 1; table->stripes_num < stripes_num; table->stripes_num <<= 1);
+		table->stripes = (rwmutex_t**) calloc(table->stripes_num, sizeof(rwmutex_t*));
+		for(index = 0; index < table->stripes_num; ++index){
+			table->stripes[index] = rwmutex_ctor();
+		}
+	}else{
+		table->rwmutex = rwmutex_ctor();
 	}
+	table->free_first = -1;
+	table->items_size = 1 << DMAP_TABLE_CHUNK_SHIFT;
+	table->items = (dmap_itemref_t*) calloc(table->items_size, sizeof(dmap_itemref_t));
 	strcpy(table->name, name);
+	dmap_table_reserve(table, size);
 	PRINTING_INIT_COMPLETED;
 }
 
@@ -159,89 +850,497 @@ void _dmap_table_deinit(dmap_table_t *table)
 	int32_t index;
 	dmap_row_t *row;
 	logging("%s: %s", GET_TEXT_DEINIT_SG("dmap_table"), table->name);
+	if(table->snapshots == BOOL_TRUE){
+		ebr_publish((void *volatile*) &table->snapshot, NULL, free);
+		for(index = 0; index < table->retired_num; ++index){
+			ebr_retire(table->retired[index], _dmap_row_dispose);
+		}
+		free(table->retired);
+		table->retired = NULL;
+		table->retired_num = table->retired_size = 0;
+		table->snapshots = BOOL_FALSE;
+	}
+	while(table->subscriptions){
+		_dmap_unsubscribe(&table->subscriptions, table->subscriptions);
+	}
+	if(table->store != NULL){
+		_dmap_store_detach(table);
+	}
 	for(index = 0; _dmap_itr_table(table, &index, &row) == BOOL_TRUE; ++index)
 	{
-		_dmap_rem(table, index);
+		_dmap_rem_slot(table, index);
+	}
+	if(table->store != NULL){
+		_dmap_store_close(table);
 	}
 	if(table->rwmutex != NULL){
 		rwmutex_dtor(table->rwmutex);
 		table->rwmutex = NULL;
 	}
+	for(index = 0; index < table->stripes_num; ++index){
+		rwmutex_dtor(table->stripes[index]);
+	}
+	free(table->stripes);
+	table->stripes = NULL;
+	table->stripes_num = 0;
+	for(index = 0; index < table->chunks_num; ++index){
+		free(table->chunks[index]);
+		table->chunks[index] = NULL;
+	}
+	for(; table->indexes; table->indexes = table->indexes->next){
+		free(table->indexes->refs);
+		table->indexes->refs = NULL;
+	}
+	free(table->items);
+	table->items = NULL;
+	table->chunks_num = 0;
+	table->size = 0;
 	PRINTING_DEINIT_COMPLETED;
 }
 
 bool_t _dmap_itr_table(dmap_table_t *table, int32_t *dmap_index, dmap_row_t **row)
 {
 	*row = NULL;
-	for(;*dmap_index < table->size && table->rows[*dmap_index] == NULL; ++(*dmap_index));
+	for(;*dmap_index < table->size && dmap_table_slot(table, *dmap_index)->row == NULL; ++(*dmap_index));
 	if(table->size <= *dmap_index){
 		return BOOL_FALSE;
 	}
-	*row = table->rows[*dmap_index];
+	*row = dmap_table_slot(table, *dmap_index)->row;
 	return BOOL_TRUE;
 }
 
-void* _dmap_get_item(dmap_table_t *table, int32_t dmap_index)
+//returns with the slot of a handle, or -1 if the row of the handle was removed
+static int32_t _dmap_handle_slot(dmap_table_t *table, dmap_handle_t handle)
 {
-	void       *result = NULL;
-	dmap_row_t *row;
-	if(dmap_index < 0 || table->size <= dmap_index){
-		runtime_warning("_dmap_get_item: the requested index (%d) is out of the borders in %s", dmap_index, table->name);
-		return NULL;
+	int32_t      slot = DMAP_HANDLE_SLOT(handle);
+	dmap_slot_t *target;
+	if(handle < 0 || table->size <= slot){
+		runtime_warning("_dmap: the requested handle (%lld) is out of the borders in %s", (long long) handle, table->name);
+		return -1;
 	}
-	row = table->rows[dmap_index];
-	if(row == NULL){
-		runtime_warning("_dmap_get_item: row is not found at %d in %s ", dmap_index, table->name);
+	target = dmap_table_slot(table, slot);
+	if(target->row == NULL || target->generation != DMAP_HANDLE_GENERATION(handle)){
+		return -1;
+	}
+	return slot;
+}
+
+dmap_handle_t _dmap_get_handle(dmap_table_t *table, int32_t dmap_index)
+{
+	return DMAP_HANDLE(dmap_index, dmap_table_slot(table, dmap_index)->generation);
+}
+
+//a removed row is not an error, its handle simply finds nothing
+void* _dmap_get_item(dmap_table_t *table, dmap_handle_t handle)
+{
+	int32_t slot = _dmap_handle_slot(table, handle);
+	if(slot < 0){
 		return NULL;
 	}
-	result = row->item;
-	return result;
+	return dmap_table_slot(table, slot)->row->item;
 }
 
-void _dmap_rem_item(dmap_table_t *table, void *item)
+void _dmap_rem_slot(dmap_table_t *table, int32_t slot)
 {
-	int32_t     index;
-	dmap_row_t *row = NULL;
-	for(index = 0;
-		_dmap_itr_table(table, &index, &row) == BOOL_TRUE
-		&& item == row->item;
-		++index);
-	if(index == table->size){
-		runtime_warning("_dmap_rem: row is not found to %p in %s ", item, table->name);
+	dmap_slot_t *target = dmap_table_slot(table, slot);
+	dmap_row_t  *row = target->row;
+	uint32_t     generation;
+	if(row->item != NULL){
+		_dmap_items_rem(table, row->item, slot);
+		_dmap_indexes_rem(table, row->item, slot);
+	}
+	_dmap_notify(table->subscriptions, DMAP_EVENT_REMOVE, DMAP_HANDLE(slot, target->generation), row->item);
+	generation = (target->generation + 1) & DMAP_GENERATION_MASK;
+	__atomic_store_n(&target->generation, generation ? generation : 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&target->row, NULL, __ATOMIC_RELEASE);
+	target->next_free = table->free_first;
+	table->free_first = slot;
+	--table->rows_num;
+	if(table->snapshots == BOOL_TRUE){
+		//the published snapshot still holds the item
+		table->snapshot_stale = BOOL_TRUE;
+		_dmap_snapshot_retire(table, row);
 		return;
 	}
 	_dmap_row_dtor(row);
 }
 
-void _dmap_rem(dmap_table_t *table, int32_t dmap_index)
+void _dmap_rem_item(dmap_table_t *table, void *item)
 {
-	dmap_row_t *row;
-	if(dmap_index < 0 || table->size <= dmap_index){
-		runtime_warning("_dmap_rem: the requested index (%d) is out of the borders in %s", dmap_index, table->name);
+	int32_t slot = item ? _dmap_items_find(table, item) : -1;
+	if(slot < 0){
+		runtime_warning("_dmap_rem: row is not found to %p in %s ", item, table->name);
 		return;
 	}
-	row = table->rows[dmap_index];
-	if(row == NULL){
-		runtime_warning("_dmap_rem: row is not exists at %d in %s ", dmap_index, table->name);
+	_dmap_rem_slot(table, slot);
+}
+
+void _dmap_rem(dmap_table_t *table, dmap_handle_t handle)
+{
+	int32_t slot = _dmap_handle_slot(table, handle);
+	if(slot < 0){
+		runtime_warning("_dmap_rem: row is not exists to handle %lld in %s ", (long long) handle, table->name);
 		return;
 	}
-	_dmap_row_dtor(row);
-	table->rows[dmap_index] = NULL;
+	_dmap_rem_slot(table, slot);
 }
 
-int32_t _dmap_add_row(dmap_table_t *table, dmap_row_t *row)
+dmap_handle_t _dmap_add_row(dmap_table_t *table, dmap_row_t *row)
 {
-	int32_t result;
+	int32_t      slot;
+	dmap_slot_t *target;
 	if(row == NULL){
 		runtime_warning("_dmap_add_row: tried to add row with NULL into %s", table->name);
 		return DEVCLEGO_DMAP_ERROR_ADD;
 	}
-	for(result = 0; table->rows[result] != NULL && result < table->size; result++);
-	if(result == table->size){
+	if((table->limit && table->limit <= table->rows_num)
+		|| (table->free_first < 0 && _dmap_table_grow(table) == BOOL_FALSE)){
 		runtime_warning("_dmap_add_row: %s is full", table->name);
 		return DEVCLEGO_ERROR_TABLE_IS_FULL;
 	}
-	table->rows[result] = row;
-	return result;
+	slot = table->free_first;
+	target = dmap_table_slot(table, slot);
+	table->free_first = target->next_free;
+	__atomic_store_n(&target->row, row, __ATOMIC_RELEASE);
+	if(table->items_size < 2 * (uint32_t)(table->rows_num + 1)){
+		_dmap_items_grow(table);
+	}
+	if(row->item != NULL){
+		_dmap_items_add(table, row->item, slot);
+		_dmap_indexes_add(table, row->item, slot);
+	}
+	++table->rows_num;
+	if(table->snapshots == BOOL_TRUE){
+		table->snapshot_stale = BOOL_TRUE;
+	}
+	_dmap_notify(table->subscriptions, DMAP_EVENT_ADD, DMAP_HANDLE(slot, target->generation), row->item);
+	return DMAP_HANDLE(slot, target->generation);
+}
+
+typedef struct _dmap_test_item_struct_t{
+	int32_t     id;
+	int32_t     check;            ///< the negative id, a freed or torn item does not match
+}_dmap_test_item_t;
+
+static dmap_handle_t _dmap_test_add(dmap_table_t *table, int32_t id)
+{
+	_dmap_test_item_t *item = (_dmap_test_item_t*) malloc(sizeof(_dmap_test_item_t));
+	item->id = id;
+	item->check = -id;
+	return _dmap_add_row(table, _make_dmap_row(item, free));
+}
+
+static const void* _dmap_test_key(void *item)
+{
+	return &((_dmap_test_item_t*) item)->id;
+}
+
+static uint32_t _dmap_test_hash(const void *key)
+{
+	return dmap_hash_int32((const int32_t*) key);
+}
+
+static bool_t _dmap_test_equal(const void *key1, const void *key2)
+{
+	return dmap_equal_int32((const int32_t*) key1, (const int32_t*) key2);
+}
+
+typedef struct _dmap_test_version_struct_t{
+	uint64_t    version;
+	int32_t     value;
+}_dmap_test_version_t;
+
+DMAP_DEF_VERSIONED_ITEM(_dmap_test_version_t, _dmap_test_version, _dmap_test_version_mutex, "dmap_test_version",
+		_dmap_test_version_init, _dmap_test_version_deinit, _dmap_test_version_get, _dmap_test_version_begin,
+		_dmap_test_version_commit, _dmap_test_version_abort, _dmap_test_version_subscribe,
+		_dmap_test_version_unsubscribe);
+
+static void _dmap_test_count(void **items __attribute__((unused)), int32_t items_num, void *arg)
+{
+	*(int32_t*) arg += items_num;
 }
 
+typedef struct _dmap_test_events_struct_t{
+	dmap_event_t  events[8];
+	int32_t       events_num;
+}_dmap_test_events_t;
+
+static void _dmap_test_deliver(dmap_event_t *events, int32_t events_num, void *arg)
+{
+	_dmap_test_events_t *received = (_dmap_test_events_t*) arg;
+	for(; 0 < events_num && received->events_num < 8; --events_num){
+		received->events[received->events_num++] = *events++;
+	}
+}
+
+#define DMAP_TEST_ROWS   32
+#define DMAP_TEST_ROUNDS 2000
+
+static dmap_table_t      _dmap_test_snapped;
+static volatile int32_t  _dmap_test_writing;
+
+//replaces the rows one by one, two of them under every write lock
+static void* _dmap_test_writer(void *arg)
+{
+	dmap_handle_t *handles = (dmap_handle_t*) arg;
+	int32_t        round, index;
+	for(round = 0; round < DMAP_TEST_ROUNDS; ++round){
+		_dmap_table_lock(&_dmap_test_snapped, BOOL_TRUE);
+		for(index = 2 * round; index < 2 * round + 2; ++index){
+			_dmap_rem(&_dmap_test_snapped, handles[index % DMAP_TEST_ROWS]);
+			handles[index % DMAP_TEST_ROWS] = _dmap_test_add(&_dmap_test_snapped, DMAP_TEST_ROWS + index);
+		}
+		_dmap_table_unlock(&_dmap_test_snapped, BOOL_TRUE);
+		sched_yield();
+	}
+	__atomic_store_n(&_dmap_test_writing, 0, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+//every snapshot holds the rows of one write lock, and its items stay intact
+//while the writer removes their rows
+static void* _dmap_test_reader(void *arg)
+{
+	int32_t           *failed = (int32_t*) arg;
+	dmap_snapshot_t   *snapshot;
+	_dmap_test_item_t *item;
+	int32_t            index;
+	while(__atomic_load_n(&_dmap_test_writing, __ATOMIC_ACQUIRE)){
+		snapshot = dmap_snapshot_enter(&_dmap_test_snapped);
+		*failed += snapshot == NULL || snapshot->rows_num != DMAP_TEST_ROWS;
+		for(index = 0; snapshot != NULL && index < snapshot->rows_num; ++index){
+			item = (_dmap_test_item_t*) snapshot->rows[index].item;
+			*failed += item->check != -item->id;
+			item = (_dmap_test_item_t*) dmap_snapshot_get(&_dmap_test_snapped, snapshot->rows[index].handle);
+			*failed += item != NULL && item != snapshot->rows[index].item;
+		}
+		dmap_snapshot_leave();
+		sched_yield();
+	}
+	return NULL;
+}
+
+#define DMAP_TEST_STRIPED_ROWS 8
+
+static dmap_table_t   _dmap_test_striped;
+static dmap_handle_t  _dmap_test_striped_handles[DMAP_TEST_STRIPED_ROWS];
+
+//changes the items in two steps under the locks of their rows only
+static void* _dmap_test_row_writer(void *arg)
+{
+	_dmap_test_item_t *item;
+	dmap_handle_t      handle;
+	int32_t            round;
+	for(round = 0; round < DMAP_TEST_ROUNDS; ++round){
+		handle = _dmap_test_striped_handles[(round + (intptr_t) arg) % DMAP_TEST_STRIPED_ROWS];
+		rwmutex_write_lock(_dmap_table_stripe(&_dmap_test_striped, handle));
+		item = (_dmap_test_item_t*) _dmap_get_item(&_dmap_test_striped, handle);
+		++item->id;
+		cpu_relax();
+		--item->check;
+		rwmutex_write_unlock(_dmap_table_stripe(&_dmap_test_striped, handle));
+	}
+	return NULL;
+}
+
+void dmap_test(void)
+{
+	dmap_table_t                table;
+	dmap_index_t                ids;
+	dmap_handle_t               handles[40], handle;
+	dmap_snapshot_t            *snapshot;
+	_dmap_test_item_t          *item;
+	_dmap_test_version_t       *changed;
+	const _dmap_test_version_t *version;
+	void                       *items[5];
+	dmap_subscription_t         subscriptions[3];
+	_dmap_test_events_t         received[3];
+	pthread_t                   writer, reader, row_writers[2];
+	int32_t                     index, key, items_num, failed = 0, reader_failed = 0;
+
+	//the handles find their rows while the table grows over its first chunk,
+	//a removed row is not found and its slot is reused by another handle
+	_dmap_table_init(&table, 16, "dmap_test");
+	for(index = 0; index < 40; ++index){
+		handles[index] = _dmap_test_add(&table, index);
+	}
+	failed += table.rows_num != 40;
+	for(index = 0; index < 40; ++index){
+		item = (_dmap_test_item_t*) _dmap_get_item(&table, handles[index]);
+		failed += item == NULL || item->id != index;
+	}
+	_dmap_rem(&table, handles[3]);
+	_dmap_rem_item(&table, _dmap_get_item(&table, handles[5]));
+	failed += _dmap_get_item(&table, handles[3]) != NULL || _dmap_get_item(&table, handles[5]) != NULL;
+	handle = _dmap_test_add(&table, 100);
+	failed += DMAP_HANDLE_SLOT(handle) != DMAP_HANDLE_SLOT(handles[5]) || handle == handles[5];
+	failed += _dmap_get_item(&table, handles[5]) != NULL || table.rows_num != 39;
+
+	//an index attached to a filled table finds the rows by their ids, and
+	//follows the rows added and removed after it while it grows
+	_dmap_index_init(&table, &ids, "dmap_test_ids", _dmap_test_key, _dmap_test_hash, _dmap_test_equal);
+	for(index = 40; index < 80; ++index){
+		_dmap_test_add(&table, index);
+	}
+	key = 7;
+	_dmap_rem_item(&table, _dmap_index_get(&ids, &key));
+	for(key = 0; key < 80; ++key){
+		item = (_dmap_test_item_t*) _dmap_index_get(&ids, &key);
+		if(key == 3 || key == 5 || key == 7){
+			failed += item != NULL;
+		}else{
+			failed += item == NULL || item->id != key;
+		}
+	}
+	key = 100;
+	failed += _dmap_index_get(&ids, &key) == NULL || ids.refs_num != table.rows_num;
+
+	//the batches skip the removed rows and stop at their size, the parallel
+	//iteration over the parts of a table grown over several of them gets every row
+	for(index = 0, key = 0; 0 < (items_num = dmap_itr_batch(&table, &index, table.size, items, 5)); key += items_num){
+		item = (_dmap_test_item_t*) items[items_num - 1];
+		failed += 5 < items_num || item->check != -item->id;
+	}
+	failed += key != table.rows_num;
+	for(index = 0; index < 2 * DMAP_PARALLEL_PART; ++index){
+		_dmap_test_add(&table, 100 + index);
+	}
+	key = 0;
+	dmap_parallel_for(&table, NULL, _dmap_test_count, &key);
+	failed += key != table.rows_num;
+	_dmap_table_deinit(&table);
+
+	//the changes of a write lock are published together when it is released
+	_dmap_table_init(&_dmap_test_snapped, 16, "dmap_test_snapped");
+	_dmap_table_lock(&_dmap_test_snapped, BOOL_TRUE);
+	dmap_table_snapshots(&_dmap_test_snapped);
+	for(index = 0; index < DMAP_TEST_ROWS; ++index){
+		handles[index] = _dmap_test_add(&_dmap_test_snapped, index);
+	}
+	snapshot = dmap_snapshot_enter(&_dmap_test_snapped);
+	failed += snapshot == NULL || snapshot->rows_num != 0;
+	dmap_snapshot_leave();
+	_dmap_table_unlock(&_dmap_test_snapped, BOOL_TRUE);
+	snapshot = dmap_snapshot_enter(&_dmap_test_snapped);
+	failed += snapshot == NULL || snapshot->rows_num != DMAP_TEST_ROWS;
+	dmap_snapshot_leave();
+
+	//a row removed under the lock stays intact in the snapshot read meanwhile
+	_dmap_table_lock(&_dmap_test_snapped, BOOL_TRUE);
+	snapshot = dmap_snapshot_enter(&_dmap_test_snapped);
+	_dmap_rem(&_dmap_test_snapped, handles[0]);
+	handles[0] = _dmap_test_add(&_dmap_test_snapped, DMAP_TEST_ROWS + 2 * DMAP_TEST_ROUNDS);
+	for(index = 0; index < snapshot->rows_num; ++index){
+		item = (_dmap_test_item_t*) snapshot->rows[index].item;
+		failed += item->check != -item->id;
+	}
+	failed += snapshot->rows_num != DMAP_TEST_ROWS;
+	failed += dmap_snapshot_get(&_dmap_test_snapped, snapshot->rows[0].handle) != NULL;
+	dmap_snapshot_leave();
+	_dmap_table_unlock(&_dmap_test_snapped, BOOL_TRUE);
+
+	//the snapshots are read while the writer replaces every row many times
+	_dmap_test_writing = 1;
+	pthread_create(&reader, NULL, _dmap_test_reader, &reader_failed);
+	pthread_create(&writer, NULL, _dmap_test_writer, handles);
+	_dmap_test_reader(&failed);
+	pthread_join(writer, NULL);
+	pthread_join(reader, NULL);
+	failed += reader_failed + (_dmap_test_snapped.rows_num != DMAP_TEST_ROWS);
+	_dmap_table_deinit(&_dmap_test_snapped);
+
+	//the batched events are delivered when the lock is released, a coalescing
+	//subscription merges the update of an added row into its add and leaves
+	//out a row added and removed in the batch, an unbatched one gets each event at once
+	_dmap_table_init(&table, 16, "dmap_test_events");
+	BZERO(received, sizeof(received));
+	dmap_subscription_init(&subscriptions[0], DMAP_EVENT_ADD | DMAP_EVENT_REMOVE | DMAP_EVENT_UPDATE,
+			_dmap_test_deliver, &received[0], 8);
+	dmap_subscription_init(&subscriptions[1], DMAP_EVENT_ADD | DMAP_EVENT_REMOVE | DMAP_EVENT_COALESCE,
+			_dmap_test_deliver, &received[1], 8);
+	dmap_subscription_init(&subscriptions[2], DMAP_EVENT_UPDATE, _dmap_test_deliver, &received[2], 1);
+	_dmap_table_lock(&table, BOOL_TRUE);
+	for(index = 0; index < 3; ++index){
+		dmap_table_subscribe(&table, &subscriptions[index]);
+	}
+	handles[0] = _dmap_test_add(&table, 0);
+	handles[1] = _dmap_test_add(&table, 1);
+	dmap_table_update(&table, handles[0]);
+	_dmap_rem(&table, handles[1]);
+	failed += received[0].events_num != 0 || received[1].events_num != 0 || received[2].events_num != 1;
+	_dmap_table_unlock(&table, BOOL_TRUE);
+	failed += received[0].events_num != 4 || received[1].events_num != 1 || received[2].events_num != 1;
+	failed += received[0].events[0].type != DMAP_EVENT_ADD || received[0].events[0].handle != handles[0];
+	failed += received[0].events[1].type != DMAP_EVENT_ADD || received[0].events[1].item != NULL;
+	failed += received[0].events[2].type != DMAP_EVENT_UPDATE || received[0].events[2].handle != handles[0];
+	failed += received[0].events[3].type != DMAP_EVENT_REMOVE || received[0].events[3].handle != handles[1];
+	failed += received[1].events[0].type != DMAP_EVENT_ADD || received[1].events[0].handle != handles[0];
+	failed += received[2].events[0].type != DMAP_EVENT_UPDATE || received[2].events[0].handle != handles[0];
+	_dmap_table_lock(&table, BOOL_TRUE);
+	for(index = 0; index < 3; ++index){
+		dmap_table_unsubscribe(&table, &subscriptions[index]);
+		dmap_subscription_deinit(&subscriptions[index]);
+	}
+	_dmap_table_unlock(&table, BOOL_TRUE);
+	_dmap_table_deinit(&table);
+
+	//a striped table has no table lock, the rows of the neighbouring slots
+	//are in different stripes
+	_dmap_striped_table_init(&_dmap_test_striped, 16, "dmap_test_striped", 3);
+	failed += _dmap_test_striped.stripes_num != 4 || _dmap_test_striped.rwmutex != NULL;
+	_dmap_table_lock(&_dmap_test_striped, BOOL_TRUE);
+	for(index = 0; index < DMAP_TEST_STRIPED_ROWS; ++index){
+		_dmap_test_striped_handles[index] = _dmap_test_add(&_dmap_test_striped, 0);
+	}
+	_dmap_table_unlock(&_dmap_test_striped, BOOL_TRUE);
+	failed += _dmap_table_stripe(&_dmap_test_striped, _dmap_test_striped_handles[0]) ==
+			  _dmap_table_stripe(&_dmap_test_striped, _dmap_test_striped_handles[1]);
+	failed += _dmap_table_stripe(&_dmap_test_striped, _dmap_test_striped_handles[0]) !=
+			  _dmap_table_stripe(&_dmap_test_striped, _dmap_test_striped_handles[4]);
+
+	//the row writers start on the table lock held here, so no row is changed
+	//until it is released, then no change of a row is lost
+	_dmap_table_lock(&_dmap_test_striped, BOOL_TRUE);
+	for(index = 0; index < 2; ++index){
+		pthread_create(&row_writers[index], NULL, _dmap_test_row_writer, (void*)(intptr_t) index);
+	}
+	thread_sleep(10);
+	for(index = 0; index < DMAP_TEST_STRIPED_ROWS; ++index){
+		item = (_dmap_test_item_t*) _dmap_get_item(&_dmap_test_striped, _dmap_test_striped_handles[index]);
+		failed += item->id != 0 || item->check != 0;
+	}
+	_dmap_table_unlock(&_dmap_test_striped, BOOL_TRUE);
+	for(index = 0; index < 2; ++index){
+		pthread_join(row_writers[index], NULL);
+	}
+	for(index = 0, key = 0; index < DMAP_TEST_STRIPED_ROWS; ++index){
+		item = (_dmap_test_item_t*) _dmap_get_item(&_dmap_test_striped, _dmap_test_striped_handles[index]);
+		failed += item->check != -item->id;
+		key += item->id;
+	}
+	failed += key != 2 * DMAP_TEST_ROUNDS;
+	_dmap_table_deinit(&_dmap_test_striped);
+
+	//a reader keeps the version it got while the next one is committed, and
+	//an aborted change is not published
+	_dmap_test_version_init();
+	ebr_enter();
+	version = _dmap_test_version_get();
+	changed = _dmap_test_version_begin();
+	changed->value = 1;
+	_dmap_test_version_commit(changed);
+	failed += version->version != 0 || version->value != 0;
+	version = _dmap_test_version_get();
+	failed += version->version != 1 || version->value != 1;
+	ebr_leave();
+	changed = _dmap_test_version_begin();
+	changed->value = 2;
+	_dmap_test_version_abort(changed);
+	ebr_enter();
+	version = _dmap_test_version_get();
+	failed += version->version != 1 || version->value != 1;
+	ebr_leave();
+	_dmap_test_version_deinit();
+
+	printf("dmap_test: %s\n", failed ? "FAILED" : "passed");
+}
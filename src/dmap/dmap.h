@@ -15,6 +15,24 @@
 void dmap_init();
 void dmap_deinit();
 void dmap_itr_do(bool_t (*dmap_iterator)(int32_t*, void*), void* (*action)(void*));
+int32_t dmap_itr_batch(dmap_table_t *table, int32_t *index, int32_t end, void **items, int32_t size);
+void dmap_parallel_for(dmap_table_t *table, executor_t *executor,
+                       void (*action)(void **items, int32_t items_num, void *arg), void *arg);
+bool_t dmap_table_reserve(dmap_table_t *table, int32_t rows_num);
+void dmap_table_limit(dmap_table_t *table, int32_t limit);
+void dmap_table_snapshots(dmap_table_t *table);
+dmap_snapshot_t* dmap_snapshot_enter(dmap_table_t *table);
+void dmap_snapshot_leave();
+void* dmap_snapshot_get(dmap_table_t *table, dmap_handle_t handle);
+void dmap_subscription_init(dmap_subscription_t *subscription, uint32_t events,
+                            void (*callback)(dmap_event_t *events, int32_t events_num, void *arg),
+                            void *arg, int32_t batch);
+void dmap_subscription_deinit(dmap_subscription_t *subscription);
+void dmap_table_subscribe(dmap_table_t *table, dmap_subscription_t *subscription);
+void dmap_table_unsubscribe(dmap_table_t *table, dmap_subscription_t *subscription);
+void dmap_table_update(dmap_table_t *table, dmap_handle_t handle);
+void dmap_table_flush(dmap_table_t *table);
+void dmap_test(void);
 
 dmap_row_t* _dmap_row_ctor_();
 void        _dmap_row_dtor(dmap_row_t *row);
@@ -22,10 +40,32 @@ dmap_row_t* _make_dmap_row(void *item, void (*dtor)(void*));
 void        _dmap_table_init(dmap_table_t *table, int32_t size, char_t *name)      __attribute__((nonnull (1)));
 void        _dmap_table_deinit(dmap_table_t *table);
 bool_t      _dmap_itr_table(dmap_table_t *table, int32_t *index, dmap_row_t **row) __attribute__((nonnull (1,2,3)));
-void*       _dmap_get_item(dmap_table_t *table, int32_t dmap_index)                __attribute__((nonnull (1)));
+void*       _dmap_get_item(dmap_table_t *table, dmap_handle_t handle)              __attribute__((nonnull (1)));
 void        _dmap_rem_item(dmap_table_t *table, void *item)                        __attribute__((nonnull (1)));
-void        _dmap_rem(dmap_table_t *table, int32_t dmap_index)                     __attribute__((nonnull (1)));
-int32_t     _dmap_add_row(dmap_table_t *table, dmap_row_t *row)                    __attribute__((nonnull (1)));
+void        _dmap_rem(dmap_table_t *table, dmap_handle_t handle)                   __attribute__((nonnull (1)));
+void        _dmap_rem_slot(dmap_table_t *table, int32_t dmap_index)                __attribute__((nonnull (1)));
+dmap_handle_t _dmap_add_row(dmap_table_t *table, dmap_row_t *row)                  __attribute__((nonnull (1)));
+dmap_handle_t _dmap_get_handle(dmap_table_t *table, int32_t dmap_index)            __attribute__((nonnull (1)));
+void        _dmap_subscribe(dmap_subscription_t **subscriptions, dmap_subscription_t *subscription);
+void        _dmap_unsubscribe(dmap_subscription_t **subscriptions, dmap_subscription_t *subscription);
+void        _dmap_notify(dmap_subscription_t *subscriptions, uint32_t type, dmap_handle_t handle, void *item);
+void        _dmap_flush(dmap_subscription_t *subscriptions);
+void        _dmap_snapshot_publish(dmap_table_t *table)                            __attribute__((nonnull (1)));
+void        _dmap_striped_table_init(dmap_table_t *table, int32_t size, char_t *name,
+                                     int32_t stripes_num)                           __attribute__((nonnull (1)));
+rwmutex_t*  _dmap_table_stripe(dmap_table_t *table, dmap_handle_t handle)          __attribute__((nonnull (1)));
+void        _dmap_table_lock(dmap_table_t *table, bool_t write)                    __attribute__((nonnull (1)));
+void        _dmap_table_unlock(dmap_table_t *table, bool_t write)                  __attribute__((nonnull (1)));
+void        _dmap_store_read_locked(dmap_table_t *table)                           __attribute__((nonnull (1)));
+void        _dmap_store_write_locked(dmap_table_t *table)                          __attribute__((nonnull (1)));
+void        _dmap_index_init(dmap_table_t *table, dmap_index_t *index, char_t *name,
+                             const void* (*key)(void*), uint32_t (*hash)(const void*),
+                             bool_t (*equal)(const void*, const void*))            __attribute__((nonnull (1,2)));
+void*       _dmap_index_get(dmap_index_t *index, const void *key)                  __attribute__((nonnull (1,2)));
+uint32_t    dmap_hash_str(const char_t *key);
+uint32_t    dmap_hash_int32(const int32_t *key);
+bool_t      dmap_equal_str(const char_t *key1, const char_t *key2);
+bool_t      dmap_equal_int32(const int32_t *key1, const int32_t *key2);
 
 
 //------------------------------------------------------------------------------------------------
@@ -37,9 +77,9 @@ int32_t     _dmap_add_row(dmap_table_t *table, dmap_row_t *row)
 DMAP_DECL_SPECT_TABLE(
 	thread_t,			   /*type of the items stored in the table*/
 	dmap_get_table_thr,	   /*name of the process gets the table*/
-	dmap_get_thr,		   /*name of the process gets an item from the table by index*/
-	dmap_add_thr,		   /*name of the process adds an item and returns with its index*/
-	dmap_rem_thr_byindex,  /*name of the process remove an item from the table by index*/
+	dmap_get_thr,		   /*name of the process gets an item from the table by handle*/
+	dmap_add_thr,		   /*name of the process adds an item and returns with its handle*/
+	dmap_rem_thr_byindex,  /*name of the process remove an item from the table by handle*/
 	dmap_rem_thr, 		   /*name of the process remove an item from the table by pointer*/
 	dmap_rdlock_table_thr,  /*name of the process lock the table for reading*/
 	dmap_rdunlock_table_thr,/*name of the process unlock the table from reading*/
@@ -49,11 +89,14 @@ DMAP_DECL_SPECT_TABLE(
 );
 
 
-DMAP_DECL_ITEM(
+DMAP_DECL_VERSIONED_ITEM(
 	sysdat_t,			   /*type of the item */
-	dmap_get_sysdat,	   /*name of the process gets the table*/
-	dmap_lock_sysdat,      /*name of the process lock the table*/
-	dmap_unlock_sysdat 	   /*name of the process unlock the table*/
+	dmap_get_sysdat,	   /*name of the process gets the current version*/
+	dmap_begin_sysdat,     /*name of the process gets a copy to change*/
+	dmap_commit_sysdat,    /*name of the process publishes the changed copy*/
+	dmap_abort_sysdat,	   /*name of the process drops the changed copy*/
+	dmap_subscribe_sysdat, /*name of the process subscribes to the commits*/
+	dmap_unsubscribe_sysdat /*name of the process unsubscribes from the commits*/
 );
 
 
@@ -17,11 +17,123 @@ typedef struct dmap_row_struct_t{
 	void (*dtor)(void*);
 }dmap_row_t;
 
+//A handle refers to a row by its slot and by the generation of the slot at
+//the time the row was added. The generation changes whenever a row is removed,
+//so a handle of a removed row does not find the next row of the same slot.
+typedef int64_t dmap_handle_t;
+
+#define DMAP_GENERATION_MASK 0x7FFFFFFF //handles are positive, the errors are negative
+#define DMAP_HANDLE(SLOT, GENERATION) (((dmap_handle_t)(GENERATION) << 32) | (uint32_t)(SLOT))
+#define DMAP_HANDLE_SLOT(HANDLE) ((int32_t)((HANDLE) & 0xFFFFFFFF))
+#define DMAP_HANDLE_GENERATION(HANDLE) ((uint32_t)((HANDLE) >> 32))
+
+typedef struct dmap_slot_struct_t{
+	dmap_row_t *row;
+	uint32_t    generation;
+	int32_t     next_free;        ///< next empty slot, -1 at the end of the free list
+}dmap_slot_t;
+
+//position of an item in the index used for removing rows by their items
+typedef struct dmap_itemref_struct_t{
+	void       *item;
+	int32_t     slot;
+}dmap_itemref_t;
+
+typedef struct dmap_indexref_struct_t{
+	void       *item;
+	int32_t     slot;
+	uint32_t    hash;             ///< of the key of the item
+}dmap_indexref_t;
+
+//Secondary index of a table, finds the rows by a key derived from their
+//items. The key of an item must not change while its row is in the table.
+typedef struct dmap_index_struct_t{
+	char_t            name[64];
+	const void*     (*key)(void *item);
+	uint32_t        (*hash)(const void *key);
+	bool_t          (*equal)(const void *key1, const void *key2);
+	dmap_indexref_t  *refs;           ///< open addressing by the hash of the keys
+	uint32_t          size;           ///< power of two, at least twice the number of rows
+	int32_t           refs_num;
+	struct dmap_index_struct_t *next; ///< in the list of the indexes of the table
+}dmap_index_t;
+
+#define DMAP_EVENT_ADD      0x01
+#define DMAP_EVENT_REMOVE   0x02
+#define DMAP_EVENT_UPDATE   0x04
+#define DMAP_EVENT_COALESCE 0x100  //a batch holds one event of a row, a row added and removed in it is left out
+
+typedef struct dmap_event_struct_t{
+	uint32_t       type;
+	dmap_handle_t  handle;           ///< the version of a versioned item
+	void          *item;             ///< NULL in a batch if the row was removed meanwhile
+}dmap_event_t;
+
+//Receives the changes of a table or of a versioned item. The events are
+//delivered by the writer while it holds the lock, one by one or in batches
+//when the batch is full or the lock is released.
+typedef struct dmap_subscription_struct_t{
+	uint32_t       events;           ///< DMAP_EVENT_* types and flags
+	void         (*callback)(dmap_event_t *events, int32_t events_num, void *arg);
+	void          *arg;
+	dmap_event_t  *pending;
+	int32_t        pending_num;
+	int32_t        batch;            ///< events delivered at once at most
+	struct dmap_subscription_struct_t *next;
+}dmap_subscription_t;
+
+typedef struct dmap_snaprow_struct_t{
+	void          *item;
+	dmap_handle_t  handle;
+}dmap_snaprow_t;
+
+//Rows of a table as they were at one moment. A published snapshot is never
+//changed, the writers publish a copy and the old one is freed after every
+//reader left it.
+typedef struct dmap_snapshot_struct_t{
+	int32_t        rows_num;
+	dmap_snaprow_t rows[];
+}dmap_snapshot_t;
+
+#define DMAP_TABLE_CHUNK_SHIFT 4  //the first chunk has 16 slots, every further one twice as many as the previous
+#define DMAP_TABLE_CHUNKS 26      //chunks of a table at most, so the slots fit into the handles
+#define DMAP_BATCH_SIZE 64        //items given to the action of dmap_parallel_for at once
+#define DMAP_PREFETCH_DISTANCE 8  //slots read ahead by dmap_itr_batch
+#define DMAP_PARALLEL_PART 4096   //slots of the parts dmap_parallel_for splits a table into
+#define DMAP_TABLE_STRIPES 16     //locks of a striped table by default
+
+//The slots are allocated in chunks which are never moved, so rows and
+//handles stay valid while the table grows.
 typedef struct dmap_table_struct_t{
 	char_t      		name[64];
-	int32_t     		size;
-	rwmutex_t             *rwmutex;
-	dmap_row_t 	      **rows;
+	int32_t     		size;             ///< slots allocated
+	int32_t     		limit;            ///< maximal number of rows, 0 if there is none
+	int32_t     		rows_num;
+	rwmutex_t             *rwmutex;       ///< NULL if the table is striped
+	dmap_slot_t        *chunks[DMAP_TABLE_CHUNKS];
+	int32_t             chunks_num;
+	int32_t             free_first;       ///< -1 if every allocated slot is used
+	dmap_itemref_t     *items;            ///< open addressing by the address of the items
+	uint32_t            items_size;       ///< power of two, at least twice the number of rows
+	dmap_index_t       *indexes;          ///< secondary indexes maintained on add and remove
+	dmap_snapshot_t *volatile snapshot;   ///< published rows for the lock-free readers, NULL if not kept
+	bool_t              snapshots;        ///< the rows are published and freed through ebr
+	bool_t              snapshot_stale;   ///< rows were added or removed since the snapshot was published
+	dmap_row_t        **retired;          ///< removed rows the published snapshot still holds
+	int32_t             retired_num;
+	int32_t             retired_size;
+	dmap_subscription_t *subscriptions;
+	struct dmap_store_struct_t *store;    ///< the file of the items of a persistent table, NULL if none
+	rwmutex_t         **stripes;          ///< locks of the rows of a striped table instead of rwmutex
+	int32_t             stripes_num;      ///< power of two, 0 if the table is not striped
 }dmap_table_t;
 
+//the slot at an index, chunk k starts at index 16 * (2^k - 1)
+static inline dmap_slot_t* dmap_table_slot(dmap_table_t *table, int32_t index)
+{
+	uint32_t position = (uint32_t) index + (1 << DMAP_TABLE_CHUNK_SHIFT);
+	int32_t  chunk = 31 - __builtin_clz(position >> DMAP_TABLE_CHUNK_SHIFT);
+	return &table->chunks[chunk][position - (1U << (chunk + DMAP_TABLE_CHUNK_SHIFT))];
+}
+
 #endif //INCGUARD_NTRT_DMAP_DEFINITIONS_H_
@@ -87,6 +87,23 @@
 
 
 
+#define DMAP_DEF_TABLE_R_LOCK_PROC(																	\
+									  PROC_NAME,													\
+									  TABLE_PTR,													\
+									  DATA_NAME														\
+								)																	\
+																									\
+	void PROC_NAME()																				\
+	{																								\
+		debug_rdlock(DATA_NAME);																	\
+		rwmutex_read_lock((TABLE_PTR)->rwmutex);													\
+		if((TABLE_PTR)->store != NULL){																\
+			_dmap_store_read_locked(TABLE_PTR);														\
+		}																							\
+	}																								\
+
+
+
 #define DMAP_DECL_R_UNLOCK_PROC(PROC_NAME)  														\
 	void PROC_NAME();   																			\
 
@@ -123,6 +140,23 @@
 
 
 
+#define DMAP_DEF_TABLE_W_LOCK_PROC(																	\
+									  PROC_NAME,													\
+									  TABLE_PTR,													\
+									  DATA_NAME														\
+								)																	\
+																									\
+	void PROC_NAME()																				\
+	{																								\
+		debug_wrlock(DATA_NAME);																	\
+		rwmutex_write_lock((TABLE_PTR)->rwmutex);													\
+		if((TABLE_PTR)->store != NULL){																\
+			_dmap_store_write_locked(TABLE_PTR);													\
+		}																							\
+	}																								\
+
+
+
 #define DMAP_DECL_W_UNLOCK_PROC(PROC_NAME)  														\
 	void PROC_NAME();   																			\
 
@@ -142,6 +176,23 @@
 
 
 
+//delivers the batched events of the subscribers and publishes the snapshot
+//of the changes before the lock is released
+#define DMAP_DEF_TABLE_W_UNLOCK_PROC(																\
+									  PROC_NAME,													\
+									  TABLE_PTR,													\
+									  DATA_NAME														\
+								)																	\
+																									\
+	void PROC_NAME()																				\
+	{																								\
+		dmap_table_flush(TABLE_PTR);																\
+		debug_wrunlock(DATA_NAME);																	\
+		rwmutex_write_unlock((TABLE_PTR)->rwmutex);													\
+	}																								\
+
+
+
 //---------------------------------------------------------------------------------------------------
 //----------------------------- TABLE MACROS --------------------------------------------------------
 //---------------------------------------------------------------------------------------------------
@@ -149,7 +200,7 @@
 #define DMAP_DECL_TABLE_ADD_VOIDT_PROC(																\
 										PROC_NAME													\
 									  )  			    											\
-	int32_t PROC_NAME(void *item, void (*item_dtor)(void*item))     								\
+	dmap_handle_t PROC_NAME(void *item, void (*item_dtor)(void*item)) 							\
 				__attribute__((nonnull (1,2)));   													\
 
 
@@ -158,9 +209,9 @@
 										PROC_NAME, 													\
 										TABLE_PTR													\
 									  )					  		    								\
-	int32_t PROC_NAME(void *item, void (*dtor)(void*))   											\
+	dmap_handle_t PROC_NAME(void *item, void (*dtor)(void*))   										\
 	{																							    \
-		int32_t result;																				\
+		dmap_handle_t result;																		\
 		dmap_row_t *row;																			\
 		row = _make_dmap_row(item, dtor);															\
 		result = _dmap_add_row(TABLE_PTR, row);														\
@@ -189,7 +240,7 @@
 									  TABLE_PTR, 													\
 									  DATA_TYPE														\
 									  ) 			  												\
-	int32_t PROC_NAME(DATA_TYPE* item)       														\
+	dmap_handle_t PROC_NAME(DATA_TYPE* item)       													\
 				__attribute__((nonnull (1)));   													\
 
 
@@ -200,9 +251,9 @@
 									  DATA_DTOR														\
 									 )			 	  												\
 									  	  	  	  	 											    \
-	int32_t PROC_NAME(DATA_TYPE* item)																\
+	dmap_handle_t PROC_NAME(DATA_TYPE* item)														\
 	{																								\
-		int32_t result;																				\
+		dmap_handle_t result;																		\
 		dmap_row_t *row;																			\
 		row = _make_dmap_row(item, DATA_DTOR);														\
 		result = _dmap_add_row(TABLE_PTR, row);														\
@@ -211,7 +262,7 @@
 
 
 #define DMAP_DECL_TABLE_REM_INDEX_PROC(PROC_NAME)  												    \
-	void PROC_NAME(int32_t dmap_index);   														    \
+	void PROC_NAME(dmap_handle_t handle);   													    \
 
 
 
@@ -220,9 +271,9 @@
 									  TABLE_PTR														\
 									 ) 				  												\
 									  	  	  	  	  											    \
-	void PROC_NAME(int32_t dmap_index)																\
+	void PROC_NAME(dmap_handle_t handle)															\
 	{																								\
-		_dmap_rem(TABLE_PTR, dmap_index);															\
+		_dmap_rem(TABLE_PTR, handle);																\
 	}												  												\
 
 
@@ -279,7 +330,7 @@
 								 PROC_NAME,															\
 								 RESULT_TYPE														\
 								)			  														\
-	RESULT_TYPE* PROC_NAME(int32_t dmap_index);   													\
+	RESULT_TYPE* PROC_NAME(dmap_handle_t handle);   												\
 
 
 #define DMAP_DEF_GET_TABLE_ITEM_BYINDX_PROC(			  											\
@@ -289,10 +340,10 @@
 								   )			 													\
 									  	  	  	  													\
 	RESULT_TYPE* PROC_NAME(																			\
-				   int32_t dmap_index	 															\
+				   dmap_handle_t handle	 															\
 				  )																					\
 	{																								\
-		return (RESULT_TYPE*) _dmap_get_item(TABLE_PTR, dmap_index);								\
+		return (RESULT_TYPE*) _dmap_get_item(TABLE_PTR, handle);									\
 	}																								\
 
 #define DMAP_DECL_VOIDT_TABLE(																		\
@@ -344,10 +395,10 @@
 		DMAP_DEF_TABLE_ADD_VOIDT_PROC(ADD_ITEM_PROC_NAME, &TABLE_VARIABLE);							\
 		DMAP_DEF_TABLE_REM_INDEX_PROC(REM_INDEX_PROC_NAME, &TABLE_VARIABLE);						\
 		DMAP_DEF_TABLE_REM_ITEM_PROC(REM_ITEM_PROC_NAME, void, &TABLE_VARIABLE); 					\
-		DMAP_DEF_R_LOCK_PROC(R_LOCK_TABLE_PROC_NAME, TABLE_VARIABLE.rwmutex, TABLE_NAME);			\
+		DMAP_DEF_TABLE_R_LOCK_PROC(R_LOCK_TABLE_PROC_NAME, &TABLE_VARIABLE, TABLE_NAME);			\
 		DMAP_DEF_R_UNLOCK_PROC(R_UNLOCK_TABLE_PROC_NAME, TABLE_VARIABLE.rwmutex, TABLE_NAME);		\
-		DMAP_DEF_W_LOCK_PROC(W_LOCK_TABLE_PROC_NAME, TABLE_VARIABLE.rwmutex, TABLE_NAME);			\
-		DMAP_DEF_W_UNLOCK_PROC(W_UNLOCK_TABLE_PROC_NAME, TABLE_VARIABLE.rwmutex, TABLE_NAME);		\
+		DMAP_DEF_TABLE_W_LOCK_PROC(W_LOCK_TABLE_PROC_NAME, &TABLE_VARIABLE, TABLE_NAME);			\
+		DMAP_DEF_TABLE_W_UNLOCK_PROC(W_UNLOCK_TABLE_PROC_NAME, &TABLE_VARIABLE, TABLE_NAME);		\
 		DMAP_DEF_ITR_TABLE_PROC(ITR_TABLE_PROC_NAME, void, &TABLE_VARIABLE);						\
 
 
@@ -404,10 +455,10 @@
 		DMAP_DEF_TABLE_ADD_SPECT_PROC(ADD_ITEM_PROC_NAME, &TABLE_VARIABLE, DATA_TYPE, DATA_DTOR);	\
 		DMAP_DEF_TABLE_REM_INDEX_PROC(REM_INDEX_PROC_NAME, &TABLE_VARIABLE);						\
 		DMAP_DEF_TABLE_REM_ITEM_PROC(REM_ITEM_PROC_NAME, DATA_TYPE, &TABLE_VARIABLE); 				\
-		DMAP_DEF_R_LOCK_PROC(R_LOCK_TABLE_PROC_NAME, TABLE_VARIABLE.rwmutex, TABLE_NAME);			\
+		DMAP_DEF_TABLE_R_LOCK_PROC(R_LOCK_TABLE_PROC_NAME, &TABLE_VARIABLE, TABLE_NAME);			\
 		DMAP_DEF_R_UNLOCK_PROC(R_UNLOCK_TABLE_PROC_NAME, TABLE_VARIABLE.rwmutex, TABLE_NAME);		\
-		DMAP_DEF_W_LOCK_PROC(W_LOCK_TABLE_PROC_NAME, TABLE_VARIABLE.rwmutex, TABLE_NAME);			\
-		DMAP_DEF_W_UNLOCK_PROC(W_UNLOCK_TABLE_PROC_NAME, TABLE_VARIABLE.rwmutex, TABLE_NAME);		\
+		DMAP_DEF_TABLE_W_LOCK_PROC(W_LOCK_TABLE_PROC_NAME, &TABLE_VARIABLE, TABLE_NAME);			\
+		DMAP_DEF_TABLE_W_UNLOCK_PROC(W_UNLOCK_TABLE_PROC_NAME, &TABLE_VARIABLE, TABLE_NAME);		\
 		DMAP_DEF_ITR_TABLE_PROC(ITR_TABLE_PROC_NAME, DATA_TYPE, &TABLE_VARIABLE);					\
 
 #define DMAP_DEF_SPECT_LOCAL_TABLE(																	\
@@ -448,12 +499,227 @@
 		DMAP_DEF_TABLE_ADD_SPECT_PROC(ADD_ITEM_PROC_NAME, &TABLE_VARIABLE, DATA_TYPE, DATA_DTOR);	\
 		DMAP_DEF_TABLE_REM_INDEX_PROC(REM_INDEX_PROC_NAME, &TABLE_VARIABLE);						\
 		DMAP_DEF_TABLE_REM_ITEM_PROC(REM_ITEM_PROC_NAME, DATA_TYPE, &TABLE_VARIABLE); 				\
-		DMAP_DEF_R_LOCK_PROC(R_LOCK_TABLE_PROC_NAME, TABLE_VARIABLE.rwmutex, TABLE_NAME);			\
+		DMAP_DEF_TABLE_R_LOCK_PROC(R_LOCK_TABLE_PROC_NAME, &TABLE_VARIABLE, TABLE_NAME);			\
 		DMAP_DEF_R_UNLOCK_PROC(R_UNLOCK_TABLE_PROC_NAME, TABLE_VARIABLE.rwmutex, TABLE_NAME);		\
-		DMAP_DEF_W_LOCK_PROC(W_LOCK_TABLE_PROC_NAME, TABLE_VARIABLE.rwmutex, TABLE_NAME);			\
-		DMAP_DEF_W_UNLOCK_PROC(W_UNLOCK_TABLE_PROC_NAME, TABLE_VARIABLE.rwmutex, TABLE_NAME);		\
+		DMAP_DEF_TABLE_W_LOCK_PROC(W_LOCK_TABLE_PROC_NAME, &TABLE_VARIABLE, TABLE_NAME);			\
+		DMAP_DEF_TABLE_W_UNLOCK_PROC(W_UNLOCK_TABLE_PROC_NAME, &TABLE_VARIABLE, TABLE_NAME);		\
+		DMAP_DEF_ITR_TABLE_PROC(ITR_TABLE_PROC_NAME, DATA_TYPE, &TABLE_VARIABLE);					\
+
+
+#define DMAP_DECL_STRIPED_TABLE(																	\
+						DATA_TYPE,																	\
+						GET_TABLE_PROC_NAME,														\
+						GET_ITEM_PROC_NAME,															\
+						ADD_ITEM_PROC_NAME,															\
+						REM_INDEX_PROC_NAME,														\
+						REM_ITEM_PROC_NAME,															\
+						R_LOCK_TABLE_PROC_NAME,														\
+						R_UNLOCK_TABLE_PROC_NAME,													\
+						W_LOCK_TABLE_PROC_NAME,														\
+						W_UNLOCK_TABLE_PROC_NAME,													\
+						R_LOCK_ROW_PROC_NAME,														\
+						R_UNLOCK_ROW_PROC_NAME,														\
+						W_LOCK_ROW_PROC_NAME,														\
+						W_UNLOCK_ROW_PROC_NAME,														\
+						ITR_TABLE_PROC_NAME															\
+						)																			\
+		DMAP_DECL_SPECT_TABLE(DATA_TYPE, GET_TABLE_PROC_NAME, GET_ITEM_PROC_NAME,					\
+				ADD_ITEM_PROC_NAME, REM_INDEX_PROC_NAME, REM_ITEM_PROC_NAME,						\
+				R_LOCK_TABLE_PROC_NAME, R_UNLOCK_TABLE_PROC_NAME, W_LOCK_TABLE_PROC_NAME,			\
+				W_UNLOCK_TABLE_PROC_NAME, ITR_TABLE_PROC_NAME);										\
+		void R_LOCK_ROW_PROC_NAME(dmap_handle_t handle);											\
+		void R_UNLOCK_ROW_PROC_NAME(dmap_handle_t handle);											\
+		void W_LOCK_ROW_PROC_NAME(dmap_handle_t handle);											\
+		void W_UNLOCK_ROW_PROC_NAME(dmap_handle_t handle);											\
+
+
+//A table locked in stripes instead of one lock. The row lock processes take
+//the stripe of the row of a handle only, under them the item of the row is
+//got and read or changed in place. The table lock processes take every stripe
+//and are needed for adding, removing and iterating rows, and for the indexes.
+//A thread holding a row lock must not lock the table or another row.
+#define DMAP_DEF_STRIPED_TABLE(																		\
+						DATA_TYPE,																	\
+						DATA_DTOR,																	\
+						TABLE_VARIABLE,																\
+						TABLE_NAME,																	\
+						TABLE_LENGTH,																\
+						STRIPES_NUM,																\
+						INIT_TABLE_PROC_NAME,														\
+						DEINIT_TABLE_PROC_NAME,														\
+						GET_TABLE_PROC_NAME,														\
+						GET_ITEM_PROC_NAME,															\
+						ADD_ITEM_PROC_NAME,															\
+						REM_INDEX_PROC_NAME,														\
+						REM_ITEM_PROC_NAME,															\
+						R_LOCK_TABLE_PROC_NAME,														\
+						R_UNLOCK_TABLE_PROC_NAME,													\
+						W_LOCK_TABLE_PROC_NAME,														\
+						W_UNLOCK_TABLE_PROC_NAME,													\
+						R_LOCK_ROW_PROC_NAME,														\
+						R_UNLOCK_ROW_PROC_NAME,														\
+						W_LOCK_ROW_PROC_NAME,														\
+						W_UNLOCK_ROW_PROC_NAME,														\
+						ITR_TABLE_PROC_NAME															\
+						)																			\
+		static dmap_table_t TABLE_VARIABLE;															\
+		static void INIT_TABLE_PROC_NAME()															\
+		{																							\
+			_dmap_striped_table_init(&TABLE_VARIABLE, TABLE_LENGTH, TABLE_NAME, STRIPES_NUM);		\
+		}																							\
+		DMAP_DEF_TABLE_DEINIT_PROC(DEINIT_TABLE_PROC_NAME, &TABLE_VARIABLE);						\
+		DMAP_DEF_GET_DATA_PROC(GET_TABLE_PROC_NAME, dmap_table_t, &TABLE_VARIABLE);					\
+		DMAP_DEF_GET_TABLE_ITEM_BYINDX_PROC(GET_ITEM_PROC_NAME, DATA_TYPE, &TABLE_VARIABLE);		\
+		DMAP_DEF_TABLE_ADD_SPECT_PROC(ADD_ITEM_PROC_NAME, &TABLE_VARIABLE, DATA_TYPE, DATA_DTOR);	\
+		DMAP_DEF_TABLE_REM_INDEX_PROC(REM_INDEX_PROC_NAME, &TABLE_VARIABLE);						\
+		DMAP_DEF_TABLE_REM_ITEM_PROC(REM_ITEM_PROC_NAME, DATA_TYPE, &TABLE_VARIABLE);				\
+		void R_LOCK_TABLE_PROC_NAME()																\
+		{																							\
+			debug_rdlock(TABLE_NAME);																\
+			_dmap_table_lock(&TABLE_VARIABLE, BOOL_FALSE);											\
+		}																							\
+		void R_UNLOCK_TABLE_PROC_NAME()																\
+		{																							\
+			debug_rdunlock(TABLE_NAME);																\
+			_dmap_table_unlock(&TABLE_VARIABLE, BOOL_FALSE);										\
+		}																							\
+		void W_LOCK_TABLE_PROC_NAME()																\
+		{																							\
+			debug_wrlock(TABLE_NAME);																\
+			_dmap_table_lock(&TABLE_VARIABLE, BOOL_TRUE);											\
+		}																							\
+		void W_UNLOCK_TABLE_PROC_NAME()																\
+		{																							\
+			debug_wrunlock(TABLE_NAME);																\
+			_dmap_table_unlock(&TABLE_VARIABLE, BOOL_TRUE);											\
+		}																							\
+		void R_LOCK_ROW_PROC_NAME(dmap_handle_t handle)												\
+		{																							\
+			rwmutex_read_lock(_dmap_table_stripe(&TABLE_VARIABLE, handle));							\
+		}																							\
+		void R_UNLOCK_ROW_PROC_NAME(dmap_handle_t handle)											\
+		{																							\
+			rwmutex_read_unlock(_dmap_table_stripe(&TABLE_VARIABLE, handle));						\
+		}																							\
+		void W_LOCK_ROW_PROC_NAME(dmap_handle_t handle)												\
+		{																							\
+			rwmutex_write_lock(_dmap_table_stripe(&TABLE_VARIABLE, handle));						\
+		}																							\
+		void W_UNLOCK_ROW_PROC_NAME(dmap_handle_t handle)											\
+		{																							\
+			rwmutex_write_unlock(_dmap_table_stripe(&TABLE_VARIABLE, handle));						\
+		}																							\
 		DMAP_DEF_ITR_TABLE_PROC(ITR_TABLE_PROC_NAME, DATA_TYPE, &TABLE_VARIABLE);					\
 
+
+//---------------------------------------------------------------------------------------------------
+//----------------------------- INDEX MACROS --------------------------------------------------------
+//---------------------------------------------------------------------------------------------------
+
+#define DMAP_DECL_TABLE_INDEX(																		\
+						DATA_TYPE,																	\
+						KEY_TYPE,																	\
+						GET_ITEM_PROC_NAME															\
+						)																			\
+	DATA_TYPE* GET_ITEM_PROC_NAME(const KEY_TYPE *key);   											\
+
+
+//Defines a secondary index on a table defined in the same file. KEY_PROC_NAME
+//returns with a pointer to the key of an item, HASH_PROC_NAME and EQUAL_PROC_NAME
+//get pointers to keys. INIT_INDEX_PROC_NAME has to be called after the table is
+//initialized, then the index is maintained on every add and remove.
+#define DMAP_DEF_TABLE_INDEX(																		\
+						DATA_TYPE,																	\
+						KEY_TYPE,																	\
+						TABLE_VARIABLE,																\
+						INDEX_VARIABLE,																\
+						INDEX_NAME,																	\
+						KEY_PROC_NAME,																\
+						HASH_PROC_NAME,																\
+						EQUAL_PROC_NAME,															\
+						INIT_INDEX_PROC_NAME,														\
+						GET_ITEM_PROC_NAME															\
+						)																			\
+		static dmap_index_t INDEX_VARIABLE;															\
+		static const void* INDEX_VARIABLE##_key(void *item)											\
+		{																							\
+			return KEY_PROC_NAME((DATA_TYPE*) item);												\
+		}																							\
+		static uint32_t INDEX_VARIABLE##_hash(const void *key)										\
+		{																							\
+			return HASH_PROC_NAME((const KEY_TYPE*) key);											\
+		}																							\
+		static bool_t INDEX_VARIABLE##_equal(const void *key1, const void *key2)					\
+		{																							\
+			return EQUAL_PROC_NAME((const KEY_TYPE*) key1, (const KEY_TYPE*) key2);				\
+		}																							\
+		static void INIT_INDEX_PROC_NAME()															\
+		{																							\
+			_dmap_index_init(&TABLE_VARIABLE, &INDEX_VARIABLE, INDEX_NAME, INDEX_VARIABLE##_key,	\
+					INDEX_VARIABLE##_hash, INDEX_VARIABLE##_equal);									\
+		}																							\
+		DATA_TYPE* GET_ITEM_PROC_NAME(const KEY_TYPE *key)											\
+		{																							\
+			return (DATA_TYPE*) _dmap_index_get(&INDEX_VARIABLE, key);								\
+		}																							\
+
+
+#define DMAP_DECL_TABLE_SNAPSHOT(																	\
+						DATA_TYPE,																	\
+						ENTER_PROC_NAME,															\
+						LEAVE_PROC_NAME,															\
+						ITR_PROC_NAME,																\
+						GET_ITEM_PROC_NAME															\
+						)																			\
+	dmap_snapshot_t* ENTER_PROC_NAME();																\
+	void LEAVE_PROC_NAME();																			\
+	bool_t ITR_PROC_NAME(dmap_snapshot_t *snapshot, int32_t *index, DATA_TYPE **item);				\
+	DATA_TYPE* GET_ITEM_PROC_NAME(dmap_handle_t handle);											\
+
+
+//Defines lock-free reading of a table defined in the same file. After
+//INIT_SNAPSHOT_PROC_NAME is called the readers iterate the snapshot returned
+//by ENTER_PROC_NAME and get items by handles until LEAVE_PROC_NAME without
+//locking the table; the writers keep using the lock based procedures. The
+//table may be striped, the snapshot is started under every stripe then.
+#define DMAP_DEF_TABLE_SNAPSHOT(																	\
+						DATA_TYPE,																	\
+						TABLE_VARIABLE,																\
+						INIT_SNAPSHOT_PROC_NAME,													\
+						ENTER_PROC_NAME,															\
+						LEAVE_PROC_NAME,															\
+						ITR_PROC_NAME,																\
+						GET_ITEM_PROC_NAME															\
+						)																			\
+		static void INIT_SNAPSHOT_PROC_NAME()														\
+		{																							\
+			_dmap_table_lock(&TABLE_VARIABLE, BOOL_TRUE);											\
+			dmap_table_snapshots(&TABLE_VARIABLE);													\
+			_dmap_table_unlock(&TABLE_VARIABLE, BOOL_TRUE);											\
+		}																							\
+		dmap_snapshot_t* ENTER_PROC_NAME()															\
+		{																							\
+			return dmap_snapshot_enter(&TABLE_VARIABLE);											\
+		}																							\
+		void LEAVE_PROC_NAME()																		\
+		{																							\
+			dmap_snapshot_leave();																	\
+		}																							\
+		bool_t ITR_PROC_NAME(dmap_snapshot_t *snapshot, int32_t *index, DATA_TYPE **item)			\
+		{																							\
+			if(snapshot == NULL || snapshot->rows_num <= *index){									\
+				*item = NULL;																		\
+				return BOOL_FALSE;																	\
+			}																						\
+			*item = (DATA_TYPE*) snapshot->rows[*index].item;										\
+			return BOOL_TRUE;																		\
+		}																							\
+		DATA_TYPE* GET_ITEM_PROC_NAME(dmap_handle_t handle)											\
+		{																							\
+			return (DATA_TYPE*) dmap_snapshot_get(&TABLE_VARIABLE, handle);							\
+		}																							\
+
+
 //---------------------------------------------------------------------------------------------------
 //------------------------- DATA ITEM MACROS --------------------------------------------------------
 //---------------------------------------------------------------------------------------------------
@@ -485,4 +751,96 @@
 		DMAP_DEF_M_UNLOCK_PROC(UNLOCK_ITEM_PROC_NAME, MUTEX_VARIABLE, ITEM_NAME)					\
 
 
+#define DMAP_DECL_VERSIONED_ITEM(																	\
+						ITEM_TYPE,																	\
+						GET_ITEM_PROC_NAME,															\
+						BEGIN_ITEM_PROC_NAME,														\
+						COMMIT_ITEM_PROC_NAME,														\
+						ABORT_ITEM_PROC_NAME,														\
+						SUBSCRIBE_ITEM_PROC_NAME,													\
+						UNSUBSCRIBE_ITEM_PROC_NAME													\
+						)																			\
+		const ITEM_TYPE* GET_ITEM_PROC_NAME();														\
+		ITEM_TYPE* BEGIN_ITEM_PROC_NAME();															\
+		void COMMIT_ITEM_PROC_NAME(ITEM_TYPE *item);												\
+		void ABORT_ITEM_PROC_NAME(ITEM_TYPE *item);													\
+		void SUBSCRIBE_ITEM_PROC_NAME(dmap_subscription_t *subscription);							\
+		void UNSUBSCRIBE_ITEM_PROC_NAME(dmap_subscription_t *subscription);							\
+
+
+//An item published as immutable versions instead of being locked. Readers get
+//the current version by one atomic load and may use it until their ebr_leave,
+//so a reader of every packet enters once for its batch. A writer changes the
+//copy returned by BEGIN_ITEM_PROC_NAME, which excludes the other writers until
+//COMMIT_ITEM_PROC_NAME publishes it or ABORT_ITEM_PROC_NAME drops it. The
+//ITEM_TYPE needs a uint64_t version field, counted by the commits. The
+//subscribers get an update event of every commit with the new version.
+#define DMAP_DEF_VERSIONED_ITEM(																	\
+						ITEM_TYPE,																	\
+						ITEM_VARIABLE,																\
+						MUTEX_VARIABLE,																\
+						ITEM_NAME,																	\
+						INIT_ITEM_PROC_NAME,														\
+						DEINIT_ITEM_PROC_NAME,														\
+						GET_ITEM_PROC_NAME,															\
+						BEGIN_ITEM_PROC_NAME,														\
+						COMMIT_ITEM_PROC_NAME,														\
+						ABORT_ITEM_PROC_NAME,														\
+						SUBSCRIBE_ITEM_PROC_NAME,													\
+						UNSUBSCRIBE_ITEM_PROC_NAME													\
+						)																			\
+		static ITEM_TYPE *volatile ITEM_VARIABLE;													\
+		static mutex_t *MUTEX_VARIABLE;																\
+		static dmap_subscription_t *ITEM_VARIABLE##_subscriptions;									\
+		static void INIT_ITEM_PROC_NAME()															\
+		{																							\
+			MUTEX_VARIABLE = mutex_ctor();															\
+			ebr_publish((void *volatile*) &ITEM_VARIABLE, calloc(1, sizeof(ITEM_TYPE)), free);		\
+		}																							\
+		static void DEINIT_ITEM_PROC_NAME()															\
+		{																							\
+			ebr_publish((void *volatile*) &ITEM_VARIABLE, NULL, free);								\
+			mutex_dtor(MUTEX_VARIABLE);																\
+		}																							\
+		const ITEM_TYPE* GET_ITEM_PROC_NAME()														\
+		{																							\
+			return (const ITEM_TYPE*) ebr_read((void *volatile*) &ITEM_VARIABLE);					\
+		}																							\
+		ITEM_TYPE* BEGIN_ITEM_PROC_NAME()															\
+		{																							\
+			ITEM_TYPE *result = (ITEM_TYPE*) malloc(sizeof(ITEM_TYPE));								\
+			debug_lock(ITEM_NAME);																	\
+			mutex_lock(MUTEX_VARIABLE);																\
+			memcpy(result, (const void*) ITEM_VARIABLE, sizeof(ITEM_TYPE));							\
+			return result;																			\
+		}																							\
+		void COMMIT_ITEM_PROC_NAME(ITEM_TYPE *item)													\
+		{																							\
+			item->version = ITEM_VARIABLE->version + 1;												\
+			ebr_publish((void *volatile*) &ITEM_VARIABLE, item, free);								\
+			_dmap_notify(ITEM_VARIABLE##_subscriptions, DMAP_EVENT_UPDATE, item->version, item);	\
+			_dmap_flush(ITEM_VARIABLE##_subscriptions);												\
+			debug_unlock(ITEM_NAME);																\
+			mutex_unlock(MUTEX_VARIABLE);															\
+		}																							\
+		void ABORT_ITEM_PROC_NAME(ITEM_TYPE *item)													\
+		{																							\
+			free(item);																				\
+			debug_unlock(ITEM_NAME);																\
+			mutex_unlock(MUTEX_VARIABLE);															\
+		}																							\
+		void SUBSCRIBE_ITEM_PROC_NAME(dmap_subscription_t *subscription)							\
+		{																							\
+			mutex_lock(MUTEX_VARIABLE);																\
+			_dmap_subscribe(&ITEM_VARIABLE##_subscriptions, subscription);							\
+			mutex_unlock(MUTEX_VARIABLE);															\
+		}																							\
+		void UNSUBSCRIBE_ITEM_PROC_NAME(dmap_subscription_t *subscription)							\
+		{																							\
+			mutex_lock(MUTEX_VARIABLE);																\
+			_dmap_unsubscribe(&ITEM_VARIABLE##_subscriptions, subscription);						\
+			mutex_unlock(MUTEX_VARIABLE);															\
+		}																							\
+
+
 #endif /* INCGUARD_DMAP_PREDEFS_H_ */
@@ -20,17 +20,24 @@ void dmap_rem_pths_byconid(int32_t con_dmap_id)
 */
 
 
-//Example for searching dmap for field
-//operation_t* dmap_get_operation_by_name(char_t* name)
+//Example for searching dmap for field, an index finds the row without
+//iterating the table. It is defined in dmap.c next to the table and
+//declared in dmap.h by
+//DMAP_DECL_TABLE_INDEX(operation_t, char_t, dmap_get_operation_by_name)
+//static const char_t* _operation_name(operation_t* operation)
 //{
-//  int32_t    index;
-//  operation_t* result = NULL;
-//  for(index = 0; dmap_itr_table_operations(&index, &result) == BOOL_TRUE; ++index){
-//      if(strcmp(name, result->name) == 0){
-//        return result;
-//      }
-//  }
-//  return NULL;
+//  return operation->name;
 //}
-
-
+//
+//DMAP_DEF_TABLE_INDEX(
+//  operation_t,                  /*type of the items stored in the table*/
+//  char_t,                       /*type of the keys*/
+//  _dmap_table_operations,       /*name of the variable reference to the table*/
+//  _dmap_index_operation_names,  /*name of the variable reference to the index*/
+//  "Operation names",            /*name of the index*/
+//  _operation_name,              /*name of the process gets the key of an item*/
+//  dmap_hash_str,                /*name of the process hashes a key*/
+//  dmap_equal_str,               /*name of the process compares two keys*/
+//  dmap_init_index_operation_names, /*name of the process initialize the index after the table*/
+//  dmap_get_operation_by_name    /*name of the process gets an item by its key*/
+//);
@@ -0,0 +1,715 @@
+#include "dmap_store.h"
+#include "dmap.h"
+#include "lib_defs.h"
+#include "lib_descs.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "lib_debuglog.h"
+
+//The file holds a header and a fixed number of records of the same size. An
+//item is allocated from the free records and stays in the file until it is
+//removed from the table, so after a restart the used records are added to the
+//table again instead of rebuilding the items. The free list is rebuilt at the
+//same time, the handles of the rows are new ones.
+//
+//A shared table keeps the same layout in a named shared memory region mapped
+//by several processes. The free list and the lock of the table are in the
+//header and shared between the processes; each process has its own table of
+//rows pointing into its mapping, brought up to date by dmap_table_refresh
+//when the generation of the header changed. The lock processes of the table
+//do it before they return, so the rows are current while the table is locked.
+
+static dmap_store_t* _dmap_stores[DMAP_STORES_MAX];
+
+static dmap_storerecord_t* _dmap_store_record(dmap_store_t *store, int32_t index)
+{
+	return (dmap_storerecord_t*) (store->mapping + DMAP_STORE_HEADER_SIZE + store->record_size * index);
+}
+
+static int32_t _dmap_store_index(dmap_store_t *store, void *item)
+{
+	char *record = (char*) item - offsetof(dmap_storerecord_t, item);
+	return (int32_t) ((record - store->mapping - DMAP_STORE_HEADER_SIZE) / store->record_size);
+}
+
+static dmap_store_t* _dmap_store_find(void *item)
+{
+	int32_t index;
+	for(index = 0; index < DMAP_STORES_MAX; ++index){
+		if(_dmap_stores[index] != NULL &&
+		   _dmap_stores[index]->mapping <= (char*) item &&
+		   (char*) item < _dmap_stores[index]->mapping + _dmap_stores[index]->length){
+			return _dmap_stores[index];
+		}
+	}
+	return NULL;
+}
+
+static void _dmap_store_keep(void *item __attribute__((unused)))
+{
+	//the item stays in the file for the next start
+}
+
+//a process died holding the lock, the free list is changed by a few
+//stores only, so it is taken over as it is
+static void _dmap_store_lock(dmap_store_t *store)
+{
+	if(pthread_mutex_lock(&store->header->lock) == EOWNERDEAD){
+		WARNINGPRINT("%s: the free list was locked by a terminated process", store->path);
+		pthread_mutex_consistent(&store->header->lock);
+	}
+}
+
+static void _dmap_store_unlock(dmap_store_t *store)
+{
+	pthread_mutex_unlock(&store->header->lock);
+}
+
+//the rows of this process follow its own changes, the table is refreshed
+//only if another process changed the records since the last refresh
+static void _dmap_store_changed(dmap_store_t *store, uint64_t generation)
+{
+	if(store->generation + 1 == generation){
+		store->generation = generation;
+	}
+}
+
+//the header of an existing file is kept if it describes the same items,
+//a file of other items is started again
+static bool_t _dmap_store_check(dmap_store_t *store, uint32_t item_size, uint32_t version, size_t file_size)
+{
+	dmap_storeheader_t header;
+	if(file_size < DMAP_STORE_HEADER_SIZE || pread(store->fd, &header, sizeof(header), 0) != sizeof(header)){
+		return BOOL_FALSE;
+	}
+	if(memcmp(header.magic, DMAP_STORE_MAGIC, sizeof(header.magic)) != 0 || header.format != DMAP_STORE_FORMAT){
+		WARNINGPRINT("%s is not a dmap store of this format, it is started again", store->path);
+		return BOOL_FALSE;
+	}
+	if(header.item_size != item_size || header.version != version){
+		WARNINGPRINT("%s holds items of version %u and size %u instead of %u and %u, it is started again",
+				store->path, header.version, header.item_size, version, item_size);
+		return BOOL_FALSE;
+	}
+	if(file_size < DMAP_STORE_HEADER_SIZE + store->record_size * header.capacity){
+		WARNINGPRINT("%s is truncated, it is started again", store->path);
+		return BOOL_FALSE;
+	}
+	return BOOL_TRUE;
+}
+
+static dmap_store_t* _dmap_store_ctor(dmap_table_t *table, const char_t *path, uint32_t item_size)
+{
+	dmap_store_t *result;
+	int32_t       index;
+	for(index = 0; index < DMAP_STORES_MAX; ++index){
+		if(_dmap_stores[index] == NULL){
+			break;
+		}
+	}
+	if(table->store != NULL || index == DMAP_STORES_MAX){
+		runtime_warning("dmap_store: %s can not be kept in %s", table->name, path);
+		return NULL;
+	}
+	result = (dmap_store_t*) calloc(1, sizeof(dmap_store_t));
+	strncpy(result->path, path, sizeof(result->path) - 1);
+	result->record_size = (sizeof(dmap_storerecord_t) + item_size + 7) & ~(size_t) 7;
+	result->fd = -1;
+	return result;
+}
+
+static void _dmap_store_dtor(dmap_store_t *store)
+{
+	if(store->mapping != NULL){
+		munmap(store->mapping, store->length);
+	}
+	if(0 <= store->fd){
+		close(store->fd);
+	}
+	free(store->stamps);
+	free(store);
+}
+
+static bool_t _dmap_store_map(dmap_store_t *store)
+{
+	store->mapping = (char*) mmap(NULL, store->length, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+	if(store->mapping == MAP_FAILED){
+		store->mapping = NULL;
+		return BOOL_FALSE;
+	}
+	store->header = (dmap_storeheader_t*) store->mapping;
+	return BOOL_TRUE;
+}
+
+//writes the header of a file opened by this process only or of a region
+//created by it, the free list is made of the records not used
+static void _dmap_store_init_header(dmap_store_t *store, uint32_t item_size, uint32_t version, int32_t capacity)
+{
+	dmap_storeheader_t  *header = store->header;
+	dmap_storerecord_t  *record;
+	pthread_mutexattr_t  mutex_attr;
+	pthread_rwlockattr_t rwmutex_attr;
+	int32_t              index;
+	memcpy(header->magic, DMAP_STORE_MAGIC, sizeof(header->magic));
+	header->version = version;
+	header->item_size = item_size;
+	header->capacity = capacity;
+	header->free_first = -1;
+	header->used_num = 0;
+	header->attached = store->shared == BOOL_TRUE ? 1 : 0;
+	header->generation = 1;
+	pthread_mutexattr_init(&mutex_attr);
+	pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&header->lock, &mutex_attr);
+	pthread_mutexattr_destroy(&mutex_attr);
+	pthread_rwlockattr_init(&rwmutex_attr);
+	pthread_rwlockattr_setpshared(&rwmutex_attr, PTHREAD_PROCESS_SHARED);
+	pthread_rwlock_init(&header->rwmutex, &rwmutex_attr);
+	pthread_rwlockattr_destroy(&rwmutex_attr);
+	for(index = capacity - 1; 0 <= index; --index){
+		record = _dmap_store_record(store, index);
+		if(record->state == DMAP_STORE_USED){
+			++header->used_num;
+			continue;
+		}
+		record->next_free = header->free_first;
+		header->free_first = index;
+	}
+	//the processes attaching to a region wait for the format
+	__atomic_store_n(&header->format, DMAP_STORE_FORMAT, __ATOMIC_RELEASE);
+}
+
+static int32_t _dmap_store_attach(dmap_table_t *table, dmap_store_t *store)
+{
+	int32_t index;
+	store->stamps = (uint64_t*) calloc(store->header->capacity, sizeof(uint64_t));
+	for(index = 0; index < DMAP_STORES_MAX; ++index){
+		if(_dmap_stores[index] == NULL){
+			_dmap_stores[index] = store;
+			break;
+		}
+	}
+	table->store = store;
+	return dmap_table_refresh(table);
+}
+
+//Makes the items of the table persistent in the file at path. Called after
+//the table is initialized and before it is used. The rows found in the file
+//are added to the table; a file written with another version or item size is
+//cleared. The file grows to the capacity if it has fewer records. Returns the
+//number of rows added, or -1 if the file can not be used.
+int32_t dmap_table_persist(dmap_table_t *table, const char_t *path, uint32_t item_size,
+                           uint32_t version, int32_t capacity)
+{
+	dmap_store_t       *store;
+	struct stat         file_stat;
+	bool_t              reattach;
+	int32_t             result;
+	store = _dmap_store_ctor(table, path, item_size);
+	if(store == NULL){
+		return -1;
+	}
+	store->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if(store->fd < 0 || fstat(store->fd, &file_stat) < 0){
+		runtime_warning("dmap_table_persist: %s can not be opened for %s", path, table->name);
+		goto error;
+	}
+	reattach = _dmap_store_check(store, item_size, version, file_stat.st_size);
+	if(reattach == BOOL_FALSE){
+		if(ftruncate(store->fd, 0) < 0){
+			goto error;
+		}
+		file_stat.st_size = 0;
+	}
+	if(reattach == BOOL_TRUE){
+		dmap_storeheader_t header;
+		if(pread(store->fd, &header, sizeof(header), 0) != sizeof(header)){
+			goto error;
+		}
+		capacity = MAX(capacity, header.capacity);
+	}
+	store->length = DMAP_STORE_HEADER_SIZE + store->record_size * capacity;
+	if((off_t) store->length != file_stat.st_size && ftruncate(store->fd, store->length) < 0){
+		runtime_warning("dmap_table_persist: %s can not be resized for %s", path, table->name);
+		goto error;
+	}
+	if(_dmap_store_map(store) == BOOL_FALSE){
+		runtime_warning("dmap_table_persist: %s can not be mapped for %s", path, table->name);
+		goto error;
+	}
+	_dmap_store_init_header(store, item_size, version, capacity);
+	result = _dmap_store_attach(table, store);
+	INFOPRINT("%s: %d rows reattached from %s", table->name, result, path);
+	return result;
+error:
+	_dmap_store_dtor(store);
+	return -1;
+}
+
+//waits for the process created the region to write its header
+static bool_t _dmap_store_wait(dmap_store_t *store, dmap_storeheader_t *header)
+{
+	int32_t tries;
+	for(tries = 0; tries < DMAP_STORE_ATTACH_TRIES; ++tries){
+		if(pread(store->fd, header, sizeof(dmap_storeheader_t), 0) == sizeof(dmap_storeheader_t) &&
+		   header->format == DMAP_STORE_FORMAT &&
+		   memcmp(header->magic, DMAP_STORE_MAGIC, sizeof(header->magic)) == 0){
+			return BOOL_TRUE;
+		}
+		thread_sleep(1);
+	}
+	return BOOL_FALSE;
+}
+
+//a region without a header after the wait is left by a creator terminated
+//before writing it, its lock on the region is released by then; the region
+//is removed unless another process removed it and created it again meanwhile
+static bool_t _dmap_store_abandoned(dmap_store_t *store)
+{
+	dmap_storeheader_t header;
+	struct stat        opened, named;
+	bool_t             result = BOOL_FALSE;
+	int                fd;
+	if(flock(store->fd, LOCK_EX | LOCK_NB) < 0){
+		return BOOL_FALSE;
+	}
+	fd = shm_open(store->path, O_RDWR, 0);
+	if(0 <= fd && fstat(fd, &named) == 0 && fstat(store->fd, &opened) == 0 && named.st_ino == opened.st_ino &&
+	   (pread(store->fd, &header, sizeof(header), 0) != sizeof(header) || header.format == 0)){
+		shm_unlink(store->path);
+		result = BOOL_TRUE;
+	}
+	if(0 <= fd){
+		close(fd);
+	}
+	flock(store->fd, LOCK_UN);
+	return result;
+}
+
+//Places the items of the table in the shared memory region of name, which
+//starts with a slash, used by every process calling it with the same name. The first
+//process creates the region with the capacity, the others attach to it and
+//add its used records to their table. The lock processes of the table lock
+//it in every process from then on. A region of another version or item size
+//is not used. A region left without a header by a terminated creator is
+//created again. Returns the number of rows added, or -1 if the region can
+//not be used.
+int32_t dmap_table_share(dmap_table_t *table, const char_t *name, uint32_t item_size,
+                         uint32_t version, int32_t capacity)
+{
+	dmap_store_t       *store;
+	dmap_storeheader_t  header;
+	struct stat         file_stat;
+	bool_t              created = BOOL_FALSE;
+	bool_t              ready;
+	int32_t             result;
+	if(0 < table->stripes_num){
+		runtime_warning("dmap_table_share: the striped table %s can not be shared", table->name);
+		return -1;
+	}
+	store = _dmap_store_ctor(table, name, item_size);
+	if(store == NULL){
+		return -1;
+	}
+	store->shared = BOOL_TRUE;
+	store->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if(0 <= store->fd){
+		//held until the header is written, released by the kernel if this process dies
+		flock(store->fd, LOCK_EX);
+		created = BOOL_TRUE;
+		store->length = DMAP_STORE_HEADER_SIZE + store->record_size * capacity;
+		if(ftruncate(store->fd, store->length) < 0 || _dmap_store_map(store) == BOOL_FALSE){
+			runtime_warning("dmap_table_share: %s can not be created for %s", name, table->name);
+			goto error;
+		}
+		_dmap_store_init_header(store, item_size, version, capacity);
+		flock(store->fd, LOCK_UN);
+	}else{
+		store->fd = errno == EEXIST ? shm_open(name, O_RDWR, 0) : -1;
+		ready = 0 <= store->fd ? _dmap_store_wait(store, &header) : BOOL_FALSE;
+		if(ready == BOOL_FALSE && 0 <= store->fd && _dmap_store_abandoned(store) == BOOL_TRUE){
+			WARNINGPRINT("%s: left without a header by a terminated process, created again", name);
+			_dmap_store_dtor(store);
+			return dmap_table_share(table, name, item_size, version, capacity);
+		}
+		if(ready == BOOL_FALSE){
+			runtime_warning("dmap_table_share: %s can not be opened for %s", name, table->name);
+			goto error;
+		}
+		if(header.item_size != item_size || header.version != version){
+			runtime_warning("dmap_table_share: %s holds items of version %u and size %u instead of %u and %u",
+					name, header.version, header.item_size, version, item_size);
+			goto error;
+		}
+		store->length = DMAP_STORE_HEADER_SIZE + store->record_size * header.capacity;
+		if(fstat(store->fd, &file_stat) < 0 || file_stat.st_size < (off_t) store->length ||
+		   _dmap_store_map(store) == BOOL_FALSE){
+			runtime_warning("dmap_table_share: %s can not be mapped for %s", name, table->name);
+			goto error;
+		}
+		_dmap_store_lock(store);
+		++store->header->attached;
+		_dmap_store_unlock(store);
+	}
+	rwmutex_dtor(table->rwmutex);
+	free(table->rwmutex);
+	table->rwmutex = &store->header->rwmutex;
+	result = _dmap_store_attach(table, store);
+	INFOPRINT("%s: %d rows attached from %s", table->name, result, name);
+	return result;
+error:
+	if(created == BOOL_TRUE){
+		shm_unlink(name);
+	}
+	_dmap_store_dtor(store);
+	return -1;
+}
+
+//Brings the rows of the table up to date with the records of its store,
+//changed by other processes sharing it. Rows of freed or reallocated records
+//are removed, used records without a row are added; the other rows keep
+//their handles. Called with the table write locked, the lock processes of a
+//shared table call it when the records changed. Returns the number of rows
+//added and removed.
+int32_t dmap_table_refresh(dmap_table_t *table)
+{
+	dmap_store_t       *store = table->store;
+	dmap_storerecord_t *record;
+	dmap_row_t         *row;
+	uint64_t           *current;
+	uint64_t            generation;
+	int32_t             index, slot, result = 0;
+	if(store == NULL){
+		return 0;
+	}
+	generation = __atomic_load_n(&store->header->generation, __ATOMIC_ACQUIRE);
+	if(generation == store->generation){
+		return 0;
+	}
+	current = (uint64_t*) malloc(store->header->capacity * sizeof(uint64_t));
+	_dmap_store_lock(store);
+	for(index = 0; index < store->header->capacity; ++index){
+		record = _dmap_store_record(store, index);
+		current[index] = record->state == DMAP_STORE_USED ? record->stamp : 0;
+	}
+	store->generation = store->header->generation;
+	_dmap_store_unlock(store);
+	for(slot = 0; _dmap_itr_table(table, &slot, &row) == BOOL_TRUE; ++slot){
+		if(row->dtor != dmap_store_free){
+			continue;
+		}
+		index = _dmap_store_index(store, row->item);
+		if(current[index] != store->stamps[index]){
+			store->stamps[index] = 0;
+			row->dtor = _dmap_store_keep;
+			_dmap_rem_slot(table, slot);
+			++result;
+		}
+	}
+	for(index = 0; index < store->header->capacity; ++index){
+		if(current[index] != 0 && current[index] != store->stamps[index]){
+			store->stamps[index] = current[index];
+			_dmap_add_row(table, _make_dmap_row(_dmap_store_record(store, index)->item, dmap_store_free));
+			++result;
+		}
+	}
+	free(current);
+	return result;
+}
+
+//returns with a zeroed item in the file, or NULL if every record is used;
+//the item is added to the table by its add process as any other
+void* dmap_store_alloc(dmap_table_t *table)
+{
+	dmap_store_t       *store = table->store;
+	dmap_storerecord_t *record;
+	int32_t             index;
+	if(store == NULL){
+		return NULL;
+	}
+	_dmap_store_lock(store);
+	index = store->header->free_first;
+	if(index < 0){
+		_dmap_store_unlock(store);
+		return NULL;
+	}
+	record = _dmap_store_record(store, index);
+	store->header->free_first = record->next_free;
+	++store->header->used_num;
+	memset(record->item, 0, store->header->item_size);
+	record->stamp = ++store->header->generation;
+	record->state = DMAP_STORE_USED;
+	store->stamps[index] = record->stamp;
+	_dmap_store_changed(store, record->stamp);
+	_dmap_store_unlock(store);
+	return record->item;
+}
+
+//the destructor of the items of a persistent or shared table
+void dmap_store_free(void *item)
+{
+	dmap_store_t       *store = _dmap_store_find(item);
+	dmap_storerecord_t *record;
+	int32_t             index;
+	if(store == NULL){
+		runtime_warning("dmap_store_free: %p is not in a dmap store", item);
+		return;
+	}
+	index = _dmap_store_index(store, item);
+	record = _dmap_store_record(store, index);
+	_dmap_store_lock(store);
+	record->state = 0;
+	record->stamp = 0;
+	record->next_free = store->header->free_first;
+	store->header->free_first = index;
+	--store->header->used_num;
+	store->stamps[index] = 0;
+	_dmap_store_changed(store, ++store->header->generation);
+	_dmap_store_unlock(store);
+}
+
+//the reference of an item of the store, valid in every process sharing it
+dmap_storeref_t dmap_store_ref(dmap_table_t *table, void *item)
+{
+	dmap_store_t *store = table->store;
+	if(store == NULL || item == NULL ||
+	   (char*) item < store->mapping + DMAP_STORE_HEADER_SIZE || store->mapping + store->length <= (char*) item){
+		return 0;
+	}
+	return _dmap_store_index(store, item) + 1;
+}
+
+//returns with NULL if the record of the reference is freed meanwhile
+void* dmap_store_deref(dmap_table_t *table, dmap_storeref_t ref)
+{
+	dmap_store_t       *store = table->store;
+	dmap_storerecord_t *record;
+	if(store == NULL || ref <= 0 || store->header->capacity < ref){
+		return NULL;
+	}
+	record = _dmap_store_record(store, ref - 1);
+	return record->state == DMAP_STORE_USED ? record->item : NULL;
+}
+
+//writes the changed pages of the file, the kernel does it anyway unless the machine stops
+void dmap_table_sync(dmap_table_t *table)
+{
+	if(table->store != NULL){
+		msync(table->store->mapping, table->store->length, MS_SYNC);
+	}
+}
+
+//called by the read lock process of a table holding the lock; the lock is
+//taken for writing while the rows are refreshed, so the thread holding the
+//lock of a shared table must not lock it again
+void _dmap_store_read_locked(dmap_table_t *table)
+{
+	dmap_store_t *store = table->store;
+	if(store->shared == BOOL_FALSE){
+		return;
+	}
+	while(__atomic_load_n(&store->header->generation, __ATOMIC_ACQUIRE) != store->generation){
+		rwmutex_read_unlock(table->rwmutex);
+		rwmutex_write_lock(table->rwmutex);
+		dmap_table_refresh(table);
+		dmap_table_flush(table);
+		rwmutex_write_unlock(table->rwmutex);
+		rwmutex_read_lock(table->rwmutex);
+	}
+}
+
+//called by the write lock process of a table holding the lock
+void _dmap_store_write_locked(dmap_table_t *table)
+{
+	if(table->store->shared == BOOL_TRUE){
+		dmap_table_refresh(table);
+	}
+}
+
+//called by the deinit of the table before its rows are removed, their items are kept
+void _dmap_store_detach(dmap_table_t *table)
+{
+	dmap_row_t *row;
+	int32_t     index;
+	for(index = 0; _dmap_itr_table(table, &index, &row) == BOOL_TRUE; ++index){
+		if(row->dtor == dmap_store_free){
+			row->dtor = _dmap_store_keep;
+		}
+	}
+}
+
+//called by the deinit of the table after its rows are removed; the last
+//process detaching from a shared region removes it
+void _dmap_store_close(dmap_table_t *table)
+{
+	dmap_store_t *store = table->store;
+	bool_t        last = BOOL_FALSE;
+	int32_t       index;
+	for(index = 0; index < DMAP_STORES_MAX; ++index){
+		if(_dmap_stores[index] == store){
+			_dmap_stores[index] = NULL;
+		}
+	}
+	if(store->shared == BOOL_TRUE){
+		_dmap_store_lock(store);
+		last = --store->header->attached == 0 ? BOOL_TRUE : BOOL_FALSE;
+		_dmap_store_unlock(store);
+		table->rwmutex = NULL;
+	}else{
+		msync(store->mapping, store->length, MS_SYNC);
+	}
+	if(last == BOOL_TRUE){
+		shm_unlink(store->path);
+	}
+	_dmap_store_dtor(store);
+	table->store = NULL;
+}
+
+typedef struct _dmap_store_test_item_struct_t{
+	int32_t     id;
+	char_t      name[12];
+}_dmap_store_test_item_t;
+
+//adds the item of a record allocated for the table as the applications do
+static void* _dmap_store_test_add(dmap_table_t *table, int32_t id)
+{
+	_dmap_store_test_item_t *item = (_dmap_store_test_item_t*) dmap_store_alloc(table);
+	if(item != NULL){
+		item->id = id;
+		snprintf(item->name, sizeof(item->name), "item %d", id);
+		_dmap_add_row(table, _make_dmap_row(item, dmap_store_free));
+	}
+	return item;
+}
+
+//the bit of every id found in the table, -1 if an item is not intact
+static int32_t _dmap_store_test_ids(dmap_table_t *table)
+{
+	_dmap_store_test_item_t *item;
+	dmap_row_t *row;
+	char_t      name[12];
+	int32_t     index, result = 0;
+	for(index = 0; _dmap_itr_table(table, &index, &row) == BOOL_TRUE; ++index){
+		item = (_dmap_store_test_item_t*) row->item;
+		snprintf(name, sizeof(name), "item %d", item->id);
+		if(item->id < 0 || 31 <= item->id || strcmp(name, item->name) != 0){
+			return -1;
+		}
+		result |= 1 << item->id;
+	}
+	return result;
+}
+
+void dmap_store_test(void)
+{
+	dmap_table_t             table, other;
+	_dmap_store_test_item_t *items[8];
+	char_t                   path[64];
+	int32_t                  index, fd, failed = 0;
+
+	snprintf(path, sizeof(path), "/tmp/dmap_store_test_%d", (int) getpid());
+	unlink(path);
+
+	//a new file is empty and holds as many items as its capacity
+	memset(&table, 0, sizeof(table));
+	_dmap_table_init(&table, 16, "dmap_store_test");
+	failed += dmap_table_persist(&table, path, sizeof(_dmap_store_test_item_t), 1, 8) != 0;
+	for(index = 0; index < 8; ++index){
+		items[index] = _dmap_store_test_add(&table, index);
+		failed += items[index] == NULL;
+	}
+	failed += _dmap_store_test_add(&table, 8) != NULL;
+	failed += dmap_store_deref(&table, dmap_store_ref(&table, items[5])) != items[5];
+	failed += dmap_store_deref(&table, 0) != NULL || dmap_store_deref(&table, 9) != NULL;
+	_dmap_rem_item(&table, items[0]);
+	_dmap_rem_item(&table, items[7]);
+	failed += dmap_store_deref(&table, 8) != NULL;
+	_dmap_table_deinit(&table);
+
+	//the rows are added again after a restart and the freed records are reused
+	memset(&table, 0, sizeof(table));
+	_dmap_table_init(&table, 16, "dmap_store_test");
+	failed += dmap_table_persist(&table, path, sizeof(_dmap_store_test_item_t), 1, 8) != 6;
+	failed += table.rows_num != 6 || _dmap_store_test_ids(&table) != 0x7E;
+	failed += _dmap_store_test_add(&table, 10) == NULL || _dmap_store_test_add(&table, 11) == NULL;
+	failed += _dmap_store_test_add(&table, 12) != NULL;
+	_dmap_table_deinit(&table);
+
+	//a larger capacity keeps the rows, fewer does not shrink the file
+	memset(&table, 0, sizeof(table));
+	_dmap_table_init(&table, 16, "dmap_store_test");
+	failed += dmap_table_persist(&table, path, sizeof(_dmap_store_test_item_t), 1, 10) != 8;
+	failed += _dmap_store_test_ids(&table) != 0xC7E;
+	failed += _dmap_store_test_add(&table, 20) == NULL || _dmap_store_test_add(&table, 21) == NULL;
+	failed += _dmap_store_test_add(&table, 22) != NULL;
+	_dmap_table_deinit(&table);
+	memset(&table, 0, sizeof(table));
+	_dmap_table_init(&table, 16, "dmap_store_test");
+	failed += dmap_table_persist(&table, path, sizeof(_dmap_store_test_item_t), 1, 4) != 10;
+	failed += _dmap_store_test_ids(&table) != 0x300C7E;
+	_dmap_table_deinit(&table);
+
+	//a file of another version is started again
+	memset(&table, 0, sizeof(table));
+	_dmap_table_init(&table, 16, "dmap_store_test");
+	failed += dmap_table_persist(&table, path, sizeof(_dmap_store_test_item_t), 2, 4) != 0;
+	failed += table.rows_num != 0;
+	_dmap_table_deinit(&table);
+	unlink(path);
+
+	//the lock processes of a shared table refresh the rows changed by another table of the region
+	snprintf(path, sizeof(path), "/dmap_store_test_%d", (int) getpid());
+	shm_unlink(path);
+	memset(&table, 0, sizeof(table));
+	memset(&other, 0, sizeof(other));
+	_dmap_table_init(&table, 16, "dmap_store_test");
+	_dmap_table_init(&other, 16, "dmap_store_test_other");
+	failed += dmap_table_share(&table, path, sizeof(_dmap_store_test_item_t), 1, 4) != 0;
+	failed += dmap_table_share(&other, path, sizeof(_dmap_store_test_item_t), 1, 4) != 0;
+	items[1] = _dmap_store_test_add(&table, 1);
+	items[2] = _dmap_store_test_add(&table, 2);
+	rwmutex_read_lock(other.rwmutex);
+	_dmap_store_read_locked(&other);
+	failed += other.rows_num != 2 || _dmap_store_test_ids(&other) != 0x6;
+	rwmutex_read_unlock(other.rwmutex);
+	_dmap_rem_item(&table, items[1]);
+	failed += _dmap_store_test_add(&table, 3) != items[1];
+	rwmutex_read_lock(other.rwmutex);
+	_dmap_store_read_locked(&other);
+	failed += other.rows_num != 2 || _dmap_store_test_ids(&other) != 0xC;
+	rwmutex_read_unlock(other.rwmutex);
+	_dmap_rem_item(&table, items[2]);
+	rwmutex_write_lock(other.rwmutex);
+	_dmap_store_write_locked(&other);
+	failed += other.rows_num != 1 || _dmap_store_test_ids(&other) != 0x8;
+	rwmutex_write_unlock(other.rwmutex);
+	failed += table.store->generation != table.store->header->generation || table.rows_num != 1;
+	_dmap_table_deinit(&table);
+	_dmap_table_deinit(&other);
+	fd = shm_open(path, O_RDWR, 0);
+	if(0 <= fd){
+		++failed;
+		close(fd);
+	}
+
+	//a region left without a header by its creator is created again
+	fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+	failed += fd < 0;
+	close(fd);
+	memset(&table, 0, sizeof(table));
+	_dmap_table_init(&table, 16, "dmap_store_test");
+	failed += dmap_table_share(&table, path, sizeof(_dmap_store_test_item_t), 1, 4) != 0;
+	failed += _dmap_store_test_add(&table, 1) == NULL;
+	_dmap_table_deinit(&table);
+	shm_unlink(path);
+
+	printf("dmap_store_test: %s\n", failed ? "FAILED" : "passed");
+}
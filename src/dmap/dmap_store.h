@@ -0,0 +1,72 @@
+#ifndef INCGUARD_NTRT_DMAP_STORE_H_
+#define INCGUARD_NTRT_DMAP_STORE_H_
+#include <pthread.h>
+#include "lib_defs.h"
+#include "lib_threading.h"
+#include "dmap_defs.h"
+
+#define DMAP_STORE_MAGIC "DMAPSTOR"
+#define DMAP_STORE_FORMAT 2           //layout of the file, increased on incompatible changes
+#define DMAP_STORE_HEADER_SIZE 256    //the records start after it
+#define DMAP_STORE_USED 0x55534544    //state of a record holding an item
+#define DMAP_STORES_MAX 16            //tables persisted or shared at the same time
+#define DMAP_STORE_ATTACH_TRIES 1000  //milliseconds waited for the creator of a shared region
+
+//beginning of the file of a persistent table
+typedef struct dmap_storeheader_struct_t{
+	char_t      magic[8];
+	uint32_t    format;
+	uint32_t    version;          ///< of the items, given by the application
+	uint32_t    item_size;
+	int32_t     capacity;         ///< records in the file
+	int32_t     free_first;       ///< -1 if every record is used
+	int32_t     used_num;
+	int32_t     attached;         ///< processes using a shared region
+	volatile uint64_t generation; ///< increased when a record is allocated or freed
+	pthread_mutex_t lock;         ///< guards the free list, robust and shared between processes
+	rwmutex_t   rwmutex;          ///< lock of a shared table in every process
+}dmap_storeheader_t;
+
+typedef struct dmap_storerecord_struct_t{
+	uint32_t    state;            ///< DMAP_STORE_USED or 0
+	int32_t     next_free;        ///< next free record, -1 at the end of the free list
+	uint64_t    stamp;            ///< generation the item was allocated at
+	char        item[];
+}dmap_storerecord_t;
+
+//reference of an item kept in another item of a store instead of a pointer,
+//the regions are mapped to different addresses in each process; 0 is none
+typedef int32_t dmap_storeref_t;
+
+//Items of a table kept in a memory mapped file or a named shared memory region.
+//The records are never moved, so the rows of the table point into the mapping.
+//The lock processes of a shared table refresh its rows changed by other
+//processes before they return, taking the lock for writing meanwhile; the
+//thread holding the lock of a shared table must not lock it again.
+typedef struct dmap_store_struct_t{
+	char_t              path[256];
+	int                 fd;
+	char               *mapping;
+	size_t              length;
+	size_t              record_size;
+	dmap_storeheader_t *header;
+	bool_t              shared;   ///< the region is named shared memory used by other processes
+	uint64_t           *stamps;   ///< of the records having a row in the table of this process
+	uint64_t            generation; ///< of the header at the last refresh
+}dmap_store_t;
+
+int32_t dmap_table_persist(dmap_table_t *table, const char_t *path, uint32_t item_size,
+                           uint32_t version, int32_t capacity)                      __attribute__((nonnull (1,2)));
+void*   dmap_store_alloc(dmap_table_t *table)                                       __attribute__((nonnull (1)));
+void    dmap_store_free(void *item);
+void    dmap_table_sync(dmap_table_t *table)                                        __attribute__((nonnull (1)));
+int32_t dmap_table_share(dmap_table_t *table, const char_t *name, uint32_t item_size,
+                         uint32_t version, int32_t capacity)                        __attribute__((nonnull (1,2)));
+int32_t dmap_table_refresh(dmap_table_t *table)                                     __attribute__((nonnull (1)));
+dmap_storeref_t dmap_store_ref(dmap_table_t *table, void *item)                     __attribute__((nonnull (1)));
+void*   dmap_store_deref(dmap_table_t *table, dmap_storeref_t ref)                  __attribute__((nonnull (1)));
+void    _dmap_store_detach(dmap_table_t *table)                                     __attribute__((nonnull (1)));
+void    _dmap_store_close(dmap_table_t *table)                                      __attribute__((nonnull (1)));
+void    dmap_store_test(void);
+
+#endif //INCGUARD_NTRT_DMAP_STORE_H_
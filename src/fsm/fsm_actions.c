@@ -13,6 +13,7 @@
 void config_load_from_file(char_t *filename)
 {
 	dictionary    *conf ;
+	sysdat_t      *sysdat;
 	int32_t        index;
 	char_t         section[128];
 	char_t        *read_str;
@@ -34,12 +35,13 @@ void config_load_from_file(char_t *filename)
 	}
 	//iniparser_dump(conf, stderr);
 
-	dmap_lock_sysdat();
+	//the readers keep using the previous version until the new one is committed
+	sysdat = dmap_begin_sysdat();
 
-	conf_load_from_dictionary(conf);
+	conf_load_from_dictionary(conf, sysdat);
 
-	iniparser_freedict(conf);
+	dmap_commit_sysdat(sysdat);
 
-	dmap_unlock_sysdat();
+	iniparser_freedict(conf);
 }
 
@@ -0,0 +1,411 @@
+#include "lib_arena.h"
+#include "lib_descs.h"
+#include <stdint.h>
+#include <pthread.h>
+
+//Every thread allocates from its own arena. A block freed by the thread
+//owning it goes back to a free list at once; a block of another arena is
+//collected with others of the same arena and the batch is pushed onto the
+//remote stack of the owner with one compare and swap. The owner takes the
+//whole stack when a free list of it runs empty.
+//
+//Blocks of an arena may outlive its thread, so arenas are never freed:
+//the arena of an exiting thread becomes idle and is taken over by the next
+//new thread, together with the blocks given back to it meanwhile.
+
+static pthread_mutex_t   _arenas_mutex = PTHREAD_MUTEX_INITIALIZER;
+static arena_t*          _arenas = NULL;
+static arena_t*          _arenas_idle = NULL;
+static pthread_once_t    _arena_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t     _arena_key;
+static __thread arena_t* _arena = NULL;
+
+static void _arena_release_thread(void* arg);
+
+static void _arena_init_key()
+{
+  pthread_key_create(&_arena_key, _arena_release_thread);
+}
+
+static int32_t _arena_class(size_t size)
+{
+  if(size <= (1 << ARENA_MIN_CLASS_SHIFT)){
+    return 0;
+  }
+  return 64 - __builtin_clzll(size - 1) - ARENA_MIN_CLASS_SHIFT;
+}
+
+static arena_t* _arena_get()
+{
+  if(_arena == NULL){
+    arena_thread_init();
+  }
+  return _arena;
+}
+
+//moves the blocks given back by other threads to the free lists
+static void _arena_collect(arena_t* this)
+{
+  arenablock_t *block, *next;
+  block = __atomic_exchange_n(&this->remote, NULL, __ATOMIC_ACQUIRE);
+  for(; block; block = next){
+    next = block->next;
+    block->next = this->free[block->size_class];
+    this->free[block->size_class] = block;
+  }
+}
+
+static void _arena_refill(arena_t* this, int32_t size_class)
+{
+  arenablock_t* block;
+  char *slab, *end;
+  size_t size = ARENA_HEADER_SIZE + ((size_t) 1 << (size_class + ARENA_MIN_CLASS_SHIFT));
+  slab = (char*) malloc(ARENA_SLAB_SIZE);
+  if(slab == NULL){
+    return;
+  }
+  __atomic_add_fetch(&this->slabs, 1, __ATOMIC_RELAXED);
+  for(end = slab + ARENA_SLAB_SIZE; slab + size <= end; slab += size){
+    block = (arenablock_t*) slab;
+    block->owner = this;
+    block->size_class = size_class;
+    block->next = this->free[size_class];
+    this->free[size_class] = block;
+  }
+}
+
+static void _arena_give_back(arenaremote_t* remote)
+{
+  arenablock_t* head;
+  if(remote->num == 0){
+    return;
+  }
+  head = __atomic_load_n(&remote->owner->remote, __ATOMIC_RELAXED);
+  do{
+    remote->last->next = head;
+  }while(!__atomic_compare_exchange_n(&remote->owner->remote, &head, remote->first,
+                                      BOOL_TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  remote->owner = NULL;
+  remote->first = remote->last = NULL;
+  remote->num = 0;
+}
+
+static void _arena_free_remote(arena_t* this, arenablock_t* block)
+{
+  arenaremote_t* remote = NULL;
+  int32_t index;
+  for(index = 0; index < ARENA_REMOTE_OWNERS; ++index){
+    if(this->remotes[index].owner == block->owner){
+      remote = &this->remotes[index];
+      break;
+    }
+    if(remote == NULL && this->remotes[index].owner == NULL){
+      remote = &this->remotes[index];
+    }
+  }
+  if(remote == NULL){
+    remote = &this->remotes[this->remotes_victim];
+    this->remotes_victim = (this->remotes_victim + 1) % ARENA_REMOTE_OWNERS;
+    _arena_give_back(remote);
+  }
+  remote->owner = block->owner;
+  block->next = remote->first;
+  remote->first = block;
+  if(remote->last == NULL){
+    remote->last = block;
+  }
+  __atomic_add_fetch(&this->remote_frees, 1, __ATOMIC_RELAXED);
+  if(ARENA_REMOTE_BATCH <= ++remote->num){
+    _arena_give_back(remote);
+  }
+}
+
+static void _arena_release_thread(void* arg)
+{
+  arena_t* this = (arena_t*) arg;
+  int32_t index;
+  for(index = 0; index < ARENA_REMOTE_OWNERS; ++index){
+    _arena_give_back(&this->remotes[index]);
+  }
+  arena_release((arenamark_t){NULL, NULL});
+  pthread_mutex_lock(&_arenas_mutex);
+  this->next_idle = _arenas_idle;
+  _arenas_idle = this;
+  pthread_mutex_unlock(&_arenas_mutex);
+  _arena = NULL;
+}
+
+//threads of LIB_DEF_THREAD get their arena by the macro, any other
+//thread gets one at its first allocation and gives it up when it exits
+void arena_thread_init()
+{
+  arena_t* result;
+  if(_arena != NULL){
+    return;
+  }
+  pthread_once(&_arena_key_once, _arena_init_key);
+  pthread_mutex_lock(&_arenas_mutex);
+  result = _arenas_idle;
+  if(result){
+    _arenas_idle = result->next_idle;
+  }
+  pthread_mutex_unlock(&_arenas_mutex);
+  if(result == NULL){
+    if(posix_memalign((void**) &result, 64, sizeof(arena_t))){
+      EXERROR("Arena can not be allocated", EXIT_FAILURE);
+    }
+    memset(result, 0, sizeof(arena_t));
+    pthread_mutex_lock(&_arenas_mutex);
+    result->next = _arenas;
+    _arenas = result;
+    pthread_mutex_unlock(&_arenas_mutex);
+  }
+  _arena = result;
+  pthread_setspecific(_arena_key, result);
+}
+
+void arena_thread_deinit()
+{
+  arena_t* this = _arena;
+  if(this == NULL){
+    return;
+  }
+  pthread_setspecific(_arena_key, NULL);
+  _arena_release_thread(this);
+}
+
+//blocks larger than ARENA_MAX_CLASS_SIZE are taken from malloc
+void* arena_alloc(size_t size)
+{
+  arena_t* this;
+  arenablock_t* block;
+  int32_t size_class;
+  if(ARENA_MAX_CLASS_SIZE < size){
+    block = (arenablock_t*) malloc(ARENA_HEADER_SIZE + size);
+    if(block == NULL){
+      return NULL;
+    }
+    block->owner = NULL;
+    return (char*) block + ARENA_HEADER_SIZE;
+  }
+  this = _arena_get();
+  size_class = _arena_class(size);
+  if(this->free[size_class] == NULL){
+    _arena_collect(this);
+  }
+  if(this->free[size_class] == NULL){
+    _arena_refill(this, size_class);
+  }
+  block = this->free[size_class];
+  if(block == NULL){
+    return NULL;
+  }
+  this->free[size_class] = block->next;
+  __atomic_store_n(&this->allocs, this->allocs + 1, __ATOMIC_RELAXED);
+  return (char*) block + ARENA_HEADER_SIZE;
+}
+
+void* arena_calloc(size_t num, size_t size)
+{
+  void* result;
+  result = arena_alloc(num * size);
+  if(result){
+    memset(result, 0, num * size);
+  }
+  return result;
+}
+
+//the block may be freed by any thread
+void arena_free(void* ptr)
+{
+  arena_t* this;
+  arenablock_t* block;
+  if(ptr == NULL){
+    return;
+  }
+  block = (arenablock_t*)((char*) ptr - ARENA_HEADER_SIZE);
+  if(block->owner == NULL){
+    free(block);
+    return;
+  }
+  this = _arena_get();
+  __atomic_store_n(&this->frees, this->frees + 1, __ATOMIC_RELAXED);
+  if(block->owner != this){
+    _arena_free_remote(this, block);
+    return;
+  }
+  block->next = this->free[block->size_class];
+  this->free[block->size_class] = block;
+}
+
+//gives the collected blocks of other threads back at once
+void arena_flush()
+{
+  int32_t index;
+  if(_arena == NULL){
+    return;
+  }
+  for(index = 0; index < ARENA_REMOTE_OWNERS; ++index){
+    _arena_give_back(&_arena->remotes[index]);
+  }
+}
+
+//allocates by moving a pointer, the memory is given back by arena_release only
+void* arena_bump(size_t size)
+{
+  arena_t* this = _arena_get();
+  arenachunk_t* chunk;
+  char* result;
+  size = (size + 15) & ~(size_t) 15;
+  if(this->chunk == NULL || this->chunk->end < this->top + size){
+    chunk = (arenachunk_t*) malloc(sizeof(arenachunk_t) + (size < ARENA_CHUNK_SIZE ? ARENA_CHUNK_SIZE : size));
+    if(chunk == NULL){
+      return NULL;
+    }
+    chunk->prev = this->chunk;
+    chunk->end = chunk->data + (size < ARENA_CHUNK_SIZE ? ARENA_CHUNK_SIZE : size);
+    this->chunk = chunk;
+    this->top = chunk->data;
+  }
+  result = this->top;
+  this->top += size;
+  return result;
+}
+
+arenamark_t arena_mark()
+{
+  arena_t* this = _arena_get();
+  arenamark_t result;
+  result.chunk = this->chunk;
+  result.top = this->top;
+  return result;
+}
+
+//releases everything allocated by arena_bump since the mark,
+//an empty mark releases all of it
+void arena_release(arenamark_t mark)
+{
+  arena_t* this = _arena;
+  arenachunk_t* chunk;
+  if(this == NULL){
+    return;
+  }
+  while(this->chunk != mark.chunk){
+    chunk = this->chunk;
+    this->chunk = chunk->prev;
+    free(chunk);
+  }
+  this->top = mark.top;
+}
+
+void arena_print_stats()
+{
+  arena_t* arena;
+  int32_t index = 0;
+  pthread_mutex_lock(&_arenas_mutex);
+  for(arena = _arenas; arena; arena = arena->next, ++index){
+    INFOPRINT("arena %d: %llu allocs, %llu frees, %llu remote frees, %llu slabs of %d bytes",
+              index,
+              (unsigned long long) __atomic_load_n(&arena->allocs, __ATOMIC_RELAXED),
+              (unsigned long long) __atomic_load_n(&arena->frees, __ATOMIC_RELAXED),
+              (unsigned long long) __atomic_load_n(&arena->remote_frees, __ATOMIC_RELAXED),
+              (unsigned long long) __atomic_load_n(&arena->slabs, __ATOMIC_RELAXED),
+              ARENA_SLAB_SIZE);
+  }
+  pthread_mutex_unlock(&_arenas_mutex);
+}
+
+#define _ARENA_TEST_BLOCKS     (2 * ARENA_REMOTE_BATCH + 5)
+
+static void* _arena_test_free_remote(void* arg)
+{
+  void** blocks = (void**) arg;
+  arena_t* owner = ((arenablock_t*)((char*) blocks[0] - ARENA_HEADER_SIZE))->owner;
+  int32_t index, failed = 0;
+  //a batch goes back to the owner once it is full, the rest at the flush
+  for(index = 0; index < ARENA_REMOTE_BATCH - 1; ++index){
+    arena_free(blocks[index]);
+  }
+  failed += __atomic_load_n(&owner->remote, __ATOMIC_ACQUIRE) != NULL;
+  arena_free(blocks[index++]);
+  failed += __atomic_load_n(&owner->remote, __ATOMIC_ACQUIRE) == NULL;
+  for(; index < _ARENA_TEST_BLOCKS; ++index){
+    arena_free(blocks[index]);
+  }
+  failed += _arena->remote_frees != _ARENA_TEST_BLOCKS;
+  arena_thread_deinit();
+  return (void*)(intptr_t) failed;
+}
+
+void arena_test(void)
+{
+  void *blocks[_ARENA_TEST_BLOCKS], *first, *ptr;
+  arenablock_t* block;
+  arenamark_t mark;
+  pthread_t thread;
+  uint64_t slabs;
+  intptr_t remote_failed;
+  int32_t index, num, failed = 0;
+
+  //size classes at their boundaries
+  failed += _arena_class(0) != 0 || _arena_class(1) != 0 || _arena_class(16) != 0;
+  failed += _arena_class(17) != 1 || _arena_class(32) != 1 || _arena_class(33) != 2;
+  failed += _arena_class(ARENA_MAX_CLASS_SIZE) != ARENA_CLASSES - 1;
+  ptr = arena_alloc(ARENA_MAX_CLASS_SIZE);
+  block = (arenablock_t*)((char*) ptr - ARENA_HEADER_SIZE);
+  failed += block->owner != _arena || block->size_class != ARENA_CLASSES - 1;
+  memset(ptr, 0xAB, ARENA_MAX_CLASS_SIZE);
+  arena_free(ptr);
+  //the freed block is the next one of its class
+  failed += arena_alloc(ARENA_MAX_CLASS_SIZE) != ptr;
+  arena_free(ptr);
+  ptr = arena_alloc(ARENA_MAX_CLASS_SIZE + 1);
+  failed += ((arenablock_t*)((char*) ptr - ARENA_HEADER_SIZE))->owner != NULL;
+  memset(ptr, 0xAB, ARENA_MAX_CLASS_SIZE + 1);
+  arena_free(ptr);
+  ptr = arena_calloc(4, 4);
+  failed += ((char*) ptr)[0] != 0 || ((char*) ptr)[15] != 0;
+  arena_free(ptr);
+  arena_free(NULL);
+
+  //blocks of the same class span more than one slab
+  num = ARENA_SLAB_SIZE / (ARENA_HEADER_SIZE + ARENA_MAX_CLASS_SIZE) + 1;
+  slabs = _arena->slabs;
+  for(index = 0; index < num + 1 && index < _ARENA_TEST_BLOCKS; ++index){
+    blocks[index] = arena_alloc(ARENA_MAX_CLASS_SIZE);
+    memset(blocks[index], index, ARENA_MAX_CLASS_SIZE);
+  }
+  failed += _arena->slabs == slabs;
+  for(index = 0; index < num + 1 && index < _ARENA_TEST_BLOCKS; ++index){
+    failed += ((unsigned char*) blocks[index])[ARENA_MAX_CLASS_SIZE - 1] != (unsigned char) index;
+    arena_free(blocks[index]);
+  }
+
+  //blocks freed by another thread come back to this arena
+  for(index = 0; index < _ARENA_TEST_BLOCKS; ++index){
+    blocks[index] = arena_alloc(100);
+  }
+  pthread_create(&thread, NULL, _arena_test_free_remote, blocks);
+  pthread_join(thread, (void**) &remote_failed);
+  failed += remote_failed != 0;
+  for(num = 0, block = _arena->remote; block; block = block->next, ++num);
+  failed += num != _ARENA_TEST_BLOCKS;
+  _arena_collect(_arena);
+  failed += _arena->remote != NULL;
+
+  //bump allocations are released back to the mark, also across chunks
+  arena_bump(1);
+  mark = arena_mark();
+  first = arena_bump(1);
+  ptr = arena_bump(17);
+  failed += ((uintptr_t) first & 15) != 0 || (char*) ptr - (char*) first != 16;
+  arena_bump(ARENA_CHUNK_SIZE + 1);
+  arena_bump(ARENA_CHUNK_SIZE);
+  arena_release(mark);
+  failed += _arena->chunk != mark.chunk || _arena->top != mark.top;
+  failed += arena_bump(1) != first;
+  arena_release((arenamark_t){NULL, NULL});
+  failed += _arena->chunk != NULL;
+
+  printf("arena_test: %s\n", failed ? "FAILED" : "passed");
+}
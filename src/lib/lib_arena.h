@@ -0,0 +1,84 @@
+#ifndef INCGUARD_NTRT_LIBRARY_ARENA_H_
+#define INCGUARD_NTRT_LIBRARY_ARENA_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <assert.h>
+#include "lib_defs.h"
+
+#define ARENA_CLASSES          8             ///< size classes of 16, 32, ... 2048 bytes
+#define ARENA_MIN_CLASS_SHIFT  4
+#define ARENA_MAX_CLASS_SIZE   (1 << (ARENA_MIN_CLASS_SHIFT + ARENA_CLASSES - 1))
+#define ARENA_SLAB_SIZE        (64 * 1024)   ///< memory cut into blocks of one class at once
+#define ARENA_CHUNK_SIZE       (64 * 1024)   ///< memory of the bump allocation taken at once
+#define ARENA_REMOTE_BATCH     32            ///< blocks of another thread freed before they are given back
+#define ARENA_REMOTE_OWNERS    4             ///< threads the freed blocks are collected for at the same time
+
+#define ARENA_NEW(TYPE)        ((TYPE*) arena_calloc(1, sizeof(TYPE)))
+
+struct _arena;
+
+//header of an allocated block, the link overlays the data while the block is free
+typedef struct _arenablock {
+  struct _arena*          owner;          ///< NULL if the block is too large for the classes
+  uint32_t                size_class;
+  uint32_t                reserved;
+  struct _arenablock*     next;
+} arenablock_t;
+
+#define ARENA_HEADER_SIZE      offsetof(arenablock_t, next)
+
+//memory of the bump allocation, the chunks form a stack
+typedef struct _arenachunk {
+  struct _arenachunk*     prev;
+  char*                   end;
+  char                    data[];
+} arenachunk_t;
+
+//blocks freed for another arena, given back to it in one step
+typedef struct _arenaremote {
+  struct _arena*          owner;
+  arenablock_t*           first;
+  arenablock_t*           last;
+  int32_t                 num;
+} arenaremote_t;
+
+//position of the bump allocation, memory allocated after it is released together
+typedef struct _arenamark {
+  arenachunk_t*           chunk;
+  char*                   top;
+} arenamark_t;
+
+//Allocator of a thread. Blocks are taken from and given back to the free
+//lists of their size class without any lock; blocks freed by other threads
+//arrive in batches on the remote stack.
+typedef struct _arena {
+  arenablock_t*           free[ARENA_CLASSES];
+  arenablock_t* volatile  remote;
+  arenaremote_t           remotes[ARENA_REMOTE_OWNERS];
+  int32_t                 remotes_victim;
+  arenachunk_t*           chunk;
+  char*                   top;
+  volatile uint64_t       allocs;
+  volatile uint64_t       frees;
+  volatile uint64_t       remote_frees;   ///< blocks freed by this thread for other arenas
+  volatile uint64_t       slabs;
+  struct _arena*          next;           ///< in the list of all arenas
+  struct _arena*          next_idle;      ///< in the list of arenas without a thread
+} __attribute__((aligned(64))) arena_t;
+
+void arena_thread_init();
+void arena_thread_deinit();
+void* arena_alloc(size_t size);
+void* arena_calloc(size_t num, size_t size);
+void arena_free(void* ptr);
+void arena_flush();
+void* arena_bump(size_t size);
+arenamark_t arena_mark();
+void arena_release(arenamark_t mark);
+void arena_print_stats();
+void arena_test(void);
+
+#endif /* INCGUARD_NTRT_LIBRARY_ARENA_H_ */
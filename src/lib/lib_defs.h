@@ -246,4 +246,31 @@ typedef struct dlist_struct_t{
         struct dlist_struct_t* next,*prev;
 }dlist_t;
 
+/** \typedef datchainhead_t
+      \brief describes the two ends of a datchain, so items can be appended without walking it
+  */
+typedef struct datchainhead_struct_t{
+        datchain_t*            first;     ///< Pointing to the first element of the chain
+        datchain_t*            last;      ///< Pointing to the last element of the chain
+        int32_t                length;    ///< The number of elements in the chain
+}datchainhead_t;
+
+/** \typedef slisthead_t
+      \brief describes the two ends of a singly linked list for O(1) append
+  */
+typedef struct slisthead_struct_t{
+        slist_t*               first;     ///< Pointing to the first element of the list
+        slist_t*               last;      ///< Pointing to the last element of the list
+        int32_t                length;    ///< The number of elements in the list
+}slisthead_t;
+
+/** \typedef dlisthead_t
+      \brief describes the two ends of a doubly linked list for O(1) append
+  */
+typedef struct dlisthead_struct_t{
+        dlist_t*               first;     ///< Pointing to the first element of the list
+        dlist_t*               last;      ///< Pointing to the last element of the list
+        int32_t                length;    ///< The number of elements in the list
+}dlisthead_t;
+
 #endif //INCGUARD_NTRT_LIBRARY_DEFINITIONS_H_
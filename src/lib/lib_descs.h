@@ -25,9 +25,22 @@ typedef struct eveter_arg_struct_t
 	void*        arg;
 }eventer_arg_t;
 
+#define PROGRAM_MAX_THREADCONF_NUM 32
+#define PROGRAM_THREADCONF_NAME_LENGTH 64
+
+//placement and scheduling of a component thread given in the configuration
+typedef struct threadconf_struct_t
+{
+  char_t        name[PROGRAM_THREADCONF_NAME_LENGTH];
+  threadattrs_t attrs;
+}threadconf_t;
+
 typedef struct sysdat_struct_t
 {
-  //global available and singletone data
+  //global available and singletone data, published as immutable versions
+  uint64_t      version;
+  threadconf_t  threadconfs[PROGRAM_MAX_THREADCONF_NUM];
+  int32_t       threadconfs_num;
 }sysdat_t;
 
 typedef struct array_struct_t
@@ -8,3 +8,20 @@ void dispose_thread(thread_t *thread)
 	dmap_rem_thr(thread);
 }
 
+void dispose_executor(executor_t *executor)
+{
+	int32_t index;
+	for(index = 0; index < executor->workers_num; ++index){
+		dispose_thread(executor->workers[index]);
+	}
+	executor_dtor(executor);
+}
+
+void dispose_fibersched(fibersched_t *sched)
+{
+	int32_t index;
+	for(index = 0; index < sched->workers_num; ++index){
+		dispose_thread(sched->workers[index].thread);
+	}
+	fibersched_dtor(sched);
+}
@@ -1,7 +1,10 @@
 #ifndef INCGUARD_LIB_DISP_H_
 #define INCGUARD_LIB_DISP_H_
 #include "lib_threading.h"
+#include "lib_fiber.h"
 
 void dispose_thread(thread_t*);
+void dispose_executor(executor_t*);
+void dispose_fibersched(fibersched_t*);
 
 #endif /* INCGUARD_LIB_DISP_H_ */
@@ -0,0 +1,733 @@
+#include "lib_fiber.h"
+#include "lib_descs.h"
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+//Fibers are run by the workers of a scheduler: a worker switches to a
+//fiber, and the fiber switches back when it yields, waits or ends. What
+//has to happen after the fiber left its stack, queueing it again or
+//giving its stack back, is done by the worker after the switch.
+//
+//A waiting fiber is PARKING until its worker switched out of it and
+//PARKED afterwards. A resume of a PARKING fiber only marks it NOTIFIED,
+//the worker queues it right away then. Every wait gets a new sequence
+//in the state word, so a timer of an earlier wait can not end a later one.
+
+static __thread fiberworker_t* _fiber_worker_tls = NULL;
+
+#if defined(__x86_64__)
+//saves the callee saved registers on the stack being left and restores them from the other
+__asm__(
+  ".text\n"
+  ".globl _fiberctx_switch\n"
+  ".hidden _fiberctx_switch\n"
+  ".type _fiberctx_switch, @function\n"
+  ".p2align 4\n"
+  "_fiberctx_switch:\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  movq  %rsp, (%rdi)\n"
+  "  movq  %rsi, %rsp\n"
+  "  popq  %r15\n"
+  "  popq  %r14\n"
+  "  popq  %r13\n"
+  "  popq  %r12\n"
+  "  popq  %rbx\n"
+  "  popq  %rbp\n"
+  "  ret\n"
+  ".size _fiberctx_switch, .-_fiberctx_switch\n"
+);
+#define FIBERCTX_FRAME_SIZE 64
+#elif defined(__aarch64__)
+__asm__(
+  ".text\n"
+  ".globl _fiberctx_switch\n"
+  ".hidden _fiberctx_switch\n"
+  ".type _fiberctx_switch, %function\n"
+  ".p2align 4\n"
+  "_fiberctx_switch:\n"
+  "  sub  sp, sp, #176\n"
+  "  stp  x19, x20, [sp, #0]\n"
+  "  stp  x21, x22, [sp, #16]\n"
+  "  stp  x23, x24, [sp, #32]\n"
+  "  stp  x25, x26, [sp, #48]\n"
+  "  stp  x27, x28, [sp, #64]\n"
+  "  stp  x29, x30, [sp, #80]\n"
+  "  stp  d8,  d9,  [sp, #96]\n"
+  "  stp  d10, d11, [sp, #112]\n"
+  "  stp  d12, d13, [sp, #128]\n"
+  "  stp  d14, d15, [sp, #144]\n"
+  "  mov  x9, sp\n"
+  "  str  x9, [x0]\n"
+  "  mov  sp, x1\n"
+  "  ldp  x19, x20, [sp, #0]\n"
+  "  ldp  x21, x22, [sp, #16]\n"
+  "  ldp  x23, x24, [sp, #32]\n"
+  "  ldp  x25, x26, [sp, #48]\n"
+  "  ldp  x27, x28, [sp, #64]\n"
+  "  ldp  x29, x30, [sp, #80]\n"
+  "  ldp  d8,  d9,  [sp, #96]\n"
+  "  ldp  d10, d11, [sp, #112]\n"
+  "  ldp  d12, d13, [sp, #128]\n"
+  "  ldp  d14, d15, [sp, #144]\n"
+  "  add  sp, sp, #176\n"
+  "  ret\n"
+  ".size _fiberctx_switch, .-_fiberctx_switch\n"
+);
+#define FIBERCTX_FRAME_SIZE 176
+#endif
+
+#ifdef FIBERCTX_FRAME_SIZE
+void _fiberctx_switch(void** from_sp, void* to_sp) __attribute__((visibility("hidden")));
+#endif
+
+static void _fiber_start();
+
+static void _fiberctx_init(fiberctx_t* ctx, char* stack, size_t size)
+{
+#if defined(__x86_64__)
+  uintptr_t* frame = (uintptr_t*)(stack + size);
+  *--frame = 0;                            ///< the return address _fiber_start never uses
+  *--frame = (uintptr_t) _fiber_start;     ///< returned to by the first switch
+  frame -= 6;
+  memset(frame, 0, 6 * sizeof(uintptr_t));
+  ctx->sp = frame;
+#elif defined(__aarch64__)
+  uintptr_t* frame = (uintptr_t*)(stack + size - FIBERCTX_FRAME_SIZE);
+  memset(frame, 0, FIBERCTX_FRAME_SIZE);
+  frame[11] = (uintptr_t) _fiber_start;    ///< x30, returned to by the first switch
+  ctx->sp = frame;
+#else
+  getcontext(&ctx->context);
+  ctx->context.uc_stack.ss_sp = stack;
+  ctx->context.uc_stack.ss_size = size;
+  ctx->context.uc_link = NULL;
+  makecontext(&ctx->context, _fiber_start, 0);
+#endif
+}
+
+static inline void _fiberctx_swap(fiberctx_t* from, fiberctx_t* to)
+{
+#ifdef FIBERCTX_FRAME_SIZE
+  _fiberctx_switch(&from->sp, to->sp);
+#else
+  swapcontext(&from->context, &to->context);
+#endif
+}
+
+//a fiber may go on on another worker after a switch, so the thread local
+//is read through a call the compiler can not move over the switch
+static __attribute__((noinline)) fiberworker_t* _fiber_worker()
+{
+  fiberworker_t* result = _fiber_worker_tls;
+  __asm__ __volatile__("" ::: "memory");
+  return result;
+}
+
+static uint64_t _fiber_now()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static size_t _fiber_page_size()
+{
+  static size_t result = 0;
+  if(!result){
+    result = sysconf(_SC_PAGESIZE);
+  }
+  return result;
+}
+
+static void _fiber_release(fiber_t* this)
+{
+  if(__atomic_sub_fetch(&this->refs, 1, __ATOMIC_ACQ_REL)){
+    return;
+  }
+  eventcount_dtor(this->done);
+  free(this);
+}
+
+//stacks are mapped with a guard page below them and kept for reuse
+static char* _fibersched_take_stack(fibersched_t* this)
+{
+  char* result;
+  size_t page = _fiber_page_size();
+  spin_lock(&this->stacks_lock);
+  result = this->stacks;
+  if(result){
+    this->stacks = *(void**)(result + page);
+    --this->stacks_num;
+  }
+  spin_unlock(&this->stacks_lock);
+  if(result){
+    return result;
+  }
+  result = mmap(NULL, page + this->stack_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if(result == MAP_FAILED){
+    return NULL;
+  }
+  mprotect(result, page, PROT_NONE);
+  return result;
+}
+
+static void _fibersched_give_stack(fibersched_t* this, char* stack)
+{
+  size_t page = _fiber_page_size();
+  spin_lock(&this->stacks_lock);
+  if(this->stacks_num < FIBER_STACK_POOL_MAX){
+    *(void**)(stack + page) = this->stacks;
+    this->stacks = stack;
+    ++this->stacks_num;
+    stack = NULL;
+  }
+  spin_unlock(&this->stacks_lock);
+  if(stack){
+    munmap(stack, page + this->stack_size);
+  }
+}
+
+//a worker queueing for itself runs the fiber soon anyway, so idle
+//workers are woken only if it has more to do
+static void _fiberworker_push(fiberworker_t* this, fiber_t* fiber)
+{
+  bool_t queued;
+  fiber->next = NULL;
+  spin_lock(&this->queue_lock);
+  queued = this->last != NULL;
+  if(this->last){
+    this->last->next = fiber;
+  }else{
+    __atomic_store_n(&this->first, fiber, __ATOMIC_RELAXED);
+  }
+  this->last = fiber;
+  spin_unlock(&this->queue_lock);
+  __atomic_add_fetch(&this->sched->pending, 1, __ATOMIC_SEQ_CST);
+  if(queued || this != _fiber_worker()){
+    eventcount_notify(this->sched->ready);
+  }
+}
+
+static fiber_t* _fiberworker_pop(fiberworker_t* this)
+{
+  fiber_t* result;
+  if(!__atomic_load_n(&this->first, __ATOMIC_RELAXED)){
+    return NULL;
+  }
+  spin_lock(&this->queue_lock);
+  result = this->first;
+  if(result){
+    __atomic_store_n(&this->first, result->next, __ATOMIC_RELAXED);
+    if(!result->next){
+      this->last = NULL;
+    }
+    __atomic_sub_fetch(&this->sched->pending, 1, __ATOMIC_SEQ_CST);
+  }
+  spin_unlock(&this->queue_lock);
+  return result;
+}
+
+//takes from the own queue, or steals from the others if it is empty
+static fiber_t* _fiberworker_take(fiberworker_t* this)
+{
+  fibersched_t* sched = this->sched;
+  fiber_t* result;
+  int32_t index;
+  result = _fiberworker_pop(this);
+  for(index = 1; !result && index < sched->workers_num; ++index){
+    result = _fiberworker_pop(&sched->workers[(this->index + index) % sched->workers_num]);
+  }
+  return result;
+}
+
+//fibers resumed on a worker stay there, others are spread over the workers
+static fiberworker_t* _fibersched_pick(fibersched_t* this)
+{
+  fiberworker_t* worker = _fiber_worker();
+  if(worker && worker->sched == this){
+    return worker;
+  }
+  return &this->workers[__atomic_fetch_add(&this->next_worker, 1, __ATOMIC_RELAXED) % this->workers_num];
+}
+
+static void _fiberworker_add_timer(fiberworker_t* this, fiber_t* fiber, uint64_t deadline, uint64_t state)
+{
+  int32_t index, parent;
+  if(this->timers_num == this->timers_size){
+    this->timers_size *= 2;
+    this->timers = realloc(this->timers, this->timers_size * sizeof(fibertimer_t));
+  }
+  for(index = this->timers_num++; 0 < index; index = parent){
+    parent = (index - 1) / 2;
+    if(this->timers[parent].deadline <= deadline){
+      break;
+    }
+    this->timers[index] = this->timers[parent];
+  }
+  this->timers[index].deadline = deadline;
+  this->timers[index].state = state;
+  this->timers[index].fiber = fiber;
+}
+
+static void _fiberworker_pop_timer(fiberworker_t* this)
+{
+  fibertimer_t last;
+  int32_t index, child;
+  last = this->timers[--this->timers_num];
+  for(index = 0; (child = 2 * index + 1) < this->timers_num; index = child){
+    if(child + 1 < this->timers_num && this->timers[child + 1].deadline < this->timers[child].deadline){
+      ++child;
+    }
+    if(last.deadline <= this->timers[child].deadline){
+      break;
+    }
+    this->timers[index] = this->timers[child];
+  }
+  this->timers[index] = last;
+}
+
+//ends the expired waits, returns the next deadline or 0 if there is none
+static uint64_t _fiberworker_fire_timers(fiberworker_t* this, uint64_t now)
+{
+  fibertimer_t timer;
+  uint64_t expected;
+  while(this->timers_num && this->timers[0].deadline <= now){
+    timer = this->timers[0];
+    _fiberworker_pop_timer(this);
+    expected = timer.state;
+    if(__atomic_compare_exchange_n(&timer.fiber->state, &expected,
+                                   (expected & ~FIBER_STATE_MASK) | FIBER_STATE_READY | FIBER_STATE_TIMEDOUT,
+                                   BOOL_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)){
+      _fiberworker_push(this, timer.fiber);
+    }
+    _fiber_release(timer.fiber);
+  }
+  return this->timers_num ? this->timers[0].deadline : 0;
+}
+
+static void _fiberworker_run(fiberworker_t* this, fiber_t* fiber)
+{
+  fibersched_t* sched = this->sched;
+  uint64_t state;
+  state = __atomic_load_n(&fiber->state, __ATOMIC_ACQUIRE);
+  __atomic_store_n(&fiber->state, (state & ~FIBER_STATE_MASK) | FIBER_STATE_RUNNING, __ATOMIC_RELAXED);
+  this->current = fiber;
+  this->action = FIBER_ACTION_NONE;
+  _fiberctx_swap(&this->ctx, &fiber->ctx);
+  this->current = NULL;
+
+  switch(this->action){
+  case FIBER_ACTION_YIELD:
+    state = __atomic_load_n(&fiber->state, __ATOMIC_RELAXED);
+    __atomic_store_n(&fiber->state, (state & ~FIBER_STATE_MASK) | FIBER_STATE_READY, __ATOMIC_RELEASE);
+    _fiberworker_push(this, fiber);
+    break;
+  case FIBER_ACTION_PARK:
+    state = __atomic_load_n(&fiber->state, __ATOMIC_ACQUIRE);
+    if((state & FIBER_STATE_MASK) == FIBER_STATE_PARKING &&
+       __atomic_compare_exchange_n(&fiber->state, &state, (state & ~FIBER_STATE_MASK) | FIBER_STATE_PARKED,
+                                   BOOL_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+      break;
+    }
+    //resumed before it could switch out
+    __atomic_store_n(&fiber->state, (state & ~FIBER_STATE_MASK) | FIBER_STATE_READY, __ATOMIC_RELEASE);
+    _fiberworker_push(this, fiber);
+    break;
+  case FIBER_ACTION_EXIT:
+    _fibersched_give_stack(sched, fiber->stack);
+    fiber->stack = NULL;
+    __atomic_sub_fetch(&sched->fibers_num, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&fiber->state, FIBER_STATE_DONE, __ATOMIC_RELEASE);
+    eventcount_notify_all(fiber->done);
+    _fiber_release(fiber);
+    break;
+  default:
+    break;
+  }
+}
+
+static void _fiber_start()
+{
+  fiber_t* fiber = _fiber_worker()->current;
+  fiber->process(fiber->arg);
+  _fiber_worker()->action = FIBER_ACTION_EXIT;
+  _fiberctx_swap(&fiber->ctx, &_fiber_worker()->ctx);
+}
+
+fibersched_t* fibersched_ctor(int32_t workers_num, size_t stack_size)
+{
+  fibersched_t* result;
+  fiberworker_t* worker;
+  size_t page = _fiber_page_size();
+  int32_t index;
+  if(workers_num < 1){
+    workers_num = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if(workers_num < 1){
+    workers_num = 1;
+  }
+  if(stack_size == 0){
+    stack_size = FIBER_DEFAULT_STACK_SIZE;
+  }
+  result = (fibersched_t*) malloc(sizeof(fibersched_t));
+  memset(result, 0, sizeof(fibersched_t));
+  result->workers_num = workers_num;
+  result->stack_size = (stack_size + page - 1) & ~(page - 1);
+  if(posix_memalign((void**) &result->workers, 64, workers_num * sizeof(fiberworker_t))){
+    free(result);
+    return NULL;
+  }
+  memset(result->workers, 0, workers_num * sizeof(fiberworker_t));
+  for(index = 0; index < workers_num; ++index){
+    worker = &result->workers[index];
+    worker->sched = result;
+    worker->index = index;
+    worker->timers_size = 16;
+    worker->timers = (fibertimer_t*) malloc(worker->timers_size * sizeof(fibertimer_t));
+    pthread_spin_init(&worker->queue_lock, 0);
+  }
+  result->ready = eventcount_ctor(0);
+  pthread_spin_init(&result->stacks_lock, 0);
+  return result;
+}
+
+//the fibers have to be finished and the workers disposed before
+void fibersched_dtor(fibersched_t* this)
+{
+  fiberworker_t* worker;
+  char* stack;
+  int32_t index;
+  if(this == NULL){
+    return;
+  }
+  if(__atomic_load_n(&this->fibers_num, __ATOMIC_RELAXED)){
+    WARNINGPRINT("Fiber scheduler is destructed with %d fibers not finished", this->fibers_num);
+  }
+  for(index = 0; index < this->workers_num; ++index){
+    worker = &this->workers[index];
+    while(worker->timers_num){
+      _fiber_release(worker->timers[--worker->timers_num].fiber);
+    }
+    free(worker->timers);
+    pthread_spin_destroy(&worker->queue_lock);
+  }
+  while((stack = this->stacks) != NULL){
+    this->stacks = *(void**)(stack + _fiber_page_size());
+    munmap(stack, _fiber_page_size() + this->stack_size);
+  }
+  pthread_spin_destroy(&this->stacks_lock);
+  eventcount_dtor(this->ready);
+  free(this->workers);
+  free(this);
+}
+
+void* fibersched_worker_process(void* arg)
+{
+  thread_t*      thread = (thread_t*) arg;
+  fibersched_t*  sched = (fibersched_t*) thread->arg;
+  fiberworker_t* worker;
+  fiber_t*       fiber;
+  uint64_t       deadline, now;
+  uint32_t       key;
+  int32_t        index, wait_ms;
+
+  for(index = 0; index < sched->workers_num && sched->workers[index].thread != thread; ++index);
+  if(index == sched->workers_num){
+    WARNINGPRINT("The worker thread is not found in its fiber scheduler");
+    thread->state = THREAD_STATE_STOPPED;
+    return NULL;
+  }
+  worker = &sched->workers[index];
+  _fiber_worker_tls = worker;
+  thread->state = THREAD_STATE_RUN;
+  while(thread->state == THREAD_STATE_RUN){
+    deadline = _fiberworker_fire_timers(worker, _fiber_now());
+    fiber = _fiberworker_take(worker);
+    if(fiber){
+      _fiberworker_run(worker, fiber);
+      continue;
+    }
+    wait_ms = FIBER_IDLE_WAIT_MS;
+    if(deadline){
+      now = _fiber_now();
+      if(deadline <= now){
+        continue;
+      }
+      if((deadline - now) / 1000000 < FIBER_IDLE_WAIT_MS){
+        wait_ms = (deadline - now + 999999) / 1000000;
+      }
+    }
+    key = eventcount_prepare_wait(sched->ready);
+    if(__atomic_load_n(&sched->pending, __ATOMIC_SEQ_CST) || thread->state != THREAD_STATE_RUN){
+      eventcount_cancel_wait(sched->ready);
+      continue;
+    }
+    eventcount_commit_timedwait(sched->ready, key, wait_ms);
+  }
+  _fiber_worker_tls = NULL;
+  thread->state = THREAD_STATE_STOPPED;
+  return NULL;
+}
+
+int32_t fibersched_get_fibers_num(fibersched_t* this)
+{
+  return __atomic_load_n(&this->fibers_num, __ATOMIC_RELAXED);
+}
+
+//the handle has to be given back by fiber_dtor, the fiber itself
+//is freed when it ends
+fiber_t* fiber_spawn(fibersched_t* sched, void* (*process)(void*), void* arg)
+{
+  fiber_t* result;
+  char* stack;
+  stack = _fibersched_take_stack(sched);
+  if(stack == NULL){
+    WARNINGPRINT("Stack of a fiber can not be mapped");
+    return NULL;
+  }
+  result = (fiber_t*) malloc(sizeof(fiber_t));
+  memset(result, 0, sizeof(fiber_t));
+  result->process = process;
+  result->arg = arg;
+  result->sched = sched;
+  result->stack = stack;
+  result->refs = 2;
+  result->done = eventcount_ctor(0);
+  result->state = FIBER_STATE_READY;
+  _fiberctx_init(&result->ctx, stack + _fiber_page_size(), sched->stack_size);
+  __atomic_add_fetch(&sched->fibers_num, 1, __ATOMIC_RELAXED);
+  _fiberworker_push(_fibersched_pick(sched), result);
+  return result;
+}
+
+void fiber_dtor(fiber_t* this)
+{
+  if(this == NULL){
+    return;
+  }
+  _fiber_release(this);
+}
+
+//NULL if the caller is not a fiber
+fiber_t* fiber_current()
+{
+  fiberworker_t* worker = _fiber_worker();
+  return worker ? worker->current : NULL;
+}
+
+void fiber_yield()
+{
+  fiberworker_t* worker = _fiber_worker();
+  fiber_t* fiber;
+  if(worker == NULL || worker->current == NULL){
+    sched_yield();
+    return;
+  }
+  fiber = worker->current;
+  assert(ebr_get_depth() == 0);
+  worker->action = FIBER_ACTION_YIELD;
+  _fiberctx_swap(&fiber->ctx, &worker->ctx);
+}
+
+void fiber_sleep(int32_t ms)
+{
+  if(fiber_current() == NULL){
+    thread_sleep(ms);
+    return;
+  }
+  fiber_prepare_park();
+  fiber_park(ms);
+}
+
+//asks the fiber to end and wakes it up if it waits
+void fiber_stop(fiber_t* this)
+{
+  __atomic_store_n(&this->stopping, BOOL_TRUE, __ATOMIC_SEQ_CST);
+  fiber_resume(this);
+}
+
+bool_t fiber_is_stopping(fiber_t* this)
+{
+  return __atomic_load_n(&this->stopping, __ATOMIC_SEQ_CST);
+}
+
+//can be called by threads and fibers as well
+void fiber_join(fiber_t* this)
+{
+  uint32_t key;
+  while((__atomic_load_n(&this->state, __ATOMIC_ACQUIRE) & FIBER_STATE_MASK) != FIBER_STATE_DONE){
+    key = eventcount_prepare_wait(this->done);
+    if((__atomic_load_n(&this->state, __ATOMIC_ACQUIRE) & FIBER_STATE_MASK) == FIBER_STATE_DONE){
+      eventcount_cancel_wait(this->done);
+      break;
+    }
+    eventcount_commit_wait(this->done, key);
+  }
+}
+
+//Waiting takes two steps: fiber_prepare_park is called while the fiber is
+//put where its wakers find it, fiber_park after the locks are released.
+//A resume between the two is not lost.
+void fiber_prepare_park()
+{
+  fiber_t* fiber = fiber_current();
+  uint64_t sequence;
+  assert(fiber != NULL);
+  sequence = (fiber->state >> FIBER_STATE_SEQ_SHIFT) + 1;
+  __atomic_store_n(&fiber->state, (sequence << FIBER_STATE_SEQ_SHIFT) | FIBER_STATE_PARKING, __ATOMIC_SEQ_CST);
+}
+
+//returns BOOL_FALSE if the wait ended after ms, a negative ms waits for a resume only
+bool_t fiber_park(int32_t ms)
+{
+  fiberworker_t* worker = _fiber_worker();
+  fiber_t* fiber = worker->current;
+  uint64_t state;
+  //the fiber may continue on another worker, see lib_fiber.h
+  assert(ebr_get_depth() == 0);
+  if(0 <= ms){
+    state = __atomic_load_n(&fiber->state, __ATOMIC_RELAXED) & ~FIBER_STATE_MASK;
+    __atomic_add_fetch(&fiber->refs, 1, __ATOMIC_RELAXED);
+    _fiberworker_add_timer(worker, fiber, _fiber_now() + ms * 1000000ULL, state | FIBER_STATE_PARKED);
+  }
+  worker->action = FIBER_ACTION_PARK;
+  _fiberctx_swap(&fiber->ctx, &worker->ctx);
+  return !(__atomic_load_n(&fiber->state, __ATOMIC_ACQUIRE) & FIBER_STATE_TIMEDOUT);
+}
+
+//returns BOOL_FALSE if the fiber did not wait or was resumed already
+bool_t fiber_resume(fiber_t* this)
+{
+  uint64_t state;
+  state = __atomic_load_n(&this->state, __ATOMIC_ACQUIRE);
+  for(;;){
+    switch(state & FIBER_STATE_MASK){
+    case FIBER_STATE_PARKED:
+      if(__atomic_compare_exchange_n(&this->state, &state, (state & ~FIBER_STATE_MASK) | FIBER_STATE_READY,
+                                     BOOL_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+        _fiberworker_push(_fibersched_pick(this->sched), this);
+        return BOOL_TRUE;
+      }
+      break;
+    case FIBER_STATE_PARKING:
+      if(__atomic_compare_exchange_n(&this->state, &state, (state & ~FIBER_STATE_MASK) | FIBER_STATE_NOTIFIED,
+                                     BOOL_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+        return BOOL_TRUE;
+      }
+      break;
+    default:
+      return BOOL_FALSE;
+    }
+  }
+}
+
+static void _fiberwaitq_lock(fiberwaitq_t* this)
+{
+  while(__atomic_exchange_n(&this->lock, 1, __ATOMIC_ACQUIRE)){
+    while(__atomic_load_n(&this->lock, __ATOMIC_RELAXED)){
+      cpu_relax();
+    }
+  }
+}
+
+static void _fiberwaitq_unlock(fiberwaitq_t* this)
+{
+  __atomic_store_n(&this->lock, 0, __ATOMIC_RELEASE);
+}
+
+static void _fiberwaitq_remove(fiberwaitq_t* this, fiber_t* fiber)
+{
+  if(fiber->wait_prev){
+    fiber->wait_prev->wait_next = fiber->wait_next;
+  }else{
+    __atomic_store_n(&this->first, fiber->wait_next, __ATOMIC_RELAXED);
+  }
+  if(fiber->wait_next){
+    fiber->wait_next->wait_prev = fiber->wait_prev;
+  }else{
+    this->last = fiber->wait_prev;
+  }
+  fiber->wait_prev = fiber->wait_next = NULL;
+  __atomic_store_n(&fiber->waitq, NULL, __ATOMIC_RELEASE);
+}
+
+//called with the queue locked, returns with the mutex locked again
+static bool_t _fiberwaitq_park(fiberwaitq_t* this, fiber_t* fiber, mutex_t* mutex, int32_t ms)
+{
+  bool_t result;
+  fiber->wait_next = NULL;
+  fiber->wait_prev = this->last;
+  if(this->last){
+    this->last->wait_next = fiber;
+  }else{
+    __atomic_store_n(&this->first, fiber, __ATOMIC_RELEASE);
+  }
+  this->last = fiber;
+  fiber->waitq = this;
+  fiber_prepare_park();
+  _fiberwaitq_unlock(this);
+  if(mutex){
+    pthread_mutex_unlock(mutex);
+  }
+  result = fiber_park(ms);
+  //still queued if a timeout or fiber_stop ended the wait
+  if(__atomic_load_n(&fiber->waitq, __ATOMIC_ACQUIRE)){
+    _fiberwaitq_lock(this);
+    if(fiber->waitq == this){
+      _fiberwaitq_remove(this, fiber);
+    }
+    _fiberwaitq_unlock(this);
+  }
+  if(mutex){
+    pthread_mutex_lock(mutex);
+  }
+  return result;
+}
+
+//parks the calling fiber until a wake, the mutex is released meanwhile
+bool_t fiberwaitq_wait(fiberwaitq_t* this, mutex_t* mutex, int32_t ms)
+{
+  fiber_t* fiber = fiber_current();
+  assert(fiber != NULL);
+  _fiberwaitq_lock(this);
+  return _fiberwaitq_park(this, fiber, mutex, ms);
+}
+
+//parks the calling fiber if the word still holds the key
+bool_t fiberwaitq_wait_key(fiberwaitq_t* this, volatile uint32_t* word, uint32_t key, int32_t ms)
+{
+  fiber_t* fiber = fiber_current();
+  assert(fiber != NULL);
+  _fiberwaitq_lock(this);
+  if(__atomic_load_n(word, __ATOMIC_SEQ_CST) != key){
+    _fiberwaitq_unlock(this);
+    return BOOL_TRUE;
+  }
+  return _fiberwaitq_park(this, fiber, NULL, ms);
+}
+
+//resumes at most num fibers in the order they started to wait
+int32_t fiberwaitq_wake(fiberwaitq_t* this, int32_t num)
+{
+  fiber_t* fiber;
+  int32_t result = 0;
+  _fiberwaitq_lock(this);
+  while(result < num && (fiber = this->first) != NULL){
+    _fiberwaitq_remove(this, fiber);
+    //the fiber can not leave its wait meanwhile, so it is alive
+    if(fiber_resume(fiber)){
+      ++result;
+    }
+  }
+  _fiberwaitq_unlock(this);
+  return result;
+}
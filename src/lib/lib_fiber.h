@@ -0,0 +1,131 @@
+#ifndef INCGUARD_NTRT_LIBRARY_FIBER_H_
+#define INCGUARD_NTRT_LIBRARY_FIBER_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "lib_defs.h"
+#include "lib_threading.h"
+
+#if !defined(__x86_64__) && !defined(__aarch64__)
+#include <ucontext.h>
+#endif
+
+#define FIBER_DEFAULT_STACK_SIZE  (64 * 1024)  ///< usable stack of a fiber, a guard page is mapped below it
+#define FIBER_STACK_POOL_MAX      4096         ///< unused stacks a scheduler keeps mapped
+#define FIBER_IDLE_WAIT_MS        100          ///< longest sleep of an idle worker
+
+typedef enum{
+  FIBER_STATE_READY    = 1,   ///< in a run queue
+  FIBER_STATE_RUNNING  = 2,
+  FIBER_STATE_PARKING  = 3,   ///< about to switch out to wait
+  FIBER_STATE_PARKED   = 4,
+  FIBER_STATE_NOTIFIED = 5,   ///< resumed while it was still parking
+  FIBER_STATE_DONE     = 6,
+}fiber_state_t;
+
+#define FIBER_STATE_MASK      0x0F
+#define FIBER_STATE_TIMEDOUT  0x10   ///< set with READY if a timer ended the wait
+#define FIBER_STATE_SEQ_SHIFT 8      ///< the bits above count the waits, so stale wakeups miss
+
+//saved registers of a fiber or of the worker running it
+#if defined(__x86_64__) || defined(__aarch64__)
+typedef struct _fiberctx {
+  void*                   sp;
+} fiberctx_t;
+#else
+typedef struct _fiberctx {
+  ucontext_t              context;
+} fiberctx_t;
+#endif
+
+struct _fibersched;
+
+typedef struct fiber_struct_t {
+  fiberctx_t              ctx;
+  volatile uint64_t       state;          ///< fiber_state_t, the timeout flag and the wait sequence
+  void*                 (*process)(void*);
+  void*                   arg;
+  struct _fibersched*     sched;
+  void*                   stack;          ///< the mapping, starting with the guard page
+  volatile bool_t         stopping;
+  volatile int32_t        refs;           ///< the handle, the run and the pending timers
+  eventcount_t*           done;
+  struct fiber_struct_t*  next;           ///< in a run queue
+  struct fiber_struct_t*  wait_prev;      ///< in a fiberwaitq_t
+  struct fiber_struct_t*  wait_next;
+  fiberwaitq_t*           waitq;          ///< the queue the fiber waits in, NULL if none
+} fiber_t;
+
+//a wait of a fiber with a timeout, kept in a binary heap of its worker
+typedef struct _fibertimer {
+  uint64_t                deadline;       ///< CLOCK_MONOTONIC ns
+  uint64_t                state;          ///< the state of the fiber the timer may end
+  fiber_t*                fiber;
+} fibertimer_t;
+
+typedef enum{
+  FIBER_ACTION_NONE  = 0,
+  FIBER_ACTION_YIELD = 1,
+  FIBER_ACTION_PARK  = 2,
+  FIBER_ACTION_EXIT  = 3,
+}fiber_action_t;
+
+typedef struct _fiberworker {
+  struct _fibersched*     sched;
+  int32_t                 index;
+  fiberctx_t              ctx;            ///< where the fibers switch back to
+  fiber_t*                current;
+  fiber_action_t          action;         ///< done by the worker after the fiber switched out
+  spin_t                  queue_lock;
+  fiber_t*                first;
+  fiber_t*                last;
+  fibertimer_t*           timers;
+  int32_t                 timers_num;
+  int32_t                 timers_size;
+  thread_t*               thread;
+} __attribute__((aligned(64))) fiberworker_t;
+
+//M:N scheduler running fibers on a fixed number of worker threads
+typedef struct _fibersched {
+  fiberworker_t*          workers;
+  int32_t                 workers_num;
+  size_t                  stack_size;
+  eventcount_t*           ready;          ///< wakes idle workers
+  volatile int32_t        pending;        ///< fibers in the run queues
+  volatile uint32_t       next_worker;    ///< run queue of the next fiber resumed from outside
+  volatile int32_t        fibers_num;     ///< fibers spawned and not finished
+  spin_t                  stacks_lock;
+  void*                   stacks;         ///< unused stacks, linked through their first word
+  int32_t                 stacks_num;
+} fibersched_t;
+
+fibersched_t* fibersched_ctor(int32_t workers_num, size_t stack_size);
+void fibersched_dtor(fibersched_t* this);
+void* fibersched_worker_process(void* arg);
+int32_t fibersched_get_fibers_num(fibersched_t* this);
+
+//A fiber may continue on another worker after fiber_yield, fiber_park and the
+//waits built on them, the state kept per thread stays with the old worker.
+//So a fiber must not switch out between ebr_enter and ebr_leave (this includes
+//skiplist_enter and skiplist_leave), and with PROFILE_LOCKS it must not hold a
+//lock of lib_threading either. Memory of arena_alloc may be freed on any worker.
+fiber_t* fiber_spawn(fibersched_t* sched, void* (*process)(void*), void* arg);
+void fiber_dtor(fiber_t* this);
+fiber_t* fiber_current();
+void fiber_yield();
+void fiber_sleep(int32_t ms);
+void fiber_stop(fiber_t* this);
+bool_t fiber_is_stopping(fiber_t* this);
+void fiber_join(fiber_t* this);
+
+void fiber_prepare_park();
+bool_t fiber_park(int32_t ms);
+bool_t fiber_resume(fiber_t* this);
+
+bool_t fiberwaitq_wait(fiberwaitq_t* this, mutex_t* mutex, int32_t ms);
+bool_t fiberwaitq_wait_key(fiberwaitq_t* this, volatile uint32_t* word, uint32_t key, int32_t ms);
+int32_t fiberwaitq_wake(fiberwaitq_t* this, int32_t num);
+
+#endif /* INCGUARD_NTRT_LIBRARY_FIBER_H_ */
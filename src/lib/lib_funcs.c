@@ -6,7 +6,9 @@
 #include "dmap.h"
 #include "dmap_sel.h"
 #include "lib_makers.h"
+#include "lib_links.h"
 #include "fsm.h"
+#include <stdint.h>
 
 
 void execute_cback(callback_t *cback)
@@ -59,8 +61,9 @@ datchain_t* datchain_append(datchain_t *chain, ptr_t item)
   if(!chain){
     return tail;
   }
-  for(tail = head = chain; tail->next; tail = tail->next);
-  tail->next = item;
+  for(head = chain; chain->next; chain = chain->next);
+  chain->next = tail;
+  tail->prev = chain;
   return head;
 }
 
@@ -107,18 +110,12 @@ void slist_foreach(slist_t* slist, void (*process)(slist_t*, ptr_t), ptr_t data)
 
 slist_t* slist_cpy(slist_t* slist)
 {
-  slist_t* head, *actual;
-  if(!slist){
-    return NULL;
-  }
-  actual = slist;
-again:
-  head = slist_append(head, actual->data);
-  actual = actual->next;
-  if(actual){
-    goto again;
+  slisthead_t head;
+  memset(&head, 0, sizeof(slisthead_t));
+  for(; slist; slist = slist->next){
+    slisthead_append(&head, slist->data);
   }
-  return head;
+  return head.first;
 }
 
 
@@ -158,6 +155,264 @@ void dlist_foreach(dlist_t* dlist, void (*process)(dlist_t*, ptr_t), ptr_t data)
   }
 }
 
+void datchainhead_append(datchainhead_t *head, ptr_t item)
+{
+  datchain_t *tail;
+  tail = make_datchain(item);
+  ++head->length;
+  if(!head->last){
+    head->first = head->last = tail;
+    return;
+  }
+  tail->prev = head->last;
+  head->last->next = tail;
+  head->last = tail;
+}
+
+void datchainhead_prepend(datchainhead_t *head, ptr_t item)
+{
+  head->first = datchain_prepend(head->first, item);
+  if(!head->last){
+    head->last = head->first;
+  }
+  ++head->length;
+}
+
+ptr_t datchainhead_pop_first(datchainhead_t *head)
+{
+  datchain_t *first;
+  ptr_t result;
+  if(!head->first){
+    return NULL;
+  }
+  first = head->first;
+  result = first->data;
+  head->first = first->next;
+  if(head->first){
+    head->first->prev = NULL;
+  }else{
+    head->last = NULL;
+  }
+  --head->length;
+  free(first);
+  return result;
+}
+
+void slisthead_append(slisthead_t *head, ptr_t item)
+{
+  slist_t *tail;
+  tail = make_slist(item);
+  ++head->length;
+  if(!head->last){
+    head->first = head->last = tail;
+    return;
+  }
+  head->last->next = tail;
+  head->last = tail;
+}
+
+void slisthead_prepend(slisthead_t *head, ptr_t item)
+{
+  head->first = slist_prepend(head->first, item);
+  if(!head->last){
+    head->last = head->first;
+  }
+  ++head->length;
+}
+
+ptr_t slisthead_pop_first(slisthead_t *head)
+{
+  slist_t *first;
+  ptr_t result;
+  if(!head->first){
+    return NULL;
+  }
+  first = head->first;
+  result = first->data;
+  head->first = first->next;
+  if(!head->first){
+    head->last = NULL;
+  }
+  --head->length;
+  free(first);
+  return result;
+}
+
+void dlisthead_append(dlisthead_t *head, ptr_t item)
+{
+  dlist_t *tail;
+  tail = make_dlist(item);
+  ++head->length;
+  if(!head->last){
+    head->first = head->last = tail;
+    return;
+  }
+  tail->prev = head->last;
+  head->last->next = tail;
+  head->last = tail;
+}
+
+void dlisthead_prepend(dlisthead_t *head, ptr_t item)
+{
+  head->first = dlist_prepend(head->first, item);
+  if(!head->last){
+    head->last = head->first;
+  }
+  ++head->length;
+}
+
+void dlisthead_remove(dlisthead_t *head, dlist_t *dlist)
+{
+  if(dlist->prev){
+    dlist->prev->next = dlist->next;
+  }else{
+    head->first = dlist->next;
+  }
+  if(dlist->next){
+    dlist->next->prev = dlist->prev;
+  }else{
+    head->last = dlist->prev;
+  }
+  --head->length;
+  free(dlist);
+}
+
+ptr_t dlisthead_pop_first(dlisthead_t *head)
+{
+  ptr_t result;
+  if(!head->first){
+    return NULL;
+  }
+  result = head->first->data;
+  dlisthead_remove(head, head->first);
+  return result;
+}
+
+ptr_t dlisthead_pop_last(dlisthead_t *head)
+{
+  ptr_t result;
+  if(!head->last){
+    return NULL;
+  }
+  result = head->last->data;
+  dlisthead_remove(head, head->last);
+  return result;
+}
+
+typedef struct _lists_test_item_struct_t{
+  int32_t   value;
+  slink_t   slink;
+  dlink_t   dlink;
+}_lists_test_item_t;
+
+void lists_test(void)
+{
+  slisthead_t         shead;
+  dlisthead_t         dhead;
+  datchainhead_t      chead;
+  datchain_t         *chain;
+  slist_t            *slist, *copy, *actual;
+  dlist_t            *middle;
+  slinkhead_t         slinks;
+  slink_t            *slink;
+  dlink_t             dlinks, *dlink, *next;
+  _lists_test_item_t  items[4];
+  intptr_t            value;
+  int32_t             index, failed = 0;
+
+  //the heads keep both of their ends through append, prepend and pop, also when they get empty
+  memset(&shead, 0, sizeof(slisthead_t));
+  failed += slisthead_pop_first(&shead) != NULL;
+  slisthead_append(&shead, (ptr_t) 2);
+  slisthead_prepend(&shead, (ptr_t) 1);
+  slisthead_append(&shead, (ptr_t) 3);
+  failed += shead.length != 3 || shead.last->data != (ptr_t) 3 || shead.last->next != NULL;
+  for(value = 1; value <= 3; ++value){
+    failed += slisthead_pop_first(&shead) != (ptr_t) value;
+  }
+  failed += shead.first != NULL || shead.last != NULL || shead.length != 0;
+  slisthead_prepend(&shead, (ptr_t) 4);
+  failed += shead.first != shead.last || slisthead_pop_first(&shead) != (ptr_t) 4;
+
+  memset(&chead, 0, sizeof(datchainhead_t));
+  failed += datchainhead_pop_first(&chead) != NULL;
+  datchainhead_append(&chead, (ptr_t) 2);
+  datchainhead_prepend(&chead, (ptr_t) 1);
+  datchainhead_append(&chead, (ptr_t) 3);
+  failed += chead.length != 3 || chead.last->prev->prev != chead.first || chead.first->prev != NULL;
+  for(value = 1; value <= 3; ++value){
+    failed += datchainhead_pop_first(&chead) != (ptr_t) value;
+  }
+  failed += chead.first != NULL || chead.last != NULL || chead.length != 0;
+
+  //a node removed from the middle and from both ends
+  memset(&dhead, 0, sizeof(dlisthead_t));
+  failed += dlisthead_pop_first(&dhead) != NULL || dlisthead_pop_last(&dhead) != NULL;
+  for(value = 1; value <= 5; ++value){
+    dlisthead_append(&dhead, (ptr_t) value);
+  }
+  dlisthead_prepend(&dhead, (ptr_t) 0);
+  middle = dhead.first->next->next->next;
+  dlisthead_remove(&dhead, middle);
+  failed += dhead.length != 5 || dhead.first->prev != NULL || dhead.last->next != NULL;
+  failed += dlisthead_pop_first(&dhead) != (ptr_t) 0 || dlisthead_pop_last(&dhead) != (ptr_t) 5;
+  failed += dlisthead_pop_first(&dhead) != (ptr_t) 1 || dlisthead_pop_first(&dhead) != (ptr_t) 2;
+  failed += dlisthead_pop_last(&dhead) != (ptr_t) 4;
+  failed += dhead.first != NULL || dhead.last != NULL || dhead.length != 0;
+
+  //the chain links the new node to its tail and a copied list keeps the order
+  chain = datchain_append(NULL, (ptr_t) 1);
+  chain = datchain_append(chain, (ptr_t) 2);
+  chain = datchain_append(chain, (ptr_t) 3);
+  failed += chain->data != (ptr_t) 1 || chain->next->next->data != (ptr_t) 3 || chain->next->next->prev != chain->next;
+  datchain_dtor(chain, NULL);
+  slist = NULL;
+  for(value = 1; value <= 3; ++value){
+    slist = slist_append(slist, (ptr_t) value);
+  }
+  copy = slist_cpy(slist);
+  for(value = 1, actual = copy; actual; actual = actual->next, ++value){
+    failed += actual->data != (ptr_t) value;
+  }
+  failed += value != 4 || slist_cpy(NULL) != NULL;
+  slist_dtor(slist, NULL);
+  slist_dtor(copy, NULL);
+
+  //an item is on an intrusive singly and doubly linked list at the same time
+  slinkhead_init(&slinks);
+  dlink_init(&dlinks);
+  failed += slinkhead_pop_first(&slinks) != NULL || dlink_is_empty(&dlinks) == BOOL_FALSE;
+  for(index = 0; index < 4; ++index){
+    items[index].value = index;
+    slinkhead_append(&slinks, &items[index].slink);
+    dlink_prepend(&dlinks, &items[index].dlink);
+  }
+  index = 0;
+  slinkhead_foreach(slink, &slinks){
+    failed += link_entry(slink, _lists_test_item_t, slink)->value != index++;
+  }
+  failed += index != 4 || slinks.length != 4;
+  dlink_foreach_safe(dlink, next, &dlinks){
+    if(link_entry(dlink, _lists_test_item_t, dlink)->value % 2){
+      dlink_remove(dlink);
+    }
+  }
+  index = 2;
+  dlink_foreach(dlink, &dlinks){
+    failed += link_entry(dlink, _lists_test_item_t, dlink)->value != index;
+    index -= 2;
+  }
+  failed += index != -2 || items[1].dlink.next != &items[1].dlink;
+  dlink_remove(&items[0].dlink);
+  dlink_remove(&items[2].dlink);
+  failed += dlink_is_empty(&dlinks) == BOOL_FALSE;
+  for(index = 0; index < 4; ++index){
+    failed += slinkhead_pop_first(&slinks) != &items[index].slink;
+  }
+  failed += slinks.first != NULL || slinks.last != NULL || slinks.length != 0;
+  printf("lists_test: %s\n", failed ? "FAILED" : "passed");
+}
+
 void *eventer(eventer_arg_t *eventer_arg)
 {
 	int32_t event;
@@ -31,6 +31,21 @@ dlist_t* dlist_append(dlist_t *dlist, ptr_t item);
 dlist_t* dlist_prepend(dlist_t* dlist, ptr_t item);
 void dlist_foreach(dlist_t* dlist, void (*process)(dlist_t*, ptr_t), ptr_t data);
 
+void datchainhead_append(datchainhead_t *head, ptr_t item);
+void datchainhead_prepend(datchainhead_t *head, ptr_t item);
+ptr_t datchainhead_pop_first(datchainhead_t *head);
+
+void slisthead_append(slisthead_t *head, ptr_t item);
+void slisthead_prepend(slisthead_t *head, ptr_t item);
+ptr_t slisthead_pop_first(slisthead_t *head);
+
+void dlisthead_append(dlisthead_t *head, ptr_t item);
+void dlisthead_prepend(dlisthead_t *head, ptr_t item);
+ptr_t dlisthead_pop_first(dlisthead_t *head);
+ptr_t dlisthead_pop_last(dlisthead_t *head);
+void dlisthead_remove(dlisthead_t *head, dlist_t *dlist);
+void lists_test(void);
+
 void *eventer(eventer_arg_t *eventer_arg);
 
 void ptrmov(void **dst, void **src);
@@ -0,0 +1,153 @@
+/**
+ * @file lib_links.h
+ * @brief intrusive lists, the link fields live inside of the linked structure
+*/
+#ifndef INCGUARD_NTRT_LIBRARY_LINKS_H_
+#define INCGUARD_NTRT_LIBRARY_LINKS_H_
+
+#include <stddef.h>
+#include "lib_defs.h"
+
+/* Usage:
+ *
+ * typedef struct foo_struct_t{
+ *   int32_t   value;
+ *   dlink_t   link;
+ * }foo_t;
+ *
+ * dlink_t  foos;
+ * dlink_t *it;
+ * dlink_init(&foos);
+ * dlink_append(&foos, &foo->link);
+ * dlink_foreach(it, &foos){
+ *   printf("%d", link_entry(it, foo_t, link)->value);
+ * }
+ *
+ * Linking and unlinking never allocates, an item can be on as many lists
+ * at the same time as many link fields it has.
+ */
+
+/** \def link_entry(LINK_PTR, TYPE, MEMBER)
+      \brief gets the structure of TYPE embedding the link pointed by LINK_PTR as MEMBER
+  */
+#define link_entry(LINK_PTR, TYPE, MEMBER) \
+	((TYPE*) ((char_t*) (LINK_PTR) - offsetof(TYPE, MEMBER)))
+
+/** \typedef slink_t
+      \brief describes a link of an intrusive singly linked list
+  */
+typedef struct slink_struct_t{
+	struct slink_struct_t* next;      ///< Pointing to the next link of the list
+}slink_t;
+
+/** \typedef slinkhead_t
+      \brief describes the two ends of an intrusive singly linked list
+  */
+typedef struct slinkhead_struct_t{
+	slink_t*               first;     ///< Pointing to the first link of the list
+	slink_t*               last;      ///< Pointing to the last link of the list
+	int32_t                length;    ///< The number of links in the list
+}slinkhead_t;
+
+/** \typedef dlink_t
+      \brief describes a link of an intrusive circular doubly linked list.
+      The head of the list is a dlink_t not embedded into any item.
+  */
+typedef struct dlink_struct_t{
+	struct dlink_struct_t* next;      ///< Pointing to the next link of the list
+	struct dlink_struct_t* prev;      ///< Pointing to the previous link of the list
+}dlink_t;
+
+static inline void slinkhead_init(slinkhead_t *head)
+{
+	head->first = head->last = NULL;
+	head->length = 0;
+}
+
+static inline void slinkhead_append(slinkhead_t *head, slink_t *link)
+{
+	link->next = NULL;
+	if(!head->last){
+		head->first = link;
+	}else{
+		head->last->next = link;
+	}
+	head->last = link;
+	++head->length;
+}
+
+static inline void slinkhead_prepend(slinkhead_t *head, slink_t *link)
+{
+	link->next = head->first;
+	head->first = link;
+	if(!head->last){
+		head->last = link;
+	}
+	++head->length;
+}
+
+static inline slink_t* slinkhead_pop_first(slinkhead_t *head)
+{
+	slink_t *result;
+	result = head->first;
+	if(!result){
+		return NULL;
+	}
+	head->first = result->next;
+	if(!head->first){
+		head->last = NULL;
+	}
+	result->next = NULL;
+	--head->length;
+	return result;
+}
+
+#define slinkhead_foreach(IT, HEAD) \
+	for(IT = (HEAD)->first; IT; IT = IT->next)
+
+static inline void dlink_init(dlink_t *head)
+{
+	head->next = head->prev = head;
+}
+
+static inline bool_t dlink_is_empty(dlink_t *head)
+{
+	return head->next == head ? BOOL_TRUE : BOOL_FALSE;
+}
+
+static inline void _dlink_insert(dlink_t *link, dlink_t *prev, dlink_t *next)
+{
+	next->prev = link;
+	link->next = next;
+	link->prev = prev;
+	prev->next = link;
+}
+
+//add the link to the end of the list
+static inline void dlink_append(dlink_t *head, dlink_t *link)
+{
+	_dlink_insert(link, head->prev, head);
+}
+
+//add the link to the beginning of the list
+static inline void dlink_prepend(dlink_t *head, dlink_t *link)
+{
+	_dlink_insert(link, head, head->next);
+}
+
+//unlink the link from the list it is on, the link is reinitialized
+static inline void dlink_remove(dlink_t *link)
+{
+	link->next->prev = link->prev;
+	link->prev->next = link->next;
+	dlink_init(link);
+}
+
+#define dlink_foreach(IT, HEAD) \
+	for(IT = (HEAD)->next; IT != (HEAD); IT = IT->next)
+
+//iterate a list the actual link can be removed from while iterating
+#define dlink_foreach_safe(IT, NEXT, HEAD) \
+	for(IT = (HEAD)->next, NEXT = IT->next; IT != (HEAD); IT = NEXT, NEXT = IT->next)
+
+#endif /* INCGUARD_NTRT_LIBRARY_LINKS_H_ */
@@ -0,0 +1,298 @@
+#include "lib_lockprof.h"
+#include "lib_descs.h"
+#include <stdint.h>
+#include <pthread.h>
+#include <execinfo.h>
+
+//Every thread records into its own table, so recording takes no lock. The
+//tables are linked into a list once and kept after their thread exits, the
+//dump sums them up by lock and caller.
+
+static pthread_mutex_t             _lockprof_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static lockprofthread_t*           _lockprof_threads = NULL;
+static __thread lockprofthread_t*  _lockprof_thread = NULL;
+static thread_t*                   _lockprof_dumper = NULL;
+static int32_t                     _lockprof_dumper_period;
+static int32_t                     _lockprof_dumper_top;
+
+#define _LOCKPROF_ADD(FIELD, VALUE) __atomic_store_n(&(FIELD), (FIELD) + (VALUE), __ATOMIC_RELAXED)
+
+static lockprofthread_t* _lockprof_get_thread()
+{
+  lockprofthread_t* result = _lockprof_thread;
+  if(result != NULL){
+    return result;
+  }
+  result = (lockprofthread_t*) calloc(1, sizeof(lockprofthread_t));
+  pthread_mutex_lock(&_lockprof_threads_mutex);
+  result->next = _lockprof_threads;
+  __atomic_store_n(&_lockprof_threads, result, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&_lockprof_threads_mutex);
+  _lockprof_thread = result;
+  return result;
+}
+
+static int32_t _lockprof_bucket(uint64_t cycles)
+{
+  int32_t result = 63 - __builtin_clzll(cycles | 1);
+  return result < LOCKPROF_BUCKETS ? result : LOCKPROF_BUCKETS - 1;
+}
+
+static lockprofsite_t* _lockprof_get_site(lockprofthread_t* thread, ptr_t lock, ptr_t caller)
+{
+  lockprofsite_t* site;
+  uintptr_t hash;
+  int32_t probe;
+  hash = ((uintptr_t) lock ^ ((uintptr_t) caller * 31)) * 0x9E3779B97F4A7C15ULL;
+  for(probe = 0; probe < LOCKPROF_MAX_SITES; ++probe){
+    site = &thread->sites[(hash + probe) & (LOCKPROF_MAX_SITES - 1)];
+    if(site->lock == lock && site->caller == caller){
+      return site;
+    }
+    if(site->lock == NULL){
+      site->caller = caller;
+      __atomic_store_n(&site->lock, lock, __ATOMIC_RELEASE);
+      return site;
+    }
+  }
+  return NULL;
+}
+
+void lockprof_record_acquire(ptr_t lock, ptr_t caller, uint64_t started)
+{
+  lockprofthread_t* thread = _lockprof_get_thread();
+  lockprofsite_t* site;
+  uint64_t now, wait;
+  now = cpu_cycles();
+  wait = now - started;
+  site = _lockprof_get_site(thread, lock, caller);
+  if(site == NULL){
+    _LOCKPROF_ADD(thread->dropped, 1);
+  }else{
+    _LOCKPROF_ADD(site->acquisitions, 1);
+    _LOCKPROF_ADD(site->wait_cycles, wait);
+    _LOCKPROF_ADD(site->wait_histogram[_lockprof_bucket(wait)], 1);
+    if(LOCKPROF_CONTENDED_CYCLES < wait){
+      _LOCKPROF_ADD(site->contended, 1);
+    }
+  }
+  if(thread->held_num < LOCKPROF_MAX_HELD){
+    thread->held[thread->held_num].lock = lock;
+    thread->held[thread->held_num].site = site;
+    thread->held[thread->held_num].acquired = now;
+    ++thread->held_num;
+  }
+}
+
+void lockprof_record_release(ptr_t lock)
+{
+  lockprofthread_t* thread = _lockprof_get_thread();
+  lockprofheld_t* held;
+  uint64_t hold;
+  int32_t index;
+  //locks are mostly released in the reverse order
+  for(index = thread->held_num - 1; 0 <= index && thread->held[index].lock != lock; --index);
+  if(index < 0){
+    return;
+  }
+  held = &thread->held[index];
+  if(held->site != NULL){
+    hold = cpu_cycles() - held->acquired;
+    _LOCKPROF_ADD(held->site->hold_cycles, hold);
+    _LOCKPROF_ADD(held->site->hold_histogram[_lockprof_bucket(hold)], 1);
+  }
+  thread->held[index] = thread->held[--thread->held_num];
+}
+
+//the upper bound of the bucket the given percentile of the samples falls in
+static uint64_t _lockprof_percentile(uint64_t* histogram, uint64_t total, int32_t percent)
+{
+  uint64_t sum = 0;
+  int32_t bucket;
+  for(bucket = 0; bucket < LOCKPROF_BUCKETS; ++bucket){
+    sum += histogram[bucket];
+    if(total * percent <= sum * 100){
+      break;
+    }
+  }
+  return 2ULL << (bucket < LOCKPROF_BUCKETS ? bucket : LOCKPROF_BUCKETS - 1);
+}
+
+static int _lockprof_cmp_wait(const void* a, const void* b)
+{
+  const lockprofsite_t* first = (const lockprofsite_t*) a;
+  const lockprofsite_t* second = (const lockprofsite_t*) b;
+  if(first->wait_cycles == second->wait_cycles){
+    return 0;
+  }
+  return first->wait_cycles < second->wait_cycles ? 1 : -1;
+}
+
+static void _lockprof_sum_site(lockprofsite_t* sum, lockprofsite_t* site)
+{
+  int32_t bucket;
+  sum->acquisitions += __atomic_load_n(&site->acquisitions, __ATOMIC_RELAXED);
+  sum->contended += __atomic_load_n(&site->contended, __ATOMIC_RELAXED);
+  sum->wait_cycles += __atomic_load_n(&site->wait_cycles, __ATOMIC_RELAXED);
+  sum->hold_cycles += __atomic_load_n(&site->hold_cycles, __ATOMIC_RELAXED);
+  for(bucket = 0; bucket < LOCKPROF_BUCKETS; ++bucket){
+    sum->wait_histogram[bucket] += __atomic_load_n(&site->wait_histogram[bucket], __ATOMIC_RELAXED);
+    sum->hold_histogram[bucket] += __atomic_load_n(&site->hold_histogram[bucket], __ATOMIC_RELAXED);
+  }
+}
+
+//prints the lock sites with the most cycles spent waiting
+void lockprof_dump(int32_t top)
+{
+  lockprofthread_t* thread;
+  lockprofsite_t* sums;
+  lockprofsite_t* site;
+  char** symbols;
+  uint64_t dropped = 0;
+  int32_t sums_num = 0, index, found;
+  ptr_t lock;
+
+  sums = (lockprofsite_t*) calloc(LOCKPROF_MAX_SITES, sizeof(lockprofsite_t));
+  for(thread = __atomic_load_n(&_lockprof_threads, __ATOMIC_ACQUIRE); thread; thread = thread->next){
+    dropped += __atomic_load_n(&thread->dropped, __ATOMIC_RELAXED);
+    for(index = 0; index < LOCKPROF_MAX_SITES; ++index){
+      site = &thread->sites[index];
+      lock = __atomic_load_n(&site->lock, __ATOMIC_ACQUIRE);
+      if(lock == NULL){
+        continue;
+      }
+      for(found = 0; found < sums_num && (sums[found].lock != lock || sums[found].caller != site->caller); ++found);
+      if(found == sums_num){
+        if(sums_num == LOCKPROF_MAX_SITES){
+          ++dropped;
+          continue;
+        }
+        sums[sums_num].lock = lock;
+        sums[sums_num].caller = site->caller;
+        ++sums_num;
+      }
+      _lockprof_sum_site(&sums[found], site);
+    }
+  }
+  qsort(sums, sums_num, sizeof(lockprofsite_t), _lockprof_cmp_wait);
+  if(top < sums_num){
+    sums_num = top;
+  }
+
+  INFOPRINT("Top %d contended locks (cycles)", sums_num);
+  for(index = 0; index < sums_num; ++index){
+    site = &sums[index];
+    symbols = backtrace_symbols(&site->caller, 1);
+    INFOPRINT("%2d. lock %p at %s: %llu acquisitions, %llu contended, "
+              "wait %llu total %llu avg %llu p99, hold %llu avg %llu p99",
+              index + 1, site->lock, symbols ? symbols[0] : "?",
+              (unsigned long long) site->acquisitions, (unsigned long long) site->contended,
+              (unsigned long long) site->wait_cycles,
+              (unsigned long long) (site->wait_cycles / site->acquisitions),
+              (unsigned long long) _lockprof_percentile((uint64_t*) site->wait_histogram, site->acquisitions, 99),
+              (unsigned long long) (site->hold_cycles / site->acquisitions),
+              (unsigned long long) _lockprof_percentile((uint64_t*) site->hold_histogram, site->acquisitions, 99));
+    free(symbols);
+  }
+  if(dropped){
+    INFOPRINT("%llu lock acquisitions were not recorded", (unsigned long long) dropped);
+  }
+  free(sums);
+}
+
+static void* _lockprof_dumper_process(void* arg)
+{
+  thread_t* thread = (thread_t*) arg;
+  int32_t waited;
+  thread->state = THREAD_STATE_RUN;
+  while(thread->state == THREAD_STATE_RUN){
+    for(waited = 0; waited < _lockprof_dumper_period && thread->state == THREAD_STATE_RUN; waited += 100){
+      thread_sleep(100);
+    }
+    if(thread->state == THREAD_STATE_RUN){
+      lockprof_dump(_lockprof_dumper_top);
+    }
+  }
+  thread->state = THREAD_STATE_STOPPED;
+  return NULL;
+}
+
+void lockprof_start_dumping(int32_t period_ms, int32_t top)
+{
+  if(_lockprof_dumper != NULL){
+    return;
+  }
+  _lockprof_dumper_period = period_ms;
+  _lockprof_dumper_top = top;
+  _lockprof_dumper = thread_ctor();
+  setup_thread(_lockprof_dumper, _lockprof_dumper_process, NULL);
+  start_thread(_lockprof_dumper);
+}
+
+void lockprof_stop_dumping()
+{
+  if(_lockprof_dumper == NULL){
+    return;
+  }
+  stop_thread(_lockprof_dumper);
+  pthread_join(_lockprof_dumper->handler, NULL);
+  thread_dtor(_lockprof_dumper);
+  _lockprof_dumper = NULL;
+}
+
+static pthread_mutex_t _lockprof_test_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//waits on the mutex held by lockprof_test, so its acquisition is contended
+static void* _lockprof_test_waiter(void* arg __attribute__((unused)))
+{
+  uint64_t started = cpu_cycles();
+  pthread_mutex_lock(&_lockprof_test_mutex);
+  lockprof_record_acquire(&_lockprof_test_mutex, (ptr_t) _lockprof_test_waiter, started);
+  lockprof_record_release(&_lockprof_test_mutex);
+  pthread_mutex_unlock(&_lockprof_test_mutex);
+  return NULL;
+}
+
+void lockprof_test()
+{
+  lockprofthread_t* thread;
+  lockprofsite_t sum, waiter;
+  pthread_t handler;
+  uint64_t waits = 0, holds = 0;
+  int32_t index, failed = 0;
+
+  //the table is allocated first, so it does not count as a wait of the lock below
+  _lockprof_get_thread();
+  pthread_mutex_lock(&_lockprof_test_mutex);
+  lockprof_record_acquire(&_lockprof_test_mutex, (ptr_t) lockprof_test, cpu_cycles());
+  pthread_create(&handler, NULL, _lockprof_test_waiter, NULL);
+  thread_sleep(10);
+  lockprof_record_release(&_lockprof_test_mutex);
+  pthread_mutex_unlock(&_lockprof_test_mutex);
+  pthread_join(handler, NULL);
+  failed += _lockprof_thread->held_num != 0;
+
+  //both acquisitions are recorded, only the one of the waiter as contended
+  memset(&sum, 0, sizeof(lockprofsite_t));
+  memset(&waiter, 0, sizeof(lockprofsite_t));
+  for(thread = __atomic_load_n(&_lockprof_threads, __ATOMIC_ACQUIRE); thread; thread = thread->next){
+    for(index = 0; index < LOCKPROF_MAX_SITES; ++index){
+      if(thread->sites[index].lock != (ptr_t) &_lockprof_test_mutex){
+        continue;
+      }
+      _lockprof_sum_site(&sum, &thread->sites[index]);
+      if(thread->sites[index].caller == (ptr_t) _lockprof_test_waiter){
+        _lockprof_sum_site(&waiter, &thread->sites[index]);
+      }
+    }
+  }
+  failed += sum.acquisitions != 2 || waiter.acquisitions != 1;
+  failed += sum.contended != 1 || waiter.contended != 1;
+  failed += waiter.wait_cycles <= LOCKPROF_CONTENDED_CYCLES || sum.hold_cycles <= waiter.hold_cycles;
+  for(index = 0; index < LOCKPROF_BUCKETS; ++index){
+    waits += sum.wait_histogram[index];
+    holds += sum.hold_histogram[index];
+  }
+  failed += waits != 2 || holds != 2;
+  printf("lockprof_test: %s\n", failed ? "FAILED" : "passed");
+}
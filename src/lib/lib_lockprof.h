@@ -0,0 +1,64 @@
+#ifndef INCGUARD_NTRT_LIBRARY_LOCKPROF_H_
+#define INCGUARD_NTRT_LIBRARY_LOCKPROF_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib_defs.h"
+#include "lib_threading.h"
+
+//Define PROFILE_LOCKS (e.g. in CPPFLAGS) to record the wait and hold times
+//of the locks of lib_threading. It does not depend on the debug build.
+//#define PROFILE_LOCKS
+
+#define LOCKPROF_MAX_SITES          256   ///< lock and caller pairs a thread can record
+#define LOCKPROF_MAX_HELD           16    ///< locks a thread can hold at the same time
+#define LOCKPROF_BUCKETS            32    ///< log2 cycle buckets of the histograms
+#define LOCKPROF_CONTENDED_CYCLES   1024  ///< waits longer than this count as contended
+#define LOCKPROF_DEFAULT_TOP        10
+
+//a lock acquired from a certain place of the code
+typedef struct _lockprofsite {
+  ptr_t              lock;
+  ptr_t              caller;
+  volatile uint64_t  acquisitions;
+  volatile uint64_t  contended;
+  volatile uint64_t  wait_cycles;
+  volatile uint64_t  hold_cycles;
+  volatile uint64_t  wait_histogram[LOCKPROF_BUCKETS];
+  volatile uint64_t  hold_histogram[LOCKPROF_BUCKETS];
+} lockprofsite_t;
+
+typedef struct _lockprofheld {
+  ptr_t              lock;
+  lockprofsite_t*    site;
+  uint64_t           acquired;
+} lockprofheld_t;
+
+//the records of one thread, only the thread itself writes them
+typedef struct _lockprofthread {
+  lockprofsite_t            sites[LOCKPROF_MAX_SITES];
+  lockprofheld_t            held[LOCKPROF_MAX_HELD];
+  int32_t                   held_num;
+  volatile uint64_t         dropped;        ///< acquisitions not recorded as the sites are full
+  struct _lockprofthread*   next;
+} lockprofthread_t;
+
+#ifdef PROFILE_LOCKS
+#define lockprof_begin()        uint64_t _lockprof_started = cpu_cycles()
+#define lockprof_acquired(LOCK) lockprof_record_acquire((ptr_t)(LOCK), __builtin_return_address(0), _lockprof_started)
+#define lockprof_released(LOCK) lockprof_record_release((ptr_t)(LOCK))
+#else
+#define lockprof_begin()
+#define lockprof_acquired(LOCK)
+#define lockprof_released(LOCK)
+#endif
+
+void lockprof_record_acquire(ptr_t lock, ptr_t caller, uint64_t started);
+void lockprof_record_release(ptr_t lock);
+void lockprof_dump(int32_t top);
+void lockprof_start_dumping(int32_t period_ms, int32_t top);
+void lockprof_stop_dumping();
+void lockprof_test();
+
+#endif /* INCGUARD_NTRT_LIBRARY_LOCKPROF_H_ */
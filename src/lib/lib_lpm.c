@@ -0,0 +1,625 @@
+#include "lib_lpm.h"
+#include "inc_inet.h"
+
+//entry layout: valid flag, tbl8 extension flag, depth on 6 bits, nexthop on 24 bits
+#define _LPM_VALID          0x80000000u
+#define _LPM_EXT            0x40000000u
+#define _LPM_DEPTH(e)       (((e) >> 24) & 0x3F)
+#define _LPM_NEXTHOP(e)     ((e) & LPM_NEXTHOP_MAX)
+#define _LPM_ENTRY(d, nh)   (_LPM_VALID | ((uint32_t)(d) << 24) | (nh))
+
+#define _LPM_TBL24_SIZE     (1 << 24)
+#define _LPM_TBL8_SIZE      256
+#define _LPM_RULES_MIN_SIZE 64
+
+static uint32_t _lpm_mask_ipv4(int32_t depth)
+{
+  return depth ? 0xFFFFFFFFu << (32 - depth) : 0;
+}
+
+static void _lpm_mask_ipv6(ipv6_addr_t* result, const ipv6_addr_t* addr, int32_t depth)
+{
+  int32_t i, bits;
+  for(i = 0; i < 16; ++i){
+    bits = depth - 8 * i;
+    result->bytes[i] = bits >= 8 ? addr->bytes[i] : bits <= 0 ? 0 : addr->bytes[i] & (0xFF << (8 - bits));
+  }
+}
+
+static uint32_t _lpm_rule_hash(uint8_t version, const ipv6_addr_t* prefix, int32_t depth)
+{
+  uint32_t h = 2166136261u;
+  int32_t i;
+  for(i = 0; i < 4; ++i){
+    h = (h ^ prefix->value[i]) * 16777619u;
+  }
+  h = (h ^ ((uint32_t) version << 8 | (uint32_t) depth)) * 16777619u;
+  return h ^ (h >> 15);
+}
+
+static lpmrule_t* _lpm_find_rule(lpm_t* this, uint8_t version, const ipv6_addr_t* prefix, int32_t depth)
+{
+  lpmrule_t* rule;
+  uint32_t index;
+  if(!this->rules){
+    return NULL;
+  }
+  index = _lpm_rule_hash(version, prefix, depth) & (this->rules_size - 1);
+  for(rule = &this->rules[index]; rule->version; rule = &this->rules[index]){
+    if(!rule->deleted && rule->version == version && rule->depth == depth &&
+       !memcmp(&rule->prefix, prefix, sizeof(ipv6_addr_t))){
+      return rule;
+    }
+    index = (index + 1) & (this->rules_size - 1);
+  }
+  return NULL;
+}
+
+static void _lpm_rehash_rules(lpm_t* this)
+{
+  lpmrule_t* old = this->rules;
+  lpmrule_t* rule;
+  int32_t old_size = this->rules_size;
+  int32_t i;
+  uint32_t index;
+
+  this->rules_size = _LPM_RULES_MIN_SIZE;
+  while(this->rules_size <= this->rules_num * 4){
+    this->rules_size <<= 1;
+  }
+  this->rules = calloc(this->rules_size, sizeof(lpmrule_t));
+  this->rules_used = this->rules_num;
+  for(i = 0; i < old_size; ++i){
+    if(!old[i].version || old[i].deleted){
+      continue;
+    }
+    index = _lpm_rule_hash(old[i].version, &old[i].prefix, old[i].depth) & (this->rules_size - 1);
+    for(rule = &this->rules[index]; rule->version; rule = &this->rules[index]){
+      index = (index + 1) & (this->rules_size - 1);
+    }
+    *rule = old[i];
+  }
+  free(old);
+}
+
+//returns BOOL_TRUE if the rule is new, otherwise only its nexthop is updated
+static bool_t _lpm_put_rule(lpm_t* this, uint8_t version, const ipv6_addr_t* prefix, int32_t depth, uint32_t nexthop)
+{
+  lpmrule_t* rule;
+  uint32_t index;
+
+  rule = _lpm_find_rule(this, version, prefix, depth);
+  if(rule){
+    rule->nexthop = nexthop;
+    return BOOL_FALSE;
+  }
+  if(this->rules_size < (this->rules_used + 1) * 2){
+    _lpm_rehash_rules(this);
+  }
+  index = _lpm_rule_hash(version, prefix, depth) & (this->rules_size - 1);
+  for(rule = &this->rules[index]; rule->version && !rule->deleted; rule = &this->rules[index]){
+    index = (index + 1) & (this->rules_size - 1);
+  }
+  if(!rule->version){
+    ++this->rules_used;
+  }
+  rule->prefix = *prefix;
+  rule->depth = depth;
+  rule->version = version;
+  rule->deleted = 0;
+  rule->nexthop = nexthop;
+  ++this->rules_num;
+  return BOOL_TRUE;
+}
+
+//overwrites the entries not covered by a longer prefix
+static void _lpm_fill(uint32_t* entries, int32_t num, uint32_t depth, uint32_t entry)
+{
+  int32_t i;
+  for(i = 0; i < num; ++i){
+    if(!(entries[i] & _LPM_VALID) || _LPM_DEPTH(entries[i]) <= depth){
+      entries[i] = entry;
+    }
+  }
+}
+
+//overwrites the entries set by the prefix of the given depth
+static void _lpm_replace(uint32_t* entries, int32_t num, uint32_t depth, uint32_t entry)
+{
+  int32_t i;
+  for(i = 0; i < num; ++i){
+    if((entries[i] & _LPM_VALID) && _LPM_DEPTH(entries[i]) == depth){
+      entries[i] = entry;
+    }
+  }
+}
+
+static int32_t _lpm_tbl8_alloc(lpm_t* this, uint32_t fill)
+{
+  int32_t group, i;
+  uint32_t* entries;
+  if(!this->tbl8_free_num){
+    return -1;
+  }
+  group = this->tbl8_free[--this->tbl8_free_num];
+  entries = &this->tbl8[group * _LPM_TBL8_SIZE];
+  for(i = 0; i < _LPM_TBL8_SIZE; ++i){
+    entries[i] = fill;
+  }
+  return group;
+}
+
+//gives the tbl8 group back if all of its entries come from the same prefix of at most 24 bits
+static void _lpm_tbl8_collapse(lpm_t* this, uint32_t index)
+{
+  int32_t group, i;
+  uint32_t* entries;
+  group = _LPM_NEXTHOP(this->tbl24[index]);
+  entries = &this->tbl8[group * _LPM_TBL8_SIZE];
+  if((entries[0] & _LPM_VALID) && 24 < _LPM_DEPTH(entries[0])){
+    return;
+  }
+  for(i = 1; i < _LPM_TBL8_SIZE; ++i){
+    if(entries[i] != entries[0]){
+      return;
+    }
+  }
+  this->tbl24[index] = entries[0];
+  this->tbl8_free[this->tbl8_free_num++] = group;
+}
+
+static void _lpm6node_dtor(lpm6node_t* node)
+{
+  int32_t i;
+  if(!node){
+    return;
+  }
+  for(i = 0; i < (1 << LPM_IPV6_STRIDE); ++i){
+    _lpm6node_dtor(node->children[i]);
+  }
+  free(node);
+}
+
+lpm_t* make_lpm(int32_t tbl8_groups)
+{
+  lpm_t* result;
+  int32_t i;
+  if(tbl8_groups <= 0){
+    tbl8_groups = LPM_DEFAULT_TBL8_GROUPS;
+  }
+  result = malloc(sizeof(lpm_t));
+  memset(result, 0, sizeof(lpm_t));
+  result->tbl24 = calloc(_LPM_TBL24_SIZE, sizeof(uint32_t));
+  result->tbl8 = calloc(tbl8_groups * _LPM_TBL8_SIZE, sizeof(uint32_t));
+  result->tbl8_free = malloc(tbl8_groups * sizeof(int32_t));
+  result->tbl8_groups = tbl8_groups;
+  for(i = 0; i < tbl8_groups; ++i){
+    result->tbl8_free[i] = tbl8_groups - i - 1;
+  }
+  result->tbl8_free_num = tbl8_groups;
+  result->root6 = calloc(1, sizeof(lpm6node_t));
+  return result;
+}
+
+void lpm_dtor(ptr_t target)
+{
+  lpm_t* this = target;
+  if(!this){
+    return;
+  }
+  free(this->tbl24);
+  free(this->tbl8);
+  free(this->tbl8_free);
+  free(this->rules);
+  _lpm6node_dtor(this->root6);
+  free(this);
+}
+
+int32_t lpm_add_ipv4(lpm_t* this, const ipaddr_t* prefix, int32_t depth, uint32_t nexthop)
+{
+  ipv6_addr_t key;
+  uint32_t ip, entry, index, last;
+  int32_t group;
+
+  if(depth < 0 || 32 < depth){
+    return LPM_ERROR_INVALID_DEPTH;
+  }
+  if(LPM_NEXTHOP_MAX < nexthop){
+    return LPM_ERROR_INVALID_NEXTHOP;
+  }
+  ip = ntohl(prefix->ipv4.value) & _lpm_mask_ipv4(depth);
+  entry = _LPM_ENTRY(depth, nexthop);
+  if(depth <= 24){
+    last = (ip >> 8) + (1u << (24 - depth));
+    for(index = ip >> 8; index < last; ++index){
+      if(this->tbl24[index] & _LPM_EXT){
+        group = _LPM_NEXTHOP(this->tbl24[index]);
+        _lpm_fill(&this->tbl8[group * _LPM_TBL8_SIZE], _LPM_TBL8_SIZE, depth, entry);
+      }else{
+        _lpm_fill(&this->tbl24[index], 1, depth, entry);
+      }
+    }
+  }else{
+    index = ip >> 8;
+    if(this->tbl24[index] & _LPM_EXT){
+      group = _LPM_NEXTHOP(this->tbl24[index]);
+    }else{
+      group = _lpm_tbl8_alloc(this, this->tbl24[index]);
+      if(group < 0){
+        return LPM_ERROR_NO_TBL8;
+      }
+      this->tbl24[index] = _LPM_VALID | _LPM_EXT | group;
+    }
+    _lpm_fill(&this->tbl8[group * _LPM_TBL8_SIZE + (ip & 0xFF)], 1 << (32 - depth), depth, entry);
+  }
+  memset(&key, 0, sizeof(ipv6_addr_t));
+  key.value[0] = ip;
+  _lpm_put_rule(this, 4, &key, depth, nexthop);
+  return 0;
+}
+
+int32_t lpm_del_ipv4(lpm_t* this, const ipaddr_t* prefix, int32_t depth)
+{
+  ipv6_addr_t key;
+  lpmrule_t* rule;
+  uint32_t ip, replace, index, last;
+  int32_t group, parent;
+
+  if(depth < 0 || 32 < depth){
+    return LPM_ERROR_INVALID_DEPTH;
+  }
+  ip = ntohl(prefix->ipv4.value) & _lpm_mask_ipv4(depth);
+  memset(&key, 0, sizeof(ipv6_addr_t));
+  key.value[0] = ip;
+  rule = _lpm_find_rule(this, 4, &key, depth);
+  if(!rule){
+    return LPM_ERROR_RULE_NOT_FOUND;
+  }
+  rule->deleted = 1;
+  --this->rules_num;
+
+  //the entries fall back to the longest prefix covering the deleted one
+  replace = 0;
+  for(parent = depth - 1; 0 <= parent; --parent){
+    key.value[0] = ip & _lpm_mask_ipv4(parent);
+    rule = _lpm_find_rule(this, 4, &key, parent);
+    if(rule){
+      replace = _LPM_ENTRY(parent, rule->nexthop);
+      break;
+    }
+  }
+
+  if(depth <= 24){
+    last = (ip >> 8) + (1u << (24 - depth));
+    for(index = ip >> 8; index < last; ++index){
+      if(this->tbl24[index] & _LPM_EXT){
+        group = _LPM_NEXTHOP(this->tbl24[index]);
+        _lpm_replace(&this->tbl8[group * _LPM_TBL8_SIZE], _LPM_TBL8_SIZE, depth, replace);
+        _lpm_tbl8_collapse(this, index);
+      }else{
+        _lpm_replace(&this->tbl24[index], 1, depth, replace);
+      }
+    }
+  }else{
+    index = ip >> 8;
+    group = _LPM_NEXTHOP(this->tbl24[index]);
+    _lpm_replace(&this->tbl8[group * _LPM_TBL8_SIZE + (ip & 0xFF)], 1 << (32 - depth), depth, replace);
+    _lpm_tbl8_collapse(this, index);
+  }
+  return 0;
+}
+
+uint32_t lpm_lookup_ipv4(lpm_t* this, const ipaddr_t* addr)
+{
+  uint32_t ip, entry;
+  ip = ntohl(addr->ipv4.value);
+  entry = this->tbl24[ip >> 8];
+  if(entry & _LPM_EXT){
+    entry = this->tbl8[_LPM_NEXTHOP(entry) * _LPM_TBL8_SIZE + (ip & 0xFF)];
+  }
+  return (entry & _LPM_VALID) ? _LPM_NEXTHOP(entry) : LPM_NO_NEXTHOP;
+}
+
+int32_t lpm_lookup_ipv4_batch(lpm_t* this, const ipaddr_t* addrs, uint32_t* nexthops, int32_t num)
+{
+  uint32_t ips[LPM_LOOKUP_BATCH], entries[LPM_LOOKUP_BATCH];
+  int32_t base, i, n, result = 0;
+
+  //the table reads of a batch are independent, so their cache misses overlap
+  for(base = 0; base < num; base += LPM_LOOKUP_BATCH){
+    n = MIN(LPM_LOOKUP_BATCH, num - base);
+    for(i = 0; i < n; ++i){
+      ips[i] = ntohl(addrs[base + i].ipv4.value);
+      entries[i] = this->tbl24[ips[i] >> 8];
+    }
+    for(i = 0; i < n; ++i){
+      if(entries[i] & _LPM_EXT){
+        entries[i] = this->tbl8[_LPM_NEXTHOP(entries[i]) * _LPM_TBL8_SIZE + (ips[i] & 0xFF)];
+      }
+    }
+    for(i = 0; i < n; ++i){
+      if(entries[i] & _LPM_VALID){
+        nexthops[base + i] = _LPM_NEXTHOP(entries[i]);
+        ++result;
+      }else{
+        nexthops[base + i] = LPM_NO_NEXTHOP;
+      }
+    }
+  }
+  return result;
+}
+
+//prefixes of depth in (8 * level, 8 * level + 8] end in a node of that level, the default route in the root
+static int32_t _lpm_ipv6_level(int32_t depth)
+{
+  return depth ? (depth - 1) / LPM_IPV6_STRIDE : 0;
+}
+
+int32_t lpm_add_ipv6(lpm_t* this, const ipaddr_t* prefix, int32_t depth, uint32_t nexthop)
+{
+  ipv6_addr_t key;
+  lpm6node_t* node;
+  int32_t level, i, rel;
+
+  if(depth < 0 || 128 < depth){
+    return LPM_ERROR_INVALID_DEPTH;
+  }
+  if(LPM_NEXTHOP_MAX < nexthop){
+    return LPM_ERROR_INVALID_NEXTHOP;
+  }
+  _lpm_mask_ipv6(&key, &prefix->ipv6, depth);
+  level = _lpm_ipv6_level(depth);
+  node = this->root6;
+  for(i = 0; i < level; ++i){
+    if(!node->children[key.bytes[i]]){
+      node->children[key.bytes[i]] = calloc(1, sizeof(lpm6node_t));
+      ++node->refs;
+    }
+    node = node->children[key.bytes[i]];
+  }
+  rel = depth - level * LPM_IPV6_STRIDE;
+  _lpm_fill(&node->entries[key.bytes[level]], 1 << (LPM_IPV6_STRIDE - rel), rel, _LPM_ENTRY(rel, nexthop));
+  if(_lpm_put_rule(this, 6, &key, depth, nexthop)){
+    ++node->refs;
+  }
+  return 0;
+}
+
+int32_t lpm_del_ipv6(lpm_t* this, const ipaddr_t* prefix, int32_t depth)
+{
+  ipv6_addr_t key, parent_key;
+  lpm6node_t* path[LPM_IPV6_LEVELS];
+  lpmrule_t* rule;
+  uint32_t replace;
+  int32_t level, i, rel, parent;
+
+  if(depth < 0 || 128 < depth){
+    return LPM_ERROR_INVALID_DEPTH;
+  }
+  _lpm_mask_ipv6(&key, &prefix->ipv6, depth);
+  rule = _lpm_find_rule(this, 6, &key, depth);
+  if(!rule){
+    return LPM_ERROR_RULE_NOT_FOUND;
+  }
+  rule->deleted = 1;
+  --this->rules_num;
+
+  level = _lpm_ipv6_level(depth);
+  path[0] = this->root6;
+  for(i = 0; i < level; ++i){
+    path[i + 1] = path[i]->children[key.bytes[i]];
+  }
+
+  //only the covering prefixes ending in the same node are stored in its entries
+  replace = 0;
+  for(parent = depth - 1; level * LPM_IPV6_STRIDE < parent || (parent == 0 && level == 0); --parent){
+    _lpm_mask_ipv6(&parent_key, &key, parent);
+    rule = _lpm_find_rule(this, 6, &parent_key, parent);
+    if(rule){
+      replace = _LPM_ENTRY(parent - level * LPM_IPV6_STRIDE, rule->nexthop);
+      break;
+    }
+  }
+  rel = depth - level * LPM_IPV6_STRIDE;
+  _lpm_replace(&path[level]->entries[key.bytes[level]], 1 << (LPM_IPV6_STRIDE - rel), rel, replace);
+
+  //release the nodes left without prefixes and children
+  --path[level]->refs;
+  for(i = level; 0 < i && !path[i]->refs; --i){
+    free(path[i]);
+    path[i - 1]->children[key.bytes[i - 1]] = NULL;
+    --path[i - 1]->refs;
+  }
+  return 0;
+}
+
+uint32_t lpm_lookup_ipv6(lpm_t* this, const ipaddr_t* addr)
+{
+  lpm6node_t* node;
+  uint32_t result = LPM_NO_NEXTHOP;
+  int32_t i;
+  for(i = 0, node = this->root6; node && i < LPM_IPV6_LEVELS; ++i){
+    if(node->entries[addr->ipv6.bytes[i]] & _LPM_VALID){
+      result = _LPM_NEXTHOP(node->entries[addr->ipv6.bytes[i]]);
+    }
+    node = node->children[addr->ipv6.bytes[i]];
+  }
+  return result;
+}
+
+int32_t lpm_lookup_ipv6_batch(lpm_t* this, const ipaddr_t* addrs, uint32_t* nexthops, int32_t num)
+{
+  lpm6node_t* nodes[LPM_LOOKUP_BATCH];
+  uint32_t entry;
+  uint8_t byte;
+  int32_t base, i, n, level, active, result = 0;
+
+  //walks the trie with a batch of addresses level by level to overlap the node reads
+  for(base = 0; base < num; base += LPM_LOOKUP_BATCH){
+    n = MIN(LPM_LOOKUP_BATCH, num - base);
+    for(i = 0; i < n; ++i){
+      nodes[i] = this->root6;
+      nexthops[base + i] = LPM_NO_NEXTHOP;
+    }
+    for(level = 0, active = n; active && level < LPM_IPV6_LEVELS; ++level){
+      for(i = 0, active = 0; i < n; ++i){
+        if(!nodes[i]){
+          continue;
+        }
+        byte = addrs[base + i].ipv6.bytes[level];
+        entry = nodes[i]->entries[byte];
+        if(entry & _LPM_VALID){
+          nexthops[base + i] = _LPM_NEXTHOP(entry);
+        }
+        nodes[i] = nodes[i]->children[byte];
+        active += nodes[i] != NULL;
+      }
+    }
+    for(i = 0; i < n; ++i){
+      result += nexthops[base + i] != LPM_NO_NEXTHOP;
+    }
+  }
+  return result;
+}
+
+int32_t lpm_get_rules_num(lpm_t* this)
+{
+  return this->rules_num;
+}
+
+static ipaddr_t _lpm_test_ipv4(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+  ipaddr_t result;
+  memset(&result, 0, sizeof(ipaddr_t));
+  result.ipv4.bytes[0] = a;
+  result.ipv4.bytes[1] = b;
+  result.ipv4.bytes[2] = c;
+  result.ipv4.bytes[3] = d;
+  return result;
+}
+
+static ipaddr_t _lpm_test_ipv6(uint16_t first, uint16_t second, uint8_t byte4, uint8_t last)
+{
+  ipaddr_t result;
+  memset(&result, 0, sizeof(ipaddr_t));
+  result.ipv6.bytes[0] = first >> 8;
+  result.ipv6.bytes[1] = first & 0xFF;
+  result.ipv6.bytes[2] = second >> 8;
+  result.ipv6.bytes[3] = second & 0xFF;
+  result.ipv6.bytes[4] = byte4;
+  result.ipv6.bytes[15] = last;
+  return result;
+}
+
+//checks the prefixes at the 24 bit and tbl8 boundaries, the IPv6 stride
+//boundaries, the fallback on delete and running out of tbl8 groups
+void lpm_test(void)
+{
+  lpm_t* lpm;
+  ipaddr_t addr, addrs[LPM_LOOKUP_BATCH + 3];
+  uint32_t nexthops[LPM_LOOKUP_BATCH + 3];
+  int32_t i, failed = 0;
+
+  lpm = make_lpm(1);
+  addr = _lpm_test_ipv4(10, 1, 2, 3);
+  failed += lpm_lookup_ipv4(lpm, &addr) != LPM_NO_NEXTHOP;
+  failed += lpm_add_ipv4(lpm, &addr, 33, 1) != LPM_ERROR_INVALID_DEPTH;
+  failed += lpm_add_ipv4(lpm, &addr, 24, LPM_NEXTHOP_MAX + 1) != LPM_ERROR_INVALID_NEXTHOP;
+  failed += lpm_del_ipv4(lpm, &addr, 24) != LPM_ERROR_RULE_NOT_FOUND;
+
+  addr = _lpm_test_ipv4(0, 0, 0, 0);
+  lpm_add_ipv4(lpm, &addr, 0, 1);
+  addr = _lpm_test_ipv4(10, 0, 0, 0);
+  lpm_add_ipv4(lpm, &addr, 8, 2);
+  addr = _lpm_test_ipv4(10, 1, 2, 0);
+  lpm_add_ipv4(lpm, &addr, 24, 3);
+  addr = _lpm_test_ipv4(10, 1, 2, 128);
+  failed += lpm_add_ipv4(lpm, &addr, 25, 4) != 0;
+  addr = _lpm_test_ipv4(10, 1, 2, 255);
+  lpm_add_ipv4(lpm, &addr, 32, 5);
+  //the only tbl8 group is used by 10.1.2.0/24
+  addr = _lpm_test_ipv4(10, 1, 3, 0);
+  failed += lpm_add_ipv4(lpm, &addr, 25, 6) != LPM_ERROR_NO_TBL8;
+
+  addr = _lpm_test_ipv4(9, 255, 255, 255);
+  failed += lpm_lookup_ipv4(lpm, &addr) != 1;
+  addr = _lpm_test_ipv4(10, 0, 0, 0);
+  failed += lpm_lookup_ipv4(lpm, &addr) != 2;
+  addr = _lpm_test_ipv4(10, 1, 1, 255);
+  failed += lpm_lookup_ipv4(lpm, &addr) != 2;
+  addr = _lpm_test_ipv4(10, 1, 2, 0);
+  failed += lpm_lookup_ipv4(lpm, &addr) != 3;
+  addr = _lpm_test_ipv4(10, 1, 2, 127);
+  failed += lpm_lookup_ipv4(lpm, &addr) != 3;
+  addr = _lpm_test_ipv4(10, 1, 2, 128);
+  failed += lpm_lookup_ipv4(lpm, &addr) != 4;
+  addr = _lpm_test_ipv4(10, 1, 2, 254);
+  failed += lpm_lookup_ipv4(lpm, &addr) != 4;
+  addr = _lpm_test_ipv4(10, 1, 2, 255);
+  failed += lpm_lookup_ipv4(lpm, &addr) != 5;
+  addr = _lpm_test_ipv4(10, 1, 3, 0);
+  failed += lpm_lookup_ipv4(lpm, &addr) != 2;
+  addr = _lpm_test_ipv4(11, 0, 0, 0);
+  failed += lpm_lookup_ipv4(lpm, &addr) != 1;
+  failed += lpm_get_rules_num(lpm) != 5;
+
+  for(i = 0; i < LPM_LOOKUP_BATCH + 3; ++i){
+    addrs[i] = _lpm_test_ipv4(10, 1, 2, 120 + i);
+  }
+  failed += lpm_lookup_ipv4_batch(lpm, addrs, nexthops, LPM_LOOKUP_BATCH + 3) != LPM_LOOKUP_BATCH + 3;
+  for(i = 0; i < LPM_LOOKUP_BATCH + 3; ++i){
+    failed += nexthops[i] != lpm_lookup_ipv4(lpm, &addrs[i]);
+  }
+
+  //the deleted prefixes fall back to the covering ones, the emptied tbl8 group is given back
+  addr = _lpm_test_ipv4(10, 1, 2, 128);
+  lpm_del_ipv4(lpm, &addr, 25);
+  addr = _lpm_test_ipv4(10, 1, 2, 200);
+  failed += lpm_lookup_ipv4(lpm, &addr) != 3;
+  addr = _lpm_test_ipv4(10, 1, 2, 255);
+  lpm_del_ipv4(lpm, &addr, 32);
+  failed += lpm_lookup_ipv4(lpm, &addr) != 3;
+  failed += lpm->tbl8_free_num != 1;
+  addr = _lpm_test_ipv4(10, 1, 2, 0);
+  lpm_del_ipv4(lpm, &addr, 24);
+  failed += lpm_lookup_ipv4(lpm, &addr) != 2;
+  addr = _lpm_test_ipv4(10, 1, 3, 0);
+  failed += lpm_add_ipv4(lpm, &addr, 25, 6) != 0;
+
+  //IPv6 prefixes ending at and right after a stride boundary
+  addr = _lpm_test_ipv6(0x2001, 0x0db8, 0, 1);
+  failed += lpm_lookup_ipv6(lpm, &addr) != LPM_NO_NEXTHOP;
+  failed += lpm_add_ipv6(lpm, &addr, 129, 1) != LPM_ERROR_INVALID_DEPTH;
+  lpm_add_ipv6(lpm, &addr, 0, 10);
+  lpm_add_ipv6(lpm, &addr, 32, 11);
+  lpm_add_ipv6(lpm, &addr, 33, 12);
+  lpm_add_ipv6(lpm, &addr, 128, 13);
+  failed += lpm_lookup_ipv6(lpm, &addr) != 13;
+  addr = _lpm_test_ipv6(0x2001, 0x0db8, 0x7F, 0);
+  failed += lpm_lookup_ipv6(lpm, &addr) != 12;
+  addr = _lpm_test_ipv6(0x2001, 0x0db8, 0x80, 0);
+  failed += lpm_lookup_ipv6(lpm, &addr) != 11;
+  addr = _lpm_test_ipv6(0x2001, 0x0db9, 0, 0);
+  failed += lpm_lookup_ipv6(lpm, &addr) != 10;
+  for(i = 0; i < LPM_LOOKUP_BATCH + 3; ++i){
+    addrs[i] = _lpm_test_ipv6(0x2001, 0x0db8, 0x7C + i, 1);
+  }
+  failed += lpm_lookup_ipv6_batch(lpm, addrs, nexthops, LPM_LOOKUP_BATCH + 3) != LPM_LOOKUP_BATCH + 3;
+  for(i = 0; i < LPM_LOOKUP_BATCH + 3; ++i){
+    failed += nexthops[i] != lpm_lookup_ipv6(lpm, &addrs[i]);
+  }
+  addr = _lpm_test_ipv6(0x2001, 0x0db8, 0, 1);
+  lpm_del_ipv6(lpm, &addr, 128);
+  failed += lpm_lookup_ipv6(lpm, &addr) != 12;
+  lpm_del_ipv6(lpm, &addr, 33);
+  failed += lpm_lookup_ipv6(lpm, &addr) != 11;
+  lpm_del_ipv6(lpm, &addr, 32);
+  failed += lpm_lookup_ipv6(lpm, &addr) != 10;
+  failed += lpm_del_ipv6(lpm, &addr, 32) != LPM_ERROR_RULE_NOT_FOUND;
+  for(i = 0; i < (1 << LPM_IPV6_STRIDE); ++i){
+    failed += lpm->root6->children[i] != NULL;
+  }
+
+  lpm_dtor(lpm);
+  printf("lpm_test: %s\n", failed ? "FAILED" : "passed");
+}
@@ -0,0 +1,65 @@
+#ifndef INCGUARD_NTRT_LIBRARY_LPM_H_
+#define INCGUARD_NTRT_LIBRARY_LPM_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "lib_defs.h"
+
+#define LPM_ERROR_INVALID_DEPTH   -1
+#define LPM_ERROR_INVALID_NEXTHOP -2
+#define LPM_ERROR_NO_TBL8         -3
+#define LPM_ERROR_RULE_NOT_FOUND  -4
+
+#define LPM_NEXTHOP_MAX           0x00FFFFFF   ///< nexthops are stored on 24 bits
+#define LPM_NO_NEXTHOP            0xFFFFFFFF   ///< lookup result if no prefix matches
+#define LPM_DEFAULT_TBL8_GROUPS   256
+#define LPM_LOOKUP_BATCH          8            ///< addresses resolved together by the batch lookups
+
+#define LPM_IPV6_STRIDE           8
+#define LPM_IPV6_LEVELS           (128 / LPM_IPV6_STRIDE)
+
+//a stored prefix, needed to restore covering prefixes on delete
+typedef struct _lpmrule {
+  ipv6_addr_t prefix;                ///< masked prefix, IPv4 ones are kept host ordered in value[0]
+  uint8_t     depth;
+  uint8_t     version;               ///< 4 or 6, 0 marks an empty slot
+  uint8_t     deleted;
+  uint32_t    nexthop;
+} lpmrule_t;
+
+//a node of the IPv6 multibit trie covering LPM_IPV6_STRIDE bits of the address
+typedef struct _lpm6node {
+  uint32_t           entries[1 << LPM_IPV6_STRIDE];   ///< prefixes ending in this node
+  struct _lpm6node*  children[1 << LPM_IPV6_STRIDE];
+  int32_t            refs;                            ///< entries set plus children allocated
+} lpm6node_t;
+
+typedef struct _lpm {
+  uint32_t*    tbl24;           ///< IPv4 entries indexed by the first 24 bits
+  uint32_t*    tbl8;            ///< IPv4 entries for prefixes longer than 24 bits, in groups of 256
+  int32_t*     tbl8_free;       ///< stack of unused tbl8 groups
+  int32_t      tbl8_free_num;
+  int32_t      tbl8_groups;
+  lpm6node_t*  root6;
+  lpmrule_t*   rules;           ///< open addressed table of the added prefixes
+  int32_t      rules_size;
+  int32_t      rules_used;      ///< slots used or deleted
+  int32_t      rules_num;
+} lpm_t;
+
+lpm_t* make_lpm(int32_t tbl8_groups);
+void lpm_dtor(ptr_t target);
+int32_t lpm_add_ipv4(lpm_t* this, const ipaddr_t* prefix, int32_t depth, uint32_t nexthop);
+int32_t lpm_del_ipv4(lpm_t* this, const ipaddr_t* prefix, int32_t depth);
+uint32_t lpm_lookup_ipv4(lpm_t* this, const ipaddr_t* addr);
+int32_t lpm_lookup_ipv4_batch(lpm_t* this, const ipaddr_t* addrs, uint32_t* nexthops, int32_t num);
+int32_t lpm_add_ipv6(lpm_t* this, const ipaddr_t* prefix, int32_t depth, uint32_t nexthop);
+int32_t lpm_del_ipv6(lpm_t* this, const ipaddr_t* prefix, int32_t depth);
+uint32_t lpm_lookup_ipv6(lpm_t* this, const ipaddr_t* addr);
+int32_t lpm_lookup_ipv6_batch(lpm_t* this, const ipaddr_t* addrs, uint32_t* nexthops, int32_t num);
+int32_t lpm_get_rules_num(lpm_t* this);
+void lpm_test(void);
+
+#endif /* INCGUARD_NTRT_LIBRARY_LPM_H_ */
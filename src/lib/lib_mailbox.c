@@ -0,0 +1,213 @@
+#include "lib_mailbox.h"
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+//Every cell carries a sequence number: a cell at position pos can be posted
+//into if its sequence is pos and fetched from if it is pos + 1. The fetcher
+//hands it over to the post of the next round by setting it to pos + size.
+
+mailbox_t* make_mailbox(int32_t size)
+{
+  mailbox_t* result;
+  uint64_t capacity, index;
+  for(capacity = 2; capacity < (uint64_t) size; capacity <<= 1);
+  result = (mailbox_t*) malloc(sizeof(mailbox_t));
+  memset(result, 0, sizeof(mailbox_t));
+  result->cells = (mailboxcell_t*) malloc(sizeof(mailboxcell_t) * capacity);
+  for(index = 0; index < capacity; ++index){
+    result->cells[index].sequence = index;
+    result->cells[index].item = NULL;
+  }
+  result->mask = capacity - 1;
+  return result;
+}
+
+void mailbox_dtor(ptr_t target)
+{
+  mailbox_t* this = (mailbox_t*) target;
+  if(this == NULL){
+    return;
+  }
+  free(this->cells);
+  free(this);
+}
+
+//returns BOOL_FALSE if the mailbox is full, NULL can not be posted
+bool_t mailbox_post(mailbox_t* this, ptr_t item)
+{
+  mailboxcell_t* cell;
+  uint64_t pos, sequence;
+  int64_t diff;
+  assert(item != NULL);
+  pos = __atomic_load_n(&this->post_pos, __ATOMIC_RELAXED);
+  for(;;){
+    cell = &this->cells[pos & this->mask];
+    sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+    diff = (int64_t) sequence - (int64_t) pos;
+    if(diff == 0){
+      if(__atomic_compare_exchange_n(&this->post_pos, &pos, pos + 1, BOOL_TRUE,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+        break;
+      }
+    }else if(diff < 0){
+      return BOOL_FALSE;
+    }else{
+      pos = __atomic_load_n(&this->post_pos, __ATOMIC_RELAXED);
+    }
+  }
+  cell->item = item;
+  __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+  return BOOL_TRUE;
+}
+
+//returns NULL if the mailbox is empty
+ptr_t mailbox_fetch(mailbox_t* this)
+{
+  mailboxcell_t* cell;
+  uint64_t pos, sequence;
+  int64_t diff;
+  ptr_t result;
+  pos = __atomic_load_n(&this->fetch_pos, __ATOMIC_RELAXED);
+  for(;;){
+    cell = &this->cells[pos & this->mask];
+    sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+    diff = (int64_t) sequence - (int64_t) (pos + 1);
+    if(diff == 0){
+      if(__atomic_compare_exchange_n(&this->fetch_pos, &pos, pos + 1, BOOL_TRUE,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+        break;
+      }
+    }else if(diff < 0){
+      return NULL;
+    }else{
+      pos = __atomic_load_n(&this->fetch_pos, __ATOMIC_RELAXED);
+    }
+  }
+  result = cell->item;
+  __atomic_store_n(&cell->sequence, pos + this->mask + 1, __ATOMIC_RELEASE);
+  return result;
+}
+
+//fetches at most max items, returns the number of items fetched
+int32_t mailbox_fetch_batch(mailbox_t* this, ptr_t* items, int32_t max)
+{
+  int32_t result;
+  for(result = 0; result < max; ++result){
+    items[result] = mailbox_fetch(this);
+    if(items[result] == NULL){
+      break;
+    }
+  }
+  return result;
+}
+
+//BOOL_TRUE if nothing is ready to be fetched, a post in progress is not counted
+bool_t mailbox_is_empty(mailbox_t* this)
+{
+  uint64_t pos, sequence;
+  pos = __atomic_load_n(&this->fetch_pos, __ATOMIC_ACQUIRE);
+  sequence = __atomic_load_n(&this->cells[pos & this->mask].sequence, __ATOMIC_ACQUIRE);
+  return sequence != pos + 1 ? BOOL_TRUE : BOOL_FALSE;
+}
+
+int32_t mailbox_get_size(mailbox_t* this)
+{
+  return (int32_t) (this->mask + 1);
+}
+
+#define MAILBOX_TEST_THREADS   4
+#define MAILBOX_TEST_ITEMS     10000
+
+static mailbox_t* _mailbox_test_box;
+static volatile int64_t _mailbox_test_fetched_sum;
+static volatile int32_t _mailbox_test_fetched_num;
+
+//posts the numbers 1..MAILBOX_TEST_ITEMS, retrying while the mailbox is full
+static void* _mailbox_test_poster(void* arg __attribute__((unused)))
+{
+  intptr_t item;
+  for(item = 1; item <= MAILBOX_TEST_ITEMS; ++item){
+    while(!mailbox_post(_mailbox_test_box, (ptr_t) item)){
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static void* _mailbox_test_fetcher(void* arg __attribute__((unused)))
+{
+  ptr_t item;
+  while(__atomic_load_n(&_mailbox_test_fetched_num, __ATOMIC_RELAXED) < MAILBOX_TEST_THREADS * MAILBOX_TEST_ITEMS){
+    item = mailbox_fetch(_mailbox_test_box);
+    if(item != NULL){
+      __atomic_add_fetch(&_mailbox_test_fetched_sum, (intptr_t) item, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&_mailbox_test_fetched_num, 1, __ATOMIC_RELAXED);
+    }else{
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+void mailbox_test(void)
+{
+  mailbox_t* mailbox;
+  ptr_t      items[16];
+  pthread_t  threads[2 * MAILBOX_TEST_THREADS];
+  intptr_t   item, next;
+  int32_t    failed = 0, round, index;
+
+  //the size is rounded up to a power of two
+  mailbox = make_mailbox(5);
+  failed += mailbox_get_size(mailbox) != 8;
+  mailbox_dtor(mailbox);
+
+  mailbox = make_mailbox(8);
+  failed += mailbox_get_size(mailbox) != 8;
+  failed += !mailbox_is_empty(mailbox);
+  failed += mailbox_fetch(mailbox) != NULL;
+  failed += mailbox_fetch_batch(mailbox, items, 16) != 0;
+
+  //empty and full in every round, the positions wrap the ring many times
+  next = 1;
+  for(round = 0; round < 10; ++round){
+    for(item = next; item < next + 8; ++item){
+      failed += !mailbox_post(mailbox, (ptr_t) item);
+    }
+    failed += mailbox_post(mailbox, (ptr_t) item);
+    failed += mailbox_is_empty(mailbox);
+    failed += mailbox_fetch(mailbox) != (ptr_t) next;
+    failed += !mailbox_post(mailbox, (ptr_t) item);
+    failed += mailbox_post(mailbox, (ptr_t) (item + 1));
+    failed += mailbox_fetch_batch(mailbox, items, 3) != 3;
+    for(index = 0; index < 3; ++index){
+      failed += items[index] != (ptr_t) (next + 1 + index);
+    }
+    failed += mailbox_fetch_batch(mailbox, items, 16) != 5;
+    for(index = 0; index < 5; ++index){
+      failed += items[index] != (ptr_t) (next + 4 + index);
+    }
+    failed += !mailbox_is_empty(mailbox);
+    failed += mailbox_fetch(mailbox) != NULL;
+    next = item + 1;
+  }
+  mailbox_dtor(mailbox);
+
+  //every posted item is fetched exactly once by concurrent posters and fetchers
+  _mailbox_test_box = make_mailbox(64);
+  _mailbox_test_fetched_sum = 0;
+  _mailbox_test_fetched_num = 0;
+  for(index = 0; index < MAILBOX_TEST_THREADS; ++index){
+    pthread_create(&threads[index], NULL, _mailbox_test_poster, NULL);
+    pthread_create(&threads[MAILBOX_TEST_THREADS + index], NULL, _mailbox_test_fetcher, NULL);
+  }
+  for(index = 0; index < 2 * MAILBOX_TEST_THREADS; ++index){
+    pthread_join(threads[index], NULL);
+  }
+  failed += _mailbox_test_fetched_sum != (int64_t) MAILBOX_TEST_THREADS * MAILBOX_TEST_ITEMS * (MAILBOX_TEST_ITEMS + 1) / 2;
+  failed += !mailbox_is_empty(_mailbox_test_box);
+  mailbox_dtor(_mailbox_test_box);
+
+  printf("mailbox_test: %s\n", failed ? "FAILED" : "passed");
+}
@@ -0,0 +1,38 @@
+#ifndef INCGUARD_NTRT_LIBRARY_MAILBOX_H_
+#define INCGUARD_NTRT_LIBRARY_MAILBOX_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "lib_defs.h"
+
+#define MAILBOX_DEFAULT_SIZE   256
+
+//a slot of the ring, its sequence tells whose turn it is to use it
+typedef struct _mailboxcell {
+  volatile uint64_t  sequence;
+  ptr_t              item;
+} mailboxcell_t;
+
+//Bounded lock-free queue of pointers, any number of threads may post and fetch.
+typedef struct _mailbox {
+  mailboxcell_t*     cells;
+  uint64_t           mask;
+  char               padding0[64 - sizeof(mailboxcell_t*) - sizeof(uint64_t)];
+  volatile uint64_t  post_pos;
+  char               padding1[64 - sizeof(uint64_t)];
+  volatile uint64_t  fetch_pos;
+  char               padding2[64 - sizeof(uint64_t)];
+} mailbox_t;
+
+mailbox_t* make_mailbox(int32_t size);
+void mailbox_dtor(ptr_t target);
+bool_t mailbox_post(mailbox_t* this, ptr_t item);
+ptr_t mailbox_fetch(mailbox_t* this);
+int32_t mailbox_fetch_batch(mailbox_t* this, ptr_t* items, int32_t max);
+bool_t mailbox_is_empty(mailbox_t* this);
+int32_t mailbox_get_size(mailbox_t* this);
+void mailbox_test(void);
+
+#endif /* INCGUARD_NTRT_LIBRARY_MAILBOX_H_ */
@@ -8,7 +8,9 @@
 #include "lib_makers.h"
 #include "lib_tors.h"
 #include "lib_threading.h"
+#include "lib_fiber.h"
 #include "dmap.h"
+#include <strings.h>
 
 callback_t* make_callback(void (*action)(), 
 						  void (*parameterized_action)(void*), 
@@ -82,6 +84,52 @@ thread_t* make_thread(void *(*process)(void*), void *arg)
 	return result;
 }
 
+thread_t* make_configured_thread(void *(*process)(void*), void *arg, const char_t *name)
+{
+	thread_t*       result;
+	const sysdat_t* sysdat;
+	int32_t         index;
+	result = make_thread(process, arg);
+	ebr_enter();
+	sysdat = dmap_get_sysdat();
+	for(index = 0; index < sysdat->threadconfs_num; ++index){
+		if(strcasecmp(sysdat->threadconfs[index].name, name) == 0){
+			result->attrs = sysdat->threadconfs[index].attrs;
+			break;
+		}
+	}
+	ebr_leave();
+	return result;
+}
+
+executor_t* make_executor(int32_t workers_num)
+{
+	executor_t* result;
+	int32_t index;
+	result = executor_ctor(workers_num);
+	for(index = 0; index < result->workers_num; ++index){
+		result->workers[index] = make_thread(executor_worker_process, result);
+	}
+	for(index = 0; index < result->workers_num; ++index){
+		start_thread(result->workers[index]);
+	}
+	return result;
+}
+
+fibersched_t* make_fibersched(int32_t workers_num, size_t stack_size)
+{
+	fibersched_t* result;
+	int32_t index;
+	result = fibersched_ctor(workers_num, stack_size);
+	for(index = 0; index < result->workers_num; ++index){
+		result->workers[index].thread = make_thread(fibersched_worker_process, result);
+	}
+	for(index = 0; index < result->workers_num; ++index){
+		start_thread(result->workers[index].thread);
+	}
+	return result;
+}
+
 barrier_t *make_barrier(int32_t gatenum)
 {
 	barrier_t* result;
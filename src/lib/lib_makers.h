@@ -9,6 +9,7 @@
 #define INCGUARD_NTRT_LIBRARY_MAKERS_H_
 #include "lib_defs.h"
 #include "lib_descs.h"
+#include "lib_fiber.h"
 #include "inc_predefs.h"
 
 
@@ -87,11 +88,36 @@ string_t* make_string(char_t* characters);
   */
 thread_t *make_thread(void *(*method)(void*), void *arg);
 
+/** \fn thread_t* make_configured_thread(void *(*method)(void*), void *arg, const char_t *name)
+     \brief make a thread like make_thread and apply the [thread_<name>] section of the configuration on it
+	 \param method Pointing to the entry point of the thread
+	 \param arg Pointing to the argument
+	 \param name The name the thread is configured by
+	 \return Returns a thread
+  */
+thread_t *make_configured_thread(void *(*method)(void*), void *arg, const char_t *name);
+
+/** \fn executor_t* make_executor(int32_t workers_num)
+     \brief make an executor and start its worker threads, which are registered into dmap_table_thr
+	 \param workers_num The number of workers, the number of the online cores if it is less than 1
+	 \return Returns an executor with running workers
+  */
+executor_t *make_executor(int32_t workers_num);
+
+/** \fn fibersched_t* make_fibersched(int32_t workers_num, size_t stack_size)
+     \brief make a fiber scheduler and start its worker threads, which are registered into dmap_table_thr
+	 \param workers_num The number of workers, the number of the online cores if it is less than 1
+	 \param stack_size The stack size of the fibers, FIBER_DEFAULT_STACK_SIZE if it is 0
+	 \return Returns a fiber scheduler with running workers
+  */
+fibersched_t *make_fibersched(int32_t workers_num, size_t stack_size);
+
 barrier_t *make_barrier(int32_t gatenum);
 
 eventer_arg_t *make_eventer_arg(int32_t event, void *arg);
 
 
+datchain_t* make_datchain(ptr_t item);
 slist_t* make_slist(ptr_t item);
 dlist_t* make_dlist(ptr_t item);
 
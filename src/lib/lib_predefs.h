@@ -23,11 +23,53 @@ bool_t func_with_param_return_true(void *param);
 	static void* THR_PROC_NAME(void *arg) 			\
 	{												\
 		thread_t *thread = (thread_t*) arg;         \
+		ebr_thread_register();						\
+		arena_thread_init();						\
 		THR_INIT_PROC_NAME(thread);					\
-		thread->state = THREAD_STATE_RUN;			\
+		__sync_bool_compare_and_swap(				\
+			&thread->state,							\
+			THREAD_STATE_STARTED,					\
+			THREAD_STATE_RUN);						\
 		THR_MAIN_PROC_NAME(thread);					\
 		thread->state = THREAD_STATE_STOPPED;		\
 		THR_DEINIT_PROC_NAME(thread);				\
+		arena_thread_deinit();						\
+		ebr_thread_unregister();					\
+		return NULL;								\
+	}												\
+
+
+//Runs the main procedure once per task, the task is scheduled
+//again by the executor until the thread is asked to stop.
+#define LIB_DEF_TASK( 								\
+					   TSK_PROC_NAME,  				\
+					   THR_INIT_PROC_NAME, 			\
+					   THR_MAIN_PROC_NAME, 			\
+					   THR_DEINIT_PROC_NAME 		\
+					  ) 							\
+	static void* TSK_PROC_NAME(void *arg) 			\
+	{												\
+		thread_t *thread = (thread_t*) arg;         \
+		if(!thread->initialized &&					\
+		   thread->state == THREAD_STATE_STARTED){	\
+			THR_INIT_PROC_NAME(thread);				\
+			thread->initialized = BOOL_TRUE;		\
+			__sync_bool_compare_and_swap(			\
+				&thread->state,						\
+				THREAD_STATE_STARTED,				\
+				THREAD_STATE_RUN);					\
+		}											\
+		if(thread->state == THREAD_STATE_RUN){		\
+			THR_MAIN_PROC_NAME(thread);				\
+		}											\
+		if(thread->state != THREAD_STATE_STOP){		\
+			return arg;								\
+		}											\
+		if(thread->initialized){					\
+			THR_DEINIT_PROC_NAME(thread);			\
+			thread->initialized = BOOL_FALSE;		\
+		}											\
+		thread->state = THREAD_STATE_STOPPED;		\
 		return NULL;								\
 	}												\
 
@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include "lib_defs.h"
 #include "lib_descs.h"
+#include "lib_tors.h"
 #include <stdarg.h>
 
 
@@ -401,7 +402,7 @@ void slidingwindow_dtor(ptr_t target)
   if(this->storage){
     swstorage_disposer(this->storage);
   }
-  slist_dtor(this->plugins, swplugin_dtor);
+  slist_dtor(this->plugins.first, swplugin_dtor);
   free(this);
 }
 
@@ -411,7 +412,7 @@ static void _slidingwindow_rem(slidingwindow_t* this)
   slist_t* it;
   item = datapuffer_read(this->trackeditems);
 
-  for(it = this->plugins; it; it = it->next){
+  for(it = this->plugins.first; it; it = it->next){
       swplugin_t *swplugin;
       swplugin = it->data;
       if(swplugin->rem_pipe){
@@ -487,7 +488,7 @@ void slidingwindow_add_data(slidingwindow_t* this, ptr_t data)
 
   datapuffer_write(this->trackeditems, item);
 
-  for(it = this->plugins; it; it = it->next){
+  for(it = this->plugins.first; it; it = it->next){
       swplugin_t *swplugin;
       swplugin = it->data;
       if(swplugin->add_pipe){
@@ -498,7 +499,7 @@ void slidingwindow_add_data(slidingwindow_t* this, ptr_t data)
 
 void slidingwindow_add_plugin(slidingwindow_t* this, swplugin_t *swplugin)
 {
-  this->plugins = slist_append(this->plugins, swplugin);
+  slisthead_append(&this->plugins, swplugin);
 }
 
 
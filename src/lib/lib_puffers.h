@@ -49,7 +49,7 @@ typedef struct swstorage_struct_t{
 typedef struct slidingwindow_struct_t{
   datapuffer_t  *recycle;
   datapuffer_t  *trackeditems;
-  slist_t       *plugins;
+  slisthead_t    plugins;
   swstorage_t   *storage;
   int32_t        num_limit;
   double         time_limit;
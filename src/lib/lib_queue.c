@@ -1,6 +1,59 @@
 #include "lib_queue.h"
 #include "lib_puffers.h"
 #include "inc_mtime.h"
+#include <stdint.h>
+
+//pushes and pops over the block boundaries on both ends,
+//the order has to be kept and the emptied blocks recycled
+static int32_t _queue_blocks_test(void)
+{
+  queue_t* queue;
+  int32_t i, failed = 0;
+  intptr_t value;
+
+  queue = make_queue(NULL);
+  if(queue_pop_head(queue) != NULL || queue_pop_tail(queue) != NULL || queue_peek_head(queue) != NULL){
+    ++failed;
+  }
+  //FIFO through three blocks from the tail
+  for(i = 1; i <= 3 * QUEUE_BLOCK_SIZE; ++i){
+    queue_push_tail(queue, (ptr_t) (intptr_t) i);
+  }
+  for(i = 1; i <= 3 * QUEUE_BLOCK_SIZE; ++i){
+    value = (intptr_t) queue_pop_head(queue);
+    failed += value != i;
+  }
+  failed += queue_is_empty(queue) != BOOL_TRUE;
+  failed += QUEUE_RECYCLE_LIMIT < queue->recycle_num;
+  //LIFO from the head, exactly filling the blocks below the middle of the first one
+  for(i = 1; i <= QUEUE_BLOCK_SIZE / 2 + QUEUE_BLOCK_SIZE; ++i){
+    queue_push_head(queue, (ptr_t) (intptr_t) i);
+  }
+  failed += (intptr_t) queue_peek_tail(queue) != 1;
+  for(i = QUEUE_BLOCK_SIZE / 2 + QUEUE_BLOCK_SIZE; 1 <= i; --i){
+    value = (intptr_t) queue_pop_head(queue);
+    failed += value != i;
+  }
+  failed += queue_pop_head(queue) != NULL;
+  //both ends across the boundaries, then drained from the tail
+  for(i = 1; i <= QUEUE_BLOCK_SIZE + 1; ++i){
+    queue_push_head(queue, (ptr_t) (intptr_t) -i);
+    queue_push_tail(queue, (ptr_t) (intptr_t) i);
+  }
+  failed += queue->counter != 2 * (QUEUE_BLOCK_SIZE + 1);
+  for(i = QUEUE_BLOCK_SIZE + 1; 1 <= i; --i){
+    value = (intptr_t) queue_pop_tail(queue);
+    failed += value != i;
+  }
+  for(i = 1; i <= QUEUE_BLOCK_SIZE + 1; ++i){
+    value = (intptr_t) queue_pop_tail(queue);
+    failed += value != -i;
+  }
+  failed += queue_is_empty(queue) != BOOL_TRUE;
+  failed += queue->head != queue->tail;
+  queue_dtor(queue);
+  return failed;
+}
 
 void queue_test(void)
 {
@@ -61,15 +114,49 @@ void queue_test(void)
   print_queue_status(queue);
 
   queue_dtor(queue);
+  sysio->print_stdout("block boundaries: %s\n", _queue_blocks_test() ? "FAILED" : "passed");
   //queue->counter = 1;//segfault
 }
 
+static queueblock_t* _queue_get_block(queue_t* this)
+{
+  queueblock_t* result;
+  if(this->recycle){
+    result = this->recycle;
+    this->recycle = result->next;
+    --this->recycle_num;
+  }else{
+    result = malloc(sizeof(queueblock_t));
+  }
+  result->next = result->prev = NULL;
+  return result;
+}
+
+static void _queue_trash_block(queue_t* this, queueblock_t* block)
+{
+  if(QUEUE_RECYCLE_LIMIT <= this->recycle_num){
+    free(block);
+    return;
+  }
+  block->next = this->recycle;
+  this->recycle = block;
+  ++this->recycle_num;
+}
+
+//an empty queue keeps one block and starts from its middle,
+//so pushes on both ends fit in it
+static void _queue_recenter(queue_t* this)
+{
+  this->head_index = this->tail_index = QUEUE_BLOCK_SIZE / 2;
+}
+
 queue_t* make_queue(void (*disposer)(ptr_t))
 {
   queue_t* result;
   result = malloc(sizeof(queue_t));
   memset(result, 0, sizeof(queue_t));
-  result->tail = result->head = NULL;
+  result->tail = result->head = _queue_get_block(result);
+  _queue_recenter(result);
   result->disposer = disposer;
   return result;
 }
@@ -77,6 +164,7 @@ queue_t* make_queue(void (*disposer)(ptr_t))
 void queue_dtor(queue_t* target)
 {
   queue_t* this;
+  queueblock_t* next;
   if(!target){
     return;
   }
@@ -90,106 +178,111 @@ void queue_dtor(queue_t* target)
     }
     this->disposer(data);
   }
+  free(this->head);
+  for(; this->recycle; this->recycle = next){
+    next = this->recycle->next;
+    free(this->recycle);
+  }
   free(this);
 }
 
 void print_queue_status(queue_t* queue)
 {
   sysio->print_stdout("queue %p properties\n"
-                      "counter: %d, head: %p, tail: %p\n"
-      , queue, queue->counter,queue->head, queue->tail);
+                      "counter: %d, head: %p (%d), tail: %p (%d), recycled blocks: %d\n"
+      , queue, queue->counter, queue->head, queue->head_index,
+      queue->tail, queue->tail_index, queue->recycle_num);
 }
 
 void queue_push_head(queue_t* this, ptr_t data)
 {
-  dlist_t* item;
-  ++this->counter;
-  if(!this->head){
-    this->head = this->tail = make_dlist(data);
-    return;
+  queueblock_t* block;
+  if(!this->head_index){
+    block = _queue_get_block(this);
+    block->next = this->head;
+    this->head->prev = block;
+    this->head = block;
+    this->head_index = QUEUE_BLOCK_SIZE;
   }
-  item = make_dlist(data);
-  item->next = this->head;
-  this->head->prev = item;
-  this->head = item;
+  this->head->items[--this->head_index] = data;
+  ++this->counter;
 }
 
 ptr_t queue_pop_head(queue_t* this)
 {
-  dlist_t *next;
+  queueblock_t *next;
   ptr_t result;
 
-  if(!this->head){
+  if(!this->counter){
     return NULL;
   }
-  --this->counter;
-  next = this->head->next;
-  result = this->head->data;
-  free(this->head);
-  this->head = next;
-  if(next){
+  result = this->head->items[this->head_index++];
+  if(!--this->counter){
+    _queue_recenter(this);
+  }else if(this->head_index == QUEUE_BLOCK_SIZE){
+    next = this->head->next;
     next->prev = NULL;
-  }else{
-    this->tail = NULL;
+    _queue_trash_block(this, this->head);
+    this->head = next;
+    this->head_index = 0;
   }
   return result;
 }
 
 ptr_t queue_peek_head(queue_t* this)
 {
-  if(!this->head){
+  if(!this->counter){
     return NULL;
   }
-  return this->head->data;
+  return this->head->items[this->head_index];
 }
 
 void queue_push_tail(queue_t* this, ptr_t data)
 {
-  dlist_t* item;
-  ++this->counter;
-  if(!this->tail){
-    this->head = this->tail = make_dlist(data);
-    return;
+  queueblock_t* block;
+  if(this->tail_index == QUEUE_BLOCK_SIZE){
+    block = _queue_get_block(this);
+    block->prev = this->tail;
+    this->tail->next = block;
+    this->tail = block;
+    this->tail_index = 0;
   }
-  item = make_dlist(data);
-  item->prev = this->tail;
-  this->tail->next = item;
-  this->tail = item;
+  this->tail->items[this->tail_index++] = data;
+  ++this->counter;
 }
 
 
 ptr_t queue_pop_tail(queue_t* this)
 {
-  dlist_t *prev;
+  queueblock_t *prev;
   ptr_t result;
 
-  if(!this->tail){
+  if(!this->counter){
     return NULL;
   }
-  --this->counter;
-  prev = this->tail->prev;
-  result = this->tail->data;
-  free(this->tail);
-  this->tail = prev;
-  if(prev){
+  result = this->tail->items[--this->tail_index];
+  if(!--this->counter){
+    _queue_recenter(this);
+  }else if(!this->tail_index){
+    prev = this->tail->prev;
     prev->next = NULL;
-  }else{
-    this->tail = NULL;
+    _queue_trash_block(this, this->tail);
+    this->tail = prev;
+    this->tail_index = QUEUE_BLOCK_SIZE;
   }
   return result;
 }
 
 ptr_t queue_peek_tail(queue_t* this)
 {
-  if(!this->tail){
+  if(!this->counter){
     return NULL;
   }
-  return this->tail->data;
+  return this->tail->items[this->tail_index - 1];
 }
 
 bool_t queue_is_empty(queue_t* this)
 {
-  return 0 < this->counter ? BOOL_TRUE : BOOL_FALSE;
+  return 0 < this->counter ? BOOL_FALSE : BOOL_TRUE;
 }
 
-
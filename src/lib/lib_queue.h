@@ -11,9 +11,23 @@
 #include "lib_descs.h"
 #include "lib_puffers.h"
 
+#define QUEUE_BLOCK_SIZE     256
+#define QUEUE_RECYCLE_LIMIT  4
+
+//a fixed size chunk of item pointers the queue is built from
+typedef struct _queueblock {
+  ptr_t               items[QUEUE_BLOCK_SIZE];
+  struct _queueblock *next;
+  struct _queueblock *prev;
+} queueblock_t;
+
 typedef struct _queue {
-  dlist_t* head;
-  dlist_t* tail;
+  queueblock_t* head;          ///< block the first item is in
+  queueblock_t* tail;          ///< block the last item is in
+  int32_t       head_index;    ///< index of the first item in the head block
+  int32_t       tail_index;    ///< index after the last item in the tail block
+  queueblock_t* recycle;       ///< emptied blocks kept for reuse
+  int32_t       recycle_num;
   void (*disposer)(void *);
   int32_t counter;
 } queue_t;
@@ -0,0 +1,434 @@
+#include "lib_skiplist.h"
+#include <stdint.h>
+#include <pthread.h>
+
+//Lazy skiplist: writers lock the predecessors they change, readers never lock.
+//Deleted nodes are retired to the epoch based reclamation of lib_threading and
+//freed once every thread inside a list has left the epoch they were deleted in.
+
+static __thread uint32_t  _skiplist_seed = 0;
+
+static int32_t _skiplist_random_level(void)
+{
+  uint32_t x = _skiplist_seed;
+  if(!x){
+    x = (uint32_t)(uintptr_t) &x ^ (uint32_t) pthread_self() ^ 0x9E3779B9u;
+  }
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  _skiplist_seed = x;
+  //every level is reached with half of the probability of the previous one
+  return __builtin_ctz(x | (1u << (SKIPLIST_MAX_LEVEL - 1))) + 1;
+}
+
+static skiplistnode_t* _make_skiplistnode(ptr_t key, ptr_t value, int32_t top_level)
+{
+  skiplistnode_t* result;
+  result = malloc(sizeof(skiplistnode_t) + top_level * sizeof(skiplistnode_t*));
+  memset(result, 0, sizeof(skiplistnode_t) + top_level * sizeof(skiplistnode_t*));
+  result->key = key;
+  result->value = value;
+  result->top_level = top_level;
+  pthread_spin_init(&result->lock, 0);
+  return result;
+}
+
+static void _trash_skiplistnode(skiplistnode_t* node, void (*disposer)(ptr_t))
+{
+  if(disposer && node->value){
+    disposer(node->value);
+  }
+  pthread_spin_destroy(&node->lock);
+  free(node);
+}
+
+//the node keeps the disposer of its list, which may be gone when it is freed
+static void _skiplist_trash_retired(void* arg)
+{
+  skiplistnode_t* node = arg;
+  _trash_skiplistnode(node, node->disposer);
+}
+
+static skiplistnode_t* _skiplist_next(skiplistnode_t* node, int32_t level)
+{
+  return __atomic_load_n(&node->next[level], __ATOMIC_ACQUIRE);
+}
+
+static bool_t _skiplist_is_marked(skiplistnode_t* node)
+{
+  return __atomic_load_n(&node->marked, __ATOMIC_ACQUIRE);
+}
+
+static bool_t _skiplist_is_linked(skiplistnode_t* node)
+{
+  return __atomic_load_n(&node->fully_linked, __ATOMIC_ACQUIRE);
+}
+
+//fills the predecessors and successors of the key on all levels,
+//returns the highest level the key is found on or -1
+static int32_t _skiplist_search(skiplist_t* this, ptr_t key, skiplistnode_t** preds, skiplistnode_t** succs)
+{
+  skiplistnode_t *pred, *curr;
+  int32_t level, found = -1, cmp = 1;
+  pred = this->head;
+  for(level = SKIPLIST_MAX_LEVEL - 1; 0 <= level; --level){
+    curr = _skiplist_next(pred, level);
+    while(curr && (cmp = this->cmp(curr->key, key)) < 0){
+      pred = curr;
+      curr = _skiplist_next(pred, level);
+    }
+    if(found < 0 && curr && cmp == 0){
+      found = level;
+    }
+    preds[level] = pred;
+    succs[level] = curr;
+  }
+  return found;
+}
+
+static void _skiplist_unlock_preds(skiplistnode_t** preds, int32_t highest_locked)
+{
+  skiplistnode_t* prev = NULL;
+  int32_t level;
+  for(level = 0; level <= highest_locked; ++level){
+    if(preds[level] != prev){
+      pthread_spin_unlock(&preds[level]->lock);
+      prev = preds[level];
+    }
+  }
+}
+
+void skiplist_enter()
+{
+  ebr_enter();
+}
+
+void skiplist_leave()
+{
+  ebr_leave();
+}
+
+skiplist_t* make_skiplist(skiplistcmp cmp, void (*disposer)(ptr_t))
+{
+  skiplist_t* result;
+  result = malloc(sizeof(skiplist_t));
+  memset(result, 0, sizeof(skiplist_t));
+  result->cmp = cmp;
+  result->disposer = disposer;
+  result->head = _make_skiplistnode(NULL, NULL, SKIPLIST_MAX_LEVEL);
+  result->head->fully_linked = BOOL_TRUE;
+  return result;
+}
+
+void skiplist_dtor(ptr_t target)
+{
+  skiplist_t* this = target;
+  skiplistnode_t *node, *next;
+  if(!this){
+    return;
+  }
+  for(node = this->head->next[0]; node; node = next){
+    next = node->next[0];
+    _trash_skiplistnode(node, this->disposer);
+  }
+  _trash_skiplistnode(this->head, NULL);
+  free(this);
+}
+
+bool_t skiplist_insert(skiplist_t* this, ptr_t key, ptr_t value)
+{
+  skiplistnode_t *preds[SKIPLIST_MAX_LEVEL], *succs[SKIPLIST_MAX_LEVEL];
+  skiplistnode_t *pred, *succ, *prev, *node;
+  int32_t top_level, level, found, highest_locked;
+  bool_t valid;
+
+  top_level = _skiplist_random_level();
+  skiplist_enter();
+  for(;;){
+    found = _skiplist_search(this, key, preds, succs);
+    if(0 <= found){
+      node = succs[found];
+      if(!_skiplist_is_marked(node)){
+        while(!_skiplist_is_linked(node));
+        skiplist_leave();
+        return BOOL_FALSE;
+      }
+      //the node with the same key is being deleted, retry after it is unlinked
+      continue;
+    }
+    highest_locked = -1;
+    prev = NULL;
+    valid = BOOL_TRUE;
+    for(level = 0; valid && level < top_level; ++level){
+      pred = preds[level];
+      succ = succs[level];
+      if(pred != prev){
+        pthread_spin_lock(&pred->lock);
+        highest_locked = level;
+        prev = pred;
+      }
+      valid = !_skiplist_is_marked(pred) && (!succ || !_skiplist_is_marked(succ)) && pred->next[level] == succ;
+    }
+    if(!valid){
+      _skiplist_unlock_preds(preds, highest_locked);
+      continue;
+    }
+    node = _make_skiplistnode(key, value, top_level);
+    for(level = 0; level < top_level; ++level){
+      node->next[level] = succs[level];
+    }
+    for(level = 0; level < top_level; ++level){
+      __atomic_store_n(&preds[level]->next[level], node, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&node->fully_linked, BOOL_TRUE, __ATOMIC_RELEASE);
+    _skiplist_unlock_preds(preds, highest_locked);
+    __atomic_add_fetch(&this->length, 1, __ATOMIC_RELAXED);
+    skiplist_leave();
+    return BOOL_TRUE;
+  }
+}
+
+//unlinks the node of the key and retires it with the given disposer,
+//the value is returned if value is not NULL
+static bool_t _skiplist_unlink(skiplist_t* this, ptr_t key, void (*disposer)(ptr_t), ptr_t* value)
+{
+  skiplistnode_t *preds[SKIPLIST_MAX_LEVEL], *succs[SKIPLIST_MAX_LEVEL];
+  skiplistnode_t *pred, *prev, *victim = NULL;
+  int32_t top_level = 0, level, found, highest_locked;
+  bool_t valid, marked = BOOL_FALSE;
+
+  skiplist_enter();
+  for(;;){
+    found = _skiplist_search(this, key, preds, succs);
+    if(0 <= found){
+      victim = succs[found];
+    }
+    if(!marked){
+      if(found < 0 || !_skiplist_is_linked(victim) || victim->top_level - 1 != found || _skiplist_is_marked(victim)){
+        skiplist_leave();
+        return BOOL_FALSE;
+      }
+      top_level = victim->top_level;
+      pthread_spin_lock(&victim->lock);
+      if(victim->marked){
+        pthread_spin_unlock(&victim->lock);
+        skiplist_leave();
+        return BOOL_FALSE;
+      }
+      __atomic_store_n(&victim->marked, BOOL_TRUE, __ATOMIC_RELEASE);
+      marked = BOOL_TRUE;
+    }
+    highest_locked = -1;
+    prev = NULL;
+    valid = BOOL_TRUE;
+    for(level = 0; valid && level < top_level; ++level){
+      pred = preds[level];
+      if(pred != prev){
+        pthread_spin_lock(&pred->lock);
+        highest_locked = level;
+        prev = pred;
+      }
+      valid = !_skiplist_is_marked(pred) && pred->next[level] == victim;
+    }
+    if(!valid){
+      _skiplist_unlock_preds(preds, highest_locked);
+      continue;
+    }
+    for(level = top_level - 1; 0 <= level; --level){
+      __atomic_store_n(&preds[level]->next[level], victim->next[level], __ATOMIC_RELEASE);
+    }
+    pthread_spin_unlock(&victim->lock);
+    _skiplist_unlock_preds(preds, highest_locked);
+    __atomic_sub_fetch(&this->length, 1, __ATOMIC_RELAXED);
+    skiplist_leave();
+    if(value){
+      *value = victim->value;
+    }
+    victim->disposer = disposer;
+    ebr_retire(victim, _skiplist_trash_retired);
+    return BOOL_TRUE;
+  }
+}
+
+bool_t skiplist_delete(skiplist_t* this, ptr_t key)
+{
+  return _skiplist_unlink(this, key, this->disposer, NULL);
+}
+
+//deletes the key without disposing its value, returns the value or NULL if
+//the key is not in the list. Only the caller which removed the key gets it.
+ptr_t skiplist_remove(skiplist_t* this, ptr_t key)
+{
+  ptr_t result = NULL;
+  _skiplist_unlink(this, key, NULL, &result);
+  return result;
+}
+
+ptr_t skiplist_find(skiplist_t* this, ptr_t key)
+{
+  skiplistnode_t *preds[SKIPLIST_MAX_LEVEL], *succs[SKIPLIST_MAX_LEVEL];
+  skiplistnode_t *node;
+  ptr_t result = NULL;
+  int32_t found;
+
+  skiplist_enter();
+  found = _skiplist_search(this, key, preds, succs);
+  if(0 <= found){
+    node = succs[found];
+    if(_skiplist_is_linked(node) && !_skiplist_is_marked(node)){
+      result = node->value;
+    }
+  }
+  skiplist_leave();
+  return result;
+}
+
+void skiplist_foreach(skiplist_t* this, skiplistprocess process, ptr_t arg)
+{
+  skiplist_range(this, NULL, NULL, process, arg);
+}
+
+int32_t skiplist_range(skiplist_t* this, ptr_t from, ptr_t to, skiplistprocess process, ptr_t arg)
+{
+  skiplistnode_t *node;
+  int32_t level, result = 0;
+
+  skiplist_enter();
+  node = this->head;
+  if(from){
+    for(level = SKIPLIST_MAX_LEVEL - 1; 0 <= level; --level){
+      skiplistnode_t* next = _skiplist_next(node, level);
+      while(next && this->cmp(next->key, from) < 0){
+        node = next;
+        next = _skiplist_next(node, level);
+      }
+    }
+  }
+  for(node = _skiplist_next(node, 0); node; node = _skiplist_next(node, 0)){
+    if(to && 0 < this->cmp(node->key, to)){
+      break;
+    }
+    if(!_skiplist_is_linked(node) || _skiplist_is_marked(node)){
+      continue;
+    }
+    process(node->key, node->value, arg);
+    ++result;
+  }
+  skiplist_leave();
+  return result;
+}
+
+int32_t skiplist_get_length(skiplist_t* this)
+{
+  return __atomic_load_n(&this->length, __ATOMIC_RELAXED);
+}
+
+#define _SKIPLIST_TEST_KEYS     2000
+#define _SKIPLIST_TEST_THREADS  4
+
+static volatile int32_t _skiplist_test_disposed = 0;
+
+static int32_t _skiplist_test_cmp(ptr_t a, ptr_t b)
+{
+  return (intptr_t) a < (intptr_t) b ? -1 : (intptr_t) a > (intptr_t) b;
+}
+
+static void _skiplist_test_dispose(ptr_t value __attribute__((unused)))
+{
+  __atomic_add_fetch(&_skiplist_test_disposed, 1, __ATOMIC_RELAXED);
+}
+
+//checks that the keys come in ascending order, arg points to the previous one
+static void _skiplist_test_order(ptr_t key, ptr_t value, ptr_t arg)
+{
+  intptr_t* prev = arg;
+  if((intptr_t) key <= prev[0] || key != value){
+    ++prev[1];
+  }
+  prev[0] = (intptr_t) key;
+}
+
+static void* _skiplist_test_worker(void* arg)
+{
+  skiplist_t* list = ((void**) arg)[0];
+  intptr_t first = (intptr_t) ((void**) arg)[1], key;
+  for(key = first; key <= _SKIPLIST_TEST_KEYS; key += _SKIPLIST_TEST_THREADS){
+    skiplist_insert(list, (ptr_t) key, (ptr_t) key);
+  }
+  for(key = first; key <= _SKIPLIST_TEST_KEYS; key += _SKIPLIST_TEST_THREADS){
+    if(key % 2){
+      skiplist_delete(list, (ptr_t) key);
+    }
+  }
+  ebr_synchronize();
+  ebr_thread_unregister();
+  return NULL;
+}
+
+//the empty list, the first and the last keys, ranges starting and ending
+//between and on keys, and concurrent inserts and deletes
+void skiplist_test(void)
+{
+  skiplist_t* list;
+  pthread_t threads[_SKIPLIST_TEST_THREADS];
+  void* args[_SKIPLIST_TEST_THREADS][2];
+  intptr_t order[2], key;
+  int32_t i, failed = 0;
+
+  list = make_skiplist(_skiplist_test_cmp, _skiplist_test_dispose);
+  failed += skiplist_find(list, (ptr_t) 1) != NULL;
+  failed += skiplist_delete(list, (ptr_t) 1) != BOOL_FALSE;
+  failed += skiplist_range(list, NULL, NULL, _skiplist_test_order, order) != 0;
+  for(key = 10; key <= 100; key += 10){
+    failed += skiplist_insert(list, (ptr_t) key, (ptr_t) key) != BOOL_TRUE;
+  }
+  failed += skiplist_insert(list, (ptr_t) 10, (ptr_t) 10) != BOOL_FALSE;
+  failed += skiplist_insert(list, (ptr_t) 100, (ptr_t) 100) != BOOL_FALSE;
+  failed += skiplist_get_length(list) != 10;
+  failed += skiplist_find(list, (ptr_t) 9) != NULL || skiplist_find(list, (ptr_t) 101) != NULL;
+  failed += skiplist_find(list, (ptr_t) 10) != (ptr_t) 10 || skiplist_find(list, (ptr_t) 100) != (ptr_t) 100;
+  //the bounds of a range are inclusive
+  order[0] = order[1] = 0;
+  failed += skiplist_range(list, (ptr_t) 20, (ptr_t) 50, _skiplist_test_order, order) != 4;
+  failed += skiplist_range(list, (ptr_t) 15, (ptr_t) 55, _skiplist_test_order, order) != 4;
+  failed += skiplist_range(list, (ptr_t) 101, NULL, _skiplist_test_order, order) != 0;
+  failed += skiplist_range(list, NULL, (ptr_t) 9, _skiplist_test_order, order) != 0;
+  order[0] = order[1] = 0;
+  failed += skiplist_range(list, NULL, NULL, _skiplist_test_order, order) != 10;
+  failed += order[1] != 0;
+  //the first, the last and a middle key
+  failed += skiplist_delete(list, (ptr_t) 10) != BOOL_TRUE;
+  failed += skiplist_delete(list, (ptr_t) 100) != BOOL_TRUE;
+  failed += skiplist_delete(list, (ptr_t) 50) != BOOL_TRUE;
+  failed += skiplist_delete(list, (ptr_t) 50) != BOOL_FALSE;
+  failed += skiplist_get_length(list) != 7;
+  failed += skiplist_find(list, (ptr_t) 50) != NULL;
+  //a removed value is handed back instead of being disposed
+  failed += skiplist_remove(list, (ptr_t) 60) != (ptr_t) 60;
+  failed += skiplist_remove(list, (ptr_t) 60) != NULL;
+  failed += skiplist_get_length(list) != 6;
+  ebr_synchronize();
+  failed += _skiplist_test_disposed != 3;
+  skiplist_dtor(list);
+  failed += _skiplist_test_disposed != 9;
+
+  list = make_skiplist(_skiplist_test_cmp, NULL);
+  for(i = 0; i < _SKIPLIST_TEST_THREADS; ++i){
+    args[i][0] = list;
+    args[i][1] = (void*) (intptr_t) (i + 1);
+    pthread_create(&threads[i], NULL, _skiplist_test_worker, args[i]);
+  }
+  for(i = 0; i < _SKIPLIST_TEST_THREADS; ++i){
+    pthread_join(threads[i], NULL);
+  }
+  order[0] = order[1] = 0;
+  failed += skiplist_range(list, NULL, NULL, _skiplist_test_order, order) != _SKIPLIST_TEST_KEYS / 2;
+  failed += order[1] != 0 || skiplist_get_length(list) != _SKIPLIST_TEST_KEYS / 2;
+  for(key = 1; key <= _SKIPLIST_TEST_KEYS; ++key){
+    failed += (skiplist_find(list, (ptr_t) key) != NULL) != !(key % 2);
+  }
+  skiplist_dtor(list);
+  ebr_synchronize();
+  printf("skiplist_test: %s\n", failed ? "FAILED" : "passed");
+}
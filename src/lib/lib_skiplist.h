@@ -0,0 +1,47 @@
+#ifndef INCGUARD_NTRT_LIBRARY_SKIPLIST_H_
+#define INCGUARD_NTRT_LIBRARY_SKIPLIST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "lib_defs.h"
+#include "lib_threading.h"
+
+#define SKIPLIST_MAX_LEVEL          24
+
+typedef int32_t (*skiplistcmp)(ptr_t,ptr_t);
+typedef void    (*skiplistprocess)(ptr_t key, ptr_t value, ptr_t arg);
+
+typedef struct _skiplistnode {
+  ptr_t                   key;
+  ptr_t                   value;
+  volatile bool_t         marked;         ///< logically deleted
+  volatile bool_t         fully_linked;   ///< linked on all of its levels
+  int32_t                 top_level;
+  void                  (*disposer)(ptr_t); ///< set when the node is retired
+  spin_t                  lock;
+  struct _skiplistnode*   next[];
+} skiplistnode_t;
+
+typedef struct _skiplist {
+  skiplistnode_t*         head;
+  skiplistcmp             cmp;
+  void                  (*disposer)(ptr_t);
+  volatile int32_t        length;
+} skiplist_t;
+
+skiplist_t* make_skiplist(skiplistcmp cmp, void (*disposer)(ptr_t));
+void skiplist_dtor(ptr_t target);
+bool_t skiplist_insert(skiplist_t* this, ptr_t key, ptr_t value);
+bool_t skiplist_delete(skiplist_t* this, ptr_t key);
+ptr_t skiplist_remove(skiplist_t* this, ptr_t key);
+ptr_t skiplist_find(skiplist_t* this, ptr_t key);
+void skiplist_foreach(skiplist_t* this, skiplistprocess process, ptr_t arg);
+int32_t skiplist_range(skiplist_t* this, ptr_t from, ptr_t to, skiplistprocess process, ptr_t arg);
+int32_t skiplist_get_length(skiplist_t* this);
+void skiplist_enter();
+void skiplist_leave();
+void skiplist_test(void);
+
+#endif /* INCGUARD_NTRT_LIBRARY_SKIPLIST_H_ */
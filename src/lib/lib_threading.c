@@ -1,10 +1,22 @@
+#define _GNU_SOURCE
 #include "lib_threading.h"
 #include "inc_texts.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <strings.h>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <limits.h>
+#include <linux/futex.h>
 #include "inc_unistd.h"
 #include "lib_debuglog.h"
+#include "lib_lockprof.h"
+#include "lib_fiber.h"
+#include "lib_predefs.h"
 
 //#define LOCKS_LOGS_ENABLED
 
@@ -31,12 +43,15 @@ void mutex_dtor(void *mutex)
 void mutex_lock(mutex_t* mutex)
 {
 	debug_lockcall("mutex_lock");
+	lockprof_begin();
 	pthread_mutex_lock(mutex);
+	lockprof_acquired(mutex);
 }
 
 void mutex_unlock(mutex_t* mutex)
 {
 	debug_lockcall("mutex_unlock");
+	lockprof_released(mutex);
 	pthread_mutex_unlock(mutex);
 }
 
@@ -64,12 +79,15 @@ void spin_dtor(spin_t *spin)
 void spin_lock(spin_t* spin)
 {
 	debug_lockcall("spin_lock");
+	lockprof_begin();
 	pthread_spin_lock(spin);
+	lockprof_acquired(spin);
 }
 
 void spin_unlock(spin_t* spin)
 {
 	debug_lockcall("spin_unlock");
+	lockprof_released(spin);
 	pthread_spin_unlock(spin);
 }
 
@@ -102,12 +120,18 @@ void signal_set(signal_t *signal)
 {
 	debug_lockcall("signal_set");
 	pthread_cond_signal(&(signal->cond));
+	if(__atomic_load_n(&signal->fibers.first, __ATOMIC_ACQUIRE)){
+		fiberwaitq_wake(&signal->fibers, 1);
+	}
 }
 
 void signal_setall(signal_t *signal)
 {
 	debug_lockcall("signal_set");
 	pthread_cond_broadcast(&signal->cond);
+	if(__atomic_load_n(&signal->fibers.first, __ATOMIC_ACQUIRE)){
+		fiberwaitq_wake(&signal->fibers, INT_MAX);
+	}
 }
 
 void signal_wait(signal_t *signal)
@@ -115,7 +139,44 @@ void signal_wait(signal_t *signal)
 	debug_lockcall("signal_wait");
 	++signal->waiters;
 	signal->waiting = BOOL_TRUE;
-	pthread_cond_wait(&(signal->cond), signal->mutex);
+	lockprof_released(signal->mutex);
+	//a fiber parks instead of blocking its worker
+	if(fiber_current()){
+		fiberwaitq_wait(&signal->fibers, signal->mutex, -1);
+	}else{
+		pthread_cond_wait(&(signal->cond), signal->mutex);
+	}
+	{
+		lockprof_begin();
+		lockprof_acquired(signal->mutex);
+	}
+	signal->waiting = BOOL_FALSE;
+	--signal->waiters;
+}
+
+void signal_timedwait(signal_t *signal, int32_t ms)
+{
+	struct timespec deadline;
+	debug_lockcall("signal_timedwait");
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += ms / 1000;
+	deadline.tv_nsec += (ms % 1000) * 1000000L;
+	if(deadline.tv_nsec >= 1000000000L){
+		++deadline.tv_sec;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	++signal->waiters;
+	signal->waiting = BOOL_TRUE;
+	lockprof_released(signal->mutex);
+	if(fiber_current()){
+		fiberwaitq_wait(&signal->fibers, signal->mutex, ms);
+	}else{
+		pthread_cond_timedwait(&(signal->cond), signal->mutex, &deadline);
+	}
+	{
+		lockprof_begin();
+		lockprof_acquired(signal->mutex);
+	}
 	signal->waiting = BOOL_FALSE;
 	--signal->waiters;
 }
@@ -123,12 +184,15 @@ void signal_wait(signal_t *signal)
 void signal_lock(signal_t *signal)
 {
 	debug_lockcall("signal_lock");
+	lockprof_begin();
 	pthread_mutex_lock(signal->mutex);
+	lockprof_acquired(signal->mutex);
 }
 
 void signal_unlock(signal_t *signal)
 {
 	debug_lockcall("signal_unlock");
+	lockprof_released(signal->mutex);
 	pthread_mutex_unlock(signal->mutex);
 }
 
@@ -140,6 +204,785 @@ void signal_release(signal_t *signal)
 	}
 }
 
+lockstats_t* lockstats_ctor()
+{
+	lockstats_t* result;
+	result = (lockstats_t*) malloc(sizeof(lockstats_t));
+	BZERO((void*) result, sizeof(lockstats_t));
+	return result;
+}
+
+void lockstats_dtor(lockstats_t *stats)
+{
+	free((void*) stats);
+}
+
+void lockstats_print(const char_t *name, lockstats_t *stats)
+{
+	uint64_t acquisitions, contended, spin_cycles;
+	acquisitions = __atomic_load_n(&stats->acquisitions, __ATOMIC_RELAXED);
+	contended = __atomic_load_n(&stats->contended, __ATOMIC_RELAXED);
+	spin_cycles = __atomic_load_n(&stats->spin_cycles, __ATOMIC_RELAXED);
+	INFOPRINT("%s: %llu acquisitions, %llu contended (%.1f%%), %llu cycles per contended acquisition",
+			name, (unsigned long long) acquisitions, (unsigned long long) contended,
+			acquisitions ? 100. * contended / acquisitions : 0.,
+			(unsigned long long) (contended ? spin_cycles / contended : 0));
+}
+
+static inline void _lockstats_add(lockstats_t *stats, uint64_t started)
+{
+	if(stats == NULL){
+		return;
+	}
+	__atomic_add_fetch(&stats->acquisitions, 1, __ATOMIC_RELAXED);
+	if(started){
+		__atomic_add_fetch(&stats->contended, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&stats->spin_cycles, cpu_cycles() - started, __ATOMIC_RELAXED);
+	}
+}
+
+ticketlock_t* ticketlock_ctor()
+{
+	ticketlock_t* result;
+	result = (ticketlock_t*) malloc(sizeof(ticketlock_t));
+	result->next = 0;
+	result->owner = 0;
+	result->stats = NULL;
+	return result;
+}
+
+void ticketlock_dtor(ticketlock_t *lock)
+{
+	if(lock == NULL){
+		return;
+	}
+	lockstats_dtor(lock->stats);
+	free(lock);
+}
+
+void ticketlock_lock(ticketlock_t *lock)
+{
+	uint32_t ticket, owner, pause;
+	uint64_t started = 0;
+	debug_lockcall("ticketlock_lock");
+	lockprof_begin();
+	ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+	owner = __atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE);
+	if(owner != ticket && lock->stats){
+		started = cpu_cycles();
+	}
+	//backs off in proportion to the number of threads ahead
+	while(owner != ticket){
+		for(pause = (ticket - owner) * TICKETLOCK_BACKOFF; pause; --pause){
+			cpu_relax();
+		}
+		owner = __atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE);
+	}
+	_lockstats_add(lock->stats, started);
+	lockprof_acquired(lock);
+}
+
+bool_t ticketlock_trylock(ticketlock_t *lock)
+{
+	uint32_t ticket;
+	ticket = __atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE);
+	if(!__atomic_compare_exchange_n(&lock->next, &ticket, ticket + 1, BOOL_FALSE,
+									__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+		return BOOL_FALSE;
+	}
+	_lockstats_add(lock->stats, 0);
+	return BOOL_TRUE;
+}
+
+void ticketlock_unlock(ticketlock_t *lock)
+{
+	debug_lockcall("ticketlock_unlock");
+	lockprof_released(lock);
+	__atomic_store_n(&lock->owner, lock->owner + 1, __ATOMIC_RELEASE);
+}
+
+mcslock_t* mcslock_ctor()
+{
+	mcslock_t* result;
+	result = (mcslock_t*) malloc(sizeof(mcslock_t));
+	result->tail = NULL;
+	result->stats = NULL;
+	return result;
+}
+
+void mcslock_dtor(mcslock_t *lock)
+{
+	if(lock == NULL){
+		return;
+	}
+	lockstats_dtor(lock->stats);
+	free(lock);
+}
+
+//the node must be kept until the lock is unlocked with it
+void mcslock_lock(mcslock_t *lock, mcsnode_t *node)
+{
+	mcsnode_t *prev;
+	uint64_t   started = 0;
+	debug_lockcall("mcslock_lock");
+	lockprof_begin();
+	node->next = NULL;
+	node->locked = BOOL_TRUE;
+	prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+	if(prev != NULL){
+		if(lock->stats){
+			started = cpu_cycles();
+		}
+		__atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+		while(__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)){
+			cpu_relax();
+		}
+	}
+	_lockstats_add(lock->stats, started);
+	lockprof_acquired(lock);
+}
+
+void mcslock_unlock(mcslock_t *lock, mcsnode_t *node)
+{
+	mcsnode_t *next, *expected;
+	debug_lockcall("mcslock_unlock");
+	lockprof_released(lock);
+	next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+	if(next == NULL){
+		expected = node;
+		if(__atomic_compare_exchange_n(&lock->tail, &expected, NULL, BOOL_FALSE,
+										__ATOMIC_RELEASE, __ATOMIC_RELAXED)){
+			return;
+		}
+		//a successor is linking itself in
+		while((next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) == NULL){
+			cpu_relax();
+		}
+	}
+	__atomic_store_n(&next->locked, BOOL_FALSE, __ATOMIC_RELEASE);
+}
+
+adaptivelock_t* adaptivelock_ctor()
+{
+	adaptivelock_t* result;
+	result = (adaptivelock_t*) malloc(sizeof(adaptivelock_t));
+	result->locked = 0;
+	result->stats = NULL;
+	return result;
+}
+
+void adaptivelock_dtor(adaptivelock_t *lock)
+{
+	if(lock == NULL){
+		return;
+	}
+	lockstats_dtor(lock->stats);
+	free(lock);
+}
+
+void adaptivelock_lock(adaptivelock_t *lock)
+{
+	uint32_t backoff = 1, spun = 0, pause;
+	uint64_t started = 0;
+	debug_lockcall("adaptivelock_lock");
+	lockprof_begin();
+	while(__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE)){
+		if(!started && lock->stats){
+			started = cpu_cycles();
+		}
+		//waits on the cached value, so the line is not written while held
+		while(__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)){
+			if(ADAPTIVELOCK_SPIN_LIMIT <= spun){
+				sched_yield();
+				continue;
+			}
+			for(pause = backoff; pause; --pause){
+				cpu_relax();
+			}
+			spun += backoff;
+			if(backoff < 64){
+				backoff <<= 1;
+			}
+		}
+	}
+	_lockstats_add(lock->stats, started);
+	lockprof_acquired(lock);
+}
+
+bool_t adaptivelock_trylock(adaptivelock_t *lock)
+{
+	if(__atomic_load_n(&lock->locked, __ATOMIC_RELAXED) ||
+	   __atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE)){
+		return BOOL_FALSE;
+	}
+	_lockstats_add(lock->stats, 0);
+	return BOOL_TRUE;
+}
+
+void adaptivelock_unlock(adaptivelock_t *lock)
+{
+	debug_lockcall("adaptivelock_unlock");
+	lockprof_released(lock);
+	__atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+#define SPINLOCKS_TEST_THREADS 2
+#define SPINLOCKS_TEST_ROUNDS  1000
+
+static ticketlock_t     *_spinlocks_test_ticketlock;
+static mcslock_t        *_spinlocks_test_mcslock;
+static adaptivelock_t   *_spinlocks_test_adaptivelock;
+static volatile int32_t  _spinlocks_test_counter;
+
+static void _spinlocks_test_hold(intptr_t kind, mcsnode_t *node, bool_t lock)
+{
+	if(kind == 0){
+		lock ? ticketlock_lock(_spinlocks_test_ticketlock) : ticketlock_unlock(_spinlocks_test_ticketlock);
+	}else if(kind == 1){
+		lock ? mcslock_lock(_spinlocks_test_mcslock, node) : mcslock_unlock(_spinlocks_test_mcslock, node);
+	}else{
+		lock ? adaptivelock_lock(_spinlocks_test_adaptivelock) : adaptivelock_unlock(_spinlocks_test_adaptivelock);
+	}
+}
+
+//increments the counter in two steps, an update lost between them shows a broken exclusion
+static void* _spinlocks_test_worker(void *arg)
+{
+	mcsnode_t node;
+	int32_t   round, value;
+	for(round = 0; round < SPINLOCKS_TEST_ROUNDS; ++round){
+		_spinlocks_test_hold((intptr_t) arg, &node, BOOL_TRUE);
+		value = _spinlocks_test_counter;
+		cpu_relax();
+		_spinlocks_test_counter = value + 1;
+		_spinlocks_test_hold((intptr_t) arg, &node, BOOL_FALSE);
+		sched_yield();
+	}
+	return NULL;
+}
+
+void spinlocks_test(void)
+{
+	pthread_t  threads[SPINLOCKS_TEST_THREADS];
+	mcsnode_t  node;
+	intptr_t   kind;
+	int32_t    index, failed = 0;
+
+	_spinlocks_test_ticketlock = ticketlock_ctor();
+	_spinlocks_test_ticketlock->stats = lockstats_ctor();
+	_spinlocks_test_mcslock = mcslock_ctor();
+	_spinlocks_test_mcslock->stats = lockstats_ctor();
+	_spinlocks_test_adaptivelock = adaptivelock_ctor();
+	_spinlocks_test_adaptivelock->stats = lockstats_ctor();
+
+	//a held lock is not taken by trylock, a free one is
+	ticketlock_lock(_spinlocks_test_ticketlock);
+	failed += ticketlock_trylock(_spinlocks_test_ticketlock);
+	ticketlock_unlock(_spinlocks_test_ticketlock);
+	failed += !ticketlock_trylock(_spinlocks_test_ticketlock);
+	ticketlock_unlock(_spinlocks_test_ticketlock);
+	adaptivelock_lock(_spinlocks_test_adaptivelock);
+	failed += adaptivelock_trylock(_spinlocks_test_adaptivelock);
+	adaptivelock_unlock(_spinlocks_test_adaptivelock);
+	failed += !adaptivelock_trylock(_spinlocks_test_adaptivelock);
+	adaptivelock_unlock(_spinlocks_test_adaptivelock);
+
+	//the threads start on the lock held here, so each lock is waited for and
+	//nothing is counted until it is released, then no increment is lost
+	for(kind = 0; kind < 3; ++kind){
+		_spinlocks_test_counter = 0;
+		_spinlocks_test_hold(kind, &node, BOOL_TRUE);
+		for(index = 0; index < SPINLOCKS_TEST_THREADS; ++index){
+			pthread_create(&threads[index], NULL, _spinlocks_test_worker, (void*) kind);
+		}
+		thread_sleep(10);
+		failed += _spinlocks_test_counter != 0;
+		_spinlocks_test_hold(kind, &node, BOOL_FALSE);
+		for(index = 0; index < SPINLOCKS_TEST_THREADS; ++index){
+			pthread_join(threads[index], NULL);
+		}
+		failed += _spinlocks_test_counter != SPINLOCKS_TEST_THREADS * SPINLOCKS_TEST_ROUNDS;
+	}
+	failed += _spinlocks_test_ticketlock->stats->acquisitions != SPINLOCKS_TEST_THREADS * SPINLOCKS_TEST_ROUNDS + 3;
+	failed += _spinlocks_test_mcslock->stats->acquisitions != SPINLOCKS_TEST_THREADS * SPINLOCKS_TEST_ROUNDS + 1;
+	failed += _spinlocks_test_adaptivelock->stats->acquisitions != SPINLOCKS_TEST_THREADS * SPINLOCKS_TEST_ROUNDS + 3;
+	failed += !_spinlocks_test_ticketlock->stats->contended || !_spinlocks_test_mcslock->stats->contended ||
+			  !_spinlocks_test_adaptivelock->stats->contended;
+	failed += _spinlocks_test_mcslock->tail != NULL || _spinlocks_test_adaptivelock->locked ||
+			  _spinlocks_test_ticketlock->next != _spinlocks_test_ticketlock->owner;
+
+	ticketlock_dtor(_spinlocks_test_ticketlock);
+	mcslock_dtor(_spinlocks_test_mcslock);
+	adaptivelock_dtor(_spinlocks_test_adaptivelock);
+	printf("spinlocks_test: %s\n", failed ? "FAILED" : "passed");
+}
+
+static long _futex(volatile uint32_t *word, int op, uint32_t value, const struct timespec *timeout)
+{
+	return syscall(SYS_futex, word, op, value, timeout, NULL, 0);
+}
+
+eventcount_t* eventcount_ctor(int32_t spins)
+{
+	eventcount_t* result;
+	result = (eventcount_t*) malloc(sizeof(eventcount_t));
+	result->epoch = 0;
+	result->waiters = 0;
+	result->spins = spins;
+	BZERO(&result->fibers, sizeof(fiberwaitq_t));
+	return result;
+}
+
+void eventcount_dtor(eventcount_t *eventcount)
+{
+	free(eventcount);
+}
+
+uint32_t eventcount_prepare_wait(eventcount_t *eventcount)
+{
+	__atomic_add_fetch(&eventcount->waiters, 1, __ATOMIC_SEQ_CST);
+	return __atomic_load_n(&eventcount->epoch, __ATOMIC_SEQ_CST);
+}
+
+void eventcount_cancel_wait(eventcount_t *eventcount)
+{
+	__atomic_sub_fetch(&eventcount->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+//returns if any notify happened since the key was taken
+void eventcount_commit_wait(eventcount_t *eventcount, uint32_t key)
+{
+	int32_t spin;
+	debug_lockcall("eventcount_commit_wait");
+	if(fiber_current()){
+		while(__atomic_load_n(&eventcount->epoch, __ATOMIC_ACQUIRE) == key){
+			fiberwaitq_wait_key(&eventcount->fibers, &eventcount->epoch, key, -1);
+		}
+		eventcount_cancel_wait(eventcount);
+		return;
+	}
+	for(spin = 0; spin < eventcount->spins; ++spin){
+		if(__atomic_load_n(&eventcount->epoch, __ATOMIC_ACQUIRE) != key){
+			eventcount_cancel_wait(eventcount);
+			return;
+		}
+		cpu_relax();
+	}
+	while(__atomic_load_n(&eventcount->epoch, __ATOMIC_ACQUIRE) == key){
+		_futex(&eventcount->epoch, FUTEX_WAIT_PRIVATE, key, NULL);
+	}
+	eventcount_cancel_wait(eventcount);
+}
+
+//same as eventcount_commit_wait, but returns after ms at the latest
+void eventcount_commit_timedwait(eventcount_t *eventcount, uint32_t key, int32_t ms)
+{
+	struct timespec timeout;
+	debug_lockcall("eventcount_commit_timedwait");
+	timeout.tv_sec = ms / 1000;
+	timeout.tv_nsec = (ms % 1000) * 1000000L;
+	if(fiber_current()){
+		fiberwaitq_wait_key(&eventcount->fibers, &eventcount->epoch, key, ms);
+	}else if(__atomic_load_n(&eventcount->epoch, __ATOMIC_ACQUIRE) == key){
+		_futex(&eventcount->epoch, FUTEX_WAIT_PRIVATE, key, &timeout);
+	}
+	eventcount_cancel_wait(eventcount);
+}
+
+void eventcount_notify(eventcount_t *eventcount)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&eventcount->waiters, __ATOMIC_RELAXED) == 0){
+		return;
+	}
+	debug_lockcall("eventcount_notify");
+	__atomic_add_fetch(&eventcount->epoch, 1, __ATOMIC_SEQ_CST);
+	_futex(&eventcount->epoch, FUTEX_WAKE_PRIVATE, 1, NULL);
+	fiberwaitq_wake(&eventcount->fibers, 1);
+}
+
+void eventcount_notify_all(eventcount_t *eventcount)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&eventcount->waiters, __ATOMIC_RELAXED) == 0){
+		return;
+	}
+	debug_lockcall("eventcount_notify_all");
+	__atomic_add_fetch(&eventcount->epoch, 1, __ATOMIC_SEQ_CST);
+	_futex(&eventcount->epoch, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+	fiberwaitq_wake(&eventcount->fibers, INT_MAX);
+}
+
+#define EVENTCOUNT_TEST_ITEMS 20000
+
+static eventcount_t     *_eventcount_test_counter;
+static volatile int32_t  _eventcount_test_items = 0;
+static volatile int32_t  _eventcount_test_consumed = 0;
+static volatile int32_t  _eventcount_test_sleeps = 0;
+
+static bool_t _eventcount_test_take()
+{
+	int32_t items = __atomic_load_n(&_eventcount_test_items, __ATOMIC_SEQ_CST);
+	while(0 < items){
+		if(__atomic_compare_exchange_n(&_eventcount_test_items, &items, items - 1, BOOL_FALSE,
+									   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)){
+			__atomic_add_fetch(&_eventcount_test_consumed, 1, __ATOMIC_SEQ_CST);
+			return BOOL_TRUE;
+		}
+	}
+	return BOOL_FALSE;
+}
+
+static bool_t _eventcount_test_done()
+{
+	return __atomic_load_n(&_eventcount_test_consumed, __ATOMIC_SEQ_CST) >= 2 * EVENTCOUNT_TEST_ITEMS;
+}
+
+//checks the items again after taking the key, as the puffer components do
+static void* _eventcount_test_consumer(void *arg __attribute__((unused)))
+{
+	uint32_t key;
+	while(!_eventcount_test_done()){
+		if(_eventcount_test_take()){
+			continue;
+		}
+		key = eventcount_prepare_wait(_eventcount_test_counter);
+		if(_eventcount_test_take() || _eventcount_test_done()){
+			eventcount_cancel_wait(_eventcount_test_counter);
+			continue;
+		}
+		__atomic_add_fetch(&_eventcount_test_sleeps, 1, __ATOMIC_SEQ_CST);
+		eventcount_commit_wait(_eventcount_test_counter, key);
+	}
+	return NULL;
+}
+
+//pauses now and then, so the consumers run dry and block
+static void* _eventcount_test_producer(void *arg __attribute__((unused)))
+{
+	int32_t index;
+	for(index = 0; index < EVENTCOUNT_TEST_ITEMS; ++index){
+		__atomic_add_fetch(&_eventcount_test_items, 1, __ATOMIC_SEQ_CST);
+		eventcount_notify(_eventcount_test_counter);
+		if(index % 1000 == 0){
+			thread_sleep(1);
+		}
+	}
+	return NULL;
+}
+
+void eventcount_test(void)
+{
+	eventcount_t *counter;
+	pthread_t     threads[4];
+	uint32_t      key;
+	int32_t       index, waited, failed = 0;
+
+	//a notify without waiters leaves the epoch, one after the key was taken is not lost
+	counter = eventcount_ctor(0);
+	eventcount_notify(counter);
+	failed += counter->epoch != 0;
+	key = eventcount_prepare_wait(counter);
+	eventcount_notify(counter);
+	eventcount_commit_timedwait(counter, key, 1000);
+	failed += counter->epoch == key || counter->waiters != 0;
+	key = eventcount_prepare_wait(counter);
+	eventcount_commit_timedwait(counter, key, 10);
+	failed += counter->epoch != key || counter->waiters != 0;
+	eventcount_dtor(counter);
+
+	//every item is consumed although the consumers sleep in the futex in between
+	_eventcount_test_counter = eventcount_ctor(0);
+	for(index = 0; index < 2; ++index){
+		pthread_create(&threads[index], NULL, _eventcount_test_consumer, NULL);
+		pthread_create(&threads[2 + index], NULL, _eventcount_test_producer, NULL);
+	}
+	for(waited = 0; !_eventcount_test_done() && waited < 5000; waited += 10){
+		thread_sleep(10);
+	}
+	failed += !_eventcount_test_done() || _eventcount_test_items != 0 || _eventcount_test_sleeps == 0;
+	//a lost wakeup would leave a consumer asleep, it is released to end the test
+	__atomic_store_n(&_eventcount_test_consumed, 2 * EVENTCOUNT_TEST_ITEMS, __ATOMIC_SEQ_CST);
+	eventcount_notify_all(_eventcount_test_counter);
+	for(index = 0; index < 4; ++index){
+		pthread_join(threads[index], NULL);
+	}
+	eventcount_dtor(_eventcount_test_counter);
+	printf("eventcount_test: %s\n", failed ? "FAILED" : "passed");
+}
+
+//Epoch based reclamation: readers announce the global epoch they read in,
+//the epoch steps only if every reader has seen the current one. An object
+//retired in epoch E can not be seen by anyone once the epoch reached E + 2.
+
+static ebrrecord_t        _ebr_records[EBR_MAX_THREADS];
+static volatile int32_t   _ebr_records_num = 0;          ///< high water mark of the used records
+static volatile uint64_t  _ebr_epoch = 1;
+static pthread_mutex_t    _ebr_orphans_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ebrretired_t      *_ebr_orphans = NULL;           ///< retired by threads which are gone
+static pthread_once_t     _ebr_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t      _ebr_key;
+static __thread ebrrecord_t *_ebr_record = NULL;
+
+static uint64_t _ebr_try_advance()
+{
+	uint64_t epoch, reader;
+	int32_t  index, records_num;
+	epoch = __atomic_load_n(&_ebr_epoch, __ATOMIC_SEQ_CST);
+	records_num = __atomic_load_n(&_ebr_records_num, __ATOMIC_ACQUIRE);
+	for(index = 0; index < records_num; ++index){
+		reader = __atomic_load_n(&_ebr_records[index].epoch, __ATOMIC_SEQ_CST);
+		if(reader && reader != epoch){
+			return epoch;
+		}
+	}
+	__atomic_compare_exchange_n(&_ebr_epoch, &epoch, epoch + 1, BOOL_FALSE, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return __atomic_load_n(&_ebr_epoch, __ATOMIC_SEQ_CST);
+}
+
+//frees the entries of the list retired at least two epochs ago, returns the rest
+static ebrretired_t* _ebr_free(ebrretired_t *list, uint64_t epoch, int32_t *kept)
+{
+	ebrretired_t *retired, *next, *result = NULL;
+	for(retired = list; retired; retired = next){
+		next = retired->next;
+		if(retired->epoch + 2 <= epoch){
+			retired->disposer(retired->ptr);
+			free(retired);
+			continue;
+		}
+		retired->next = result;
+		result = retired;
+		++*kept;
+	}
+	return result;
+}
+
+static void _ebr_reclaim(ebrrecord_t *record)
+{
+	uint64_t epoch;
+	int32_t  kept = 0, orphans_kept = 0;
+	epoch = _ebr_try_advance();
+	record->retired = _ebr_free(record->retired, epoch, &kept);
+	record->retired_num = kept;
+	if(__atomic_load_n(&_ebr_orphans, __ATOMIC_RELAXED) && pthread_mutex_trylock(&_ebr_orphans_mutex) == 0){
+		__atomic_store_n(&_ebr_orphans, _ebr_free(_ebr_orphans, epoch, &orphans_kept), __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&_ebr_orphans_mutex);
+	}
+}
+
+static void _ebr_release_record(void *arg)
+{
+	ebrrecord_t  *record = (ebrrecord_t*) arg;
+	ebrretired_t *last;
+	if(record->retired){
+		_ebr_reclaim(record);
+	}
+	if(record->retired){
+		for(last = record->retired; last->next; last = last->next);
+		pthread_mutex_lock(&_ebr_orphans_mutex);
+		last->next = _ebr_orphans;
+		__atomic_store_n(&_ebr_orphans, record->retired, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&_ebr_orphans_mutex);
+	}
+	record->retired = NULL;
+	record->retired_num = 0;
+	record->depth = 0;
+	__atomic_store_n(&record->epoch, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&record->used, 0, __ATOMIC_RELEASE);
+}
+
+static void _ebr_init_key()
+{
+	pthread_key_create(&_ebr_key, _ebr_release_record);
+}
+
+//threads of LIB_DEF_THREAD are registered by the macro, any other thread
+//is registered at its first use and unregistered when it exits
+void ebr_thread_register()
+{
+	int32_t index, expected, records_num;
+	if(_ebr_record != NULL){
+		return;
+	}
+	pthread_once(&_ebr_key_once, _ebr_init_key);
+	for(index = 0; index < EBR_MAX_THREADS; ++index){
+		expected = 0;
+		if(__atomic_compare_exchange_n(&_ebr_records[index].used, &expected, 1, BOOL_FALSE,
+										__ATOMIC_ACQ_REL, __ATOMIC_RELAXED)){
+			break;
+		}
+	}
+	if(index == EBR_MAX_THREADS){
+		EXERROR("Too many threads use epoch based reclamation", EXIT_FAILURE);
+	}
+	records_num = __atomic_load_n(&_ebr_records_num, __ATOMIC_RELAXED);
+	while(records_num <= index && !__atomic_compare_exchange_n(&_ebr_records_num, &records_num, index + 1,
+										BOOL_FALSE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	_ebr_record = &_ebr_records[index];
+	pthread_setspecific(_ebr_key, _ebr_record);
+}
+
+void ebr_thread_unregister()
+{
+	if(_ebr_record == NULL){
+		return;
+	}
+	pthread_setspecific(_ebr_key, NULL);
+	_ebr_release_record(_ebr_record);
+	_ebr_record = NULL;
+}
+
+//starts a read side critical section, it costs no shared write
+void ebr_enter()
+{
+	ebrrecord_t *record = _ebr_record;
+	if(record == NULL){
+		ebr_thread_register();
+		record = _ebr_record;
+	}
+	if(record->depth++){
+		return;
+	}
+	__atomic_store_n(&record->epoch, __atomic_load_n(&_ebr_epoch, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void ebr_leave()
+{
+	ebrrecord_t *record = _ebr_record;
+	if(--record->depth){
+		return;
+	}
+	__atomic_store_n(&record->epoch, 0, __ATOMIC_RELEASE);
+}
+
+//the number of critical sections the calling thread is inside
+int32_t ebr_get_depth()
+{
+	return _ebr_record ? _ebr_record->depth : 0;
+}
+
+//reads a pointer published by ebr_publish, valid until ebr_leave
+void* ebr_read(void *volatile *slot)
+{
+	return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+}
+
+//replaces the version in the slot and retires the previous one
+void ebr_publish(void *volatile *slot, void *version, void (*disposer)(void*))
+{
+	void *previous;
+	previous = __atomic_exchange_n(slot, version, __ATOMIC_ACQ_REL);
+	if(previous != NULL && disposer != NULL){
+		ebr_retire(previous, disposer);
+	}
+}
+
+//the disposer is called once no reader can see the object anymore
+void ebr_retire(void *ptr, void (*disposer)(void*))
+{
+	ebrretired_t *retired;
+	if(_ebr_record == NULL){
+		ebr_thread_register();
+	}
+	retired = (ebrretired_t*) malloc(sizeof(ebrretired_t));
+	retired->ptr = ptr;
+	retired->disposer = disposer;
+	retired->epoch = __atomic_load_n(&_ebr_epoch, __ATOMIC_SEQ_CST);
+	retired->next = _ebr_record->retired;
+	_ebr_record->retired = retired;
+	if(EBR_RECLAIM_THRESHOLD <= ++_ebr_record->retired_num){
+		_ebr_reclaim(_ebr_record);
+	}
+}
+
+//waits for a grace period and frees what the thread retired before,
+//it must not be called inside a critical section
+void ebr_synchronize()
+{
+	uint64_t target;
+	if(_ebr_record == NULL){
+		ebr_thread_register();
+	}
+	target = __atomic_load_n(&_ebr_epoch, __ATOMIC_SEQ_CST) + 2;
+	while(_ebr_try_advance() < target){
+		sched_yield();
+	}
+	_ebr_reclaim(_ebr_record);
+}
+
+static volatile int32_t _ebr_test_disposed = 0;
+static volatile int32_t _ebr_test_step = 0;
+
+static void _ebr_test_disposer(void *ptr)
+{
+	__atomic_add_fetch(&_ebr_test_disposed, 1, __ATOMIC_SEQ_CST);
+	free(ptr);
+}
+
+//holds a nested critical section until the test lets it go
+static void* _ebr_test_reader(void *arg)
+{
+	void *volatile *slot = (void *volatile*) arg;
+	ebr_enter();
+	ebr_enter();
+	ebr_read(slot);
+	ebr_leave();
+	__atomic_store_n(&_ebr_test_step, 1, __ATOMIC_SEQ_CST);
+	while(__atomic_load_n(&_ebr_test_step, __ATOMIC_SEQ_CST) != 2){
+		sched_yield();
+	}
+	ebr_leave();
+	__atomic_store_n(&_ebr_test_step, 3, __ATOMIC_SEQ_CST);
+	while(__atomic_load_n(&_ebr_test_step, __ATOMIC_SEQ_CST) != 4){
+		sched_yield();
+	}
+	ebr_thread_unregister();
+	return NULL;
+}
+
+void ebr_test(void)
+{
+	int32_t        failed = 0;
+	int32_t        i;
+	pthread_t      reader;
+	void *volatile slot = malloc(16);
+
+	pthread_create(&reader, NULL, _ebr_test_reader, (void*) &slot);
+	while(__atomic_load_n(&_ebr_test_step, __ATOMIC_SEQ_CST) != 1){
+		sched_yield();
+	}
+	//the reader is still inside after leaving its inner section, nothing is freed
+	ebr_publish(&slot, malloc(16), _ebr_test_disposer);
+	for(i = 0; i < 2 * EBR_RECLAIM_THRESHOLD; ++i){
+		ebr_retire(malloc(16), _ebr_test_disposer);
+	}
+	failed += _ebr_test_disposed != 0;
+
+	//once the reader has left everything retired so far is freed
+	__atomic_store_n(&_ebr_test_step, 2, __ATOMIC_SEQ_CST);
+	while(__atomic_load_n(&_ebr_test_step, __ATOMIC_SEQ_CST) != 3){
+		sched_yield();
+	}
+	ebr_synchronize();
+	failed += _ebr_test_disposed != 2 * EBR_RECLAIM_THRESHOLD + 1;
+
+	//objects retired by a thread which unregisters are freed by the others
+	ebr_publish(&slot, NULL, _ebr_test_disposer);
+	ebr_thread_unregister();
+	__atomic_store_n(&_ebr_test_step, 4, __ATOMIC_SEQ_CST);
+	pthread_join(reader, NULL);
+	ebr_synchronize();
+	for(i = 0; i < EBR_RECLAIM_THRESHOLD; ++i){
+		ebr_retire(malloc(16), _ebr_test_disposer);
+	}
+	ebr_synchronize();
+	failed += _ebr_test_disposed != 3 * EBR_RECLAIM_THRESHOLD + 2;
+	ebr_thread_unregister();
+	printf("ebr_test: %s\n", failed ? "FAILED" : "passed");
+}
+
 #define BARRIER_FLAG (1UL<<31)
 barrier_t* barrier_ctor()
 {
@@ -234,23 +1077,29 @@ void rwmutex_dtor(void *rwmutex)
 void rwmutex_read_lock(rwmutex_t *rwmutex)
 {
 	debug_lockcall("rwmutex_read_lock");
+	lockprof_begin();
 	pthread_rwlock_rdlock(rwmutex);
+	lockprof_acquired(rwmutex);
 }
 
 void rwmutex_write_lock(rwmutex_t *rwmutex)
 {
 	debug_lockcall("rwmutex_write_lock");
+	lockprof_begin();
 	pthread_rwlock_wrlock(rwmutex);
+	lockprof_acquired(rwmutex);
 }
 
 void rwmutex_read_unlock(rwmutex_t *rwmutex)
 {
 	debug_lockcall("rwmutex_read_unlock");
+	lockprof_released(rwmutex);
 	pthread_rwlock_unlock(rwmutex);
 }
 void rwmutex_write_unlock(rwmutex_t *rwmutex)
 {
 	debug_lockcall("rwmutex_write_unlock");
+	lockprof_released(rwmutex);
 	pthread_rwlock_unlock(rwmutex);
 }
 
@@ -285,6 +1134,9 @@ thread_t* thread_ctor()
 	result->arg = NULL;
 	result->process = NULL;
 	result->state = THREAD_STATE_CONSTRUCTED;
+	result->executor = NULL;
+	result->initialized = BOOL_FALSE;
+	threadattrs_init(&(result->attrs));
 	pthread_attr_init(&(result->handler_attr));
 	pthread_attr_setdetachstate(&(result->handler_attr), PTHREAD_CREATE_JOINABLE);
 	return result;
@@ -301,6 +1153,171 @@ void setup_thread(thread_t* thread, void* (*process)(void*) , void* arg)
 	thread->state = THREAD_STATE_READY;
 }
 
+void threadattrs_init(threadattrs_t *attrs)
+{
+	memset(attrs->cpus, 0, sizeof(attrs->cpus));
+	attrs->numa_node = -1;
+	attrs->sched_policy = SCHED_OTHER;
+	attrs->sched_priority = 0;
+}
+
+static int32_t _thread_parse_cpulist(const char_t *cpulist, uint64_t *cpus)
+{
+	const char_t *pos = cpulist;
+	char_t       *end;
+	long          first, last, cpu;
+	int32_t       result = 0;
+	memset(cpus, 0, sizeof(uint64_t) * (THREAD_MAX_CPUS / 64));
+	while(*pos != '\0'){
+		if(*pos == ',' || *pos == ' ' || *pos == '\n'){
+			++pos;
+			continue;
+		}
+		first = last = strtol(pos, &end, 10);
+		if(end == pos){
+			return -1;
+		}
+		pos = end;
+		if(*pos == '-'){
+			last = strtol(++pos, &end, 10);
+			if(end == pos){
+				return -1;
+			}
+			pos = end;
+		}
+		if(first < 0 || last < first || last >= THREAD_MAX_CPUS){
+			return -1;
+		}
+		for(cpu = first; cpu <= last; ++cpu, ++result){
+			cpus[cpu / 64] |= 1ULL << (cpu % 64);
+		}
+	}
+	return result;
+}
+
+//cpulist is in the format of the kernel, like "0-3,8,10-11"
+int32_t threadattrs_set_cpus(threadattrs_t *attrs, const char_t *cpulist)
+{
+	uint64_t cpus[THREAD_MAX_CPUS / 64];
+	int32_t  result;
+	result = _thread_parse_cpulist(cpulist, cpus);
+	if(result < 0){
+		WARNINGPRINT("Invalid cpu list: %s", cpulist);
+		return -1;
+	}
+	memcpy(attrs->cpus, cpus, sizeof(cpus));
+	return result;
+}
+
+//binds the thread to the cpus of the node unless cpus are already given,
+//memory the thread allocates first is then placed on the node
+int32_t threadattrs_set_numa_node(threadattrs_t *attrs, int32_t node)
+{
+	char_t   path[128];
+	char_t   cpulist[1024];
+	FILE    *fd;
+	int32_t  index;
+	attrs->numa_node = node;
+	for(index = 0; index < THREAD_MAX_CPUS / 64 && attrs->cpus[index] == 0; ++index);
+	if(node < 0 || index < THREAD_MAX_CPUS / 64){
+		return 0;
+	}
+	sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+	fd = fopen(path, "r");
+	if(fd == NULL){
+		WARNINGPRINT("Numa node %d is not found", node);
+		return -1;
+	}
+	if(fgets(cpulist, sizeof(cpulist), fd) == NULL){
+		cpulist[0] = '\0';
+	}
+	fclose(fd);
+	return threadattrs_set_cpus(attrs, cpulist) < 0 ? -1 : 0;
+}
+
+int32_t threadattrs_set_sched(threadattrs_t *attrs, int32_t policy, int32_t priority)
+{
+	if(policy != SCHED_OTHER && policy != SCHED_FIFO && policy != SCHED_RR){
+		WARNINGPRINT("Unknown scheduling policy: %d", policy);
+		return -1;
+	}
+	if(priority < sched_get_priority_min(policy) || sched_get_priority_max(policy) < priority){
+		WARNINGPRINT("Priority %d is out of the range of the scheduling policy", priority);
+		return -1;
+	}
+	attrs->sched_policy = policy;
+	attrs->sched_priority = priority;
+	return 0;
+}
+
+int32_t threadattrs_parse_sched_policy(const char_t *name)
+{
+	if(strcasecmp(name, "fifo") == 0){
+		return SCHED_FIFO;
+	}
+	if(strcasecmp(name, "rr") == 0){
+		return SCHED_RR;
+	}
+	if(strcasecmp(name, "other") == 0){
+		return SCHED_OTHER;
+	}
+	return -1;
+}
+
+#ifndef MPOL_DEFAULT
+#define MPOL_DEFAULT   0
+#define MPOL_PREFERRED 1
+#endif
+
+//sets where the pages the calling thread touches first are allocated,
+//threads started afterwards inherit it. -1 restores the default.
+void numa_set_preferred(int32_t node)
+{
+	unsigned long nodemask = 0;
+	long          result;
+	if(node >= (int32_t) (sizeof(nodemask) * 8)){
+		WARNINGPRINT("Numa node %d is out of range", node);
+		return;
+	}
+#ifdef SYS_set_mempolicy
+	if(node < 0){
+		result = syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+	}else{
+		nodemask = 1UL << node;
+		result = syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8 + 1);
+	}
+#else
+	result = -1;
+#endif
+	if(result != 0){
+		DEBUGPRINT("Memory policy for numa node %d can not be set", node);
+	}
+}
+
+static void _thread_apply_attrs(thread_t *thread)
+{
+	cpu_set_t          cpuset;
+	struct sched_param param;
+	bool_t             bound = BOOL_FALSE;
+	int32_t            cpu;
+	CPU_ZERO(&cpuset);
+	for(cpu = 0; cpu < THREAD_MAX_CPUS; ++cpu){
+		if(thread->attrs.cpus[cpu / 64] & (1ULL << (cpu % 64))){
+			CPU_SET(cpu, &cpuset);
+			bound = BOOL_TRUE;
+		}
+	}
+	if(bound){
+		pthread_attr_setaffinity_np(&(thread->handler_attr), sizeof(cpuset), &cpuset);
+	}
+	if(thread->attrs.sched_policy != SCHED_OTHER){
+		param.sched_priority = thread->attrs.sched_priority;
+		pthread_attr_setinheritsched(&(thread->handler_attr), PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&(thread->handler_attr), thread->attrs.sched_policy);
+		pthread_attr_setschedparam(&(thread->handler_attr), &param);
+	}
+}
+
 void start_thread(thread_t* thread)
 {
 	if(thread == NULL || thread->state != THREAD_STATE_READY){
@@ -308,6 +1325,12 @@ void start_thread(thread_t* thread)
 		return;
 	}
 	thread->state = THREAD_STATE_STARTED;
+	if(thread->executor){
+		thread->thread_id = 0;
+		executor_submit(thread->executor, thread->process, thread);
+		return;
+	}
+	_thread_apply_attrs(thread);
 	thread->thread_id =
 			pthread_create(
 				&(thread->handler),       /*the thread handler*/
@@ -315,26 +1338,89 @@ void start_thread(thread_t* thread)
 				thread->process,          /*the main process of the thread*/
 				(void*)thread             /*the argument the thread main process will gets.*/
 			);
+	if(thread->thread_id == 0){
+		return;
+	}
+	//realtime priorities need privileges, run the thread anyway with the defaults
+	WARNINGPRINT("Thread placement or scheduling is not permitted, the thread starts with the defaults");
+	pthread_attr_destroy(&(thread->handler_attr));
+	pthread_attr_init(&(thread->handler_attr));
+	pthread_attr_setdetachstate(&(thread->handler_attr), PTHREAD_CREATE_JOINABLE);
+	thread->thread_id = pthread_create(&(thread->handler), &(thread->handler_attr), thread->process, (void*)thread);
 }
 
 
-void stop_thread(thread_t* thread)
+//returns BOOL_FALSE if the thread is a task that has not observed the stop
+//in time, its memory is still used by the executor and must not be freed
+bool_t stop_thread(thread_t* thread)
 {
-	int32_t       wait = 0;
-	const int32_t wait_limit = 10;
-	if(thread == NULL || thread->state != THREAD_STATE_RUN ){
+	int32_t        wait = 0;
+	const int32_t  wait_limit = 10;
+	thread_state_t state;
+	//a retired thread may still be waiting for its next item,
+	//a started task may still be waiting in the queue of its executor
+	if(thread == NULL){
+		WARNINGPRINT("Thread stop is called and the desired thread is not exists");
+		return BOOL_FALSE;
+	}
+	state = thread->state;
+	if(state != THREAD_STATE_STARTED && state != THREAD_STATE_RUN && state != THREAD_STATE_STOP){
 		WARNINGPRINT("Thread stop is called and the desired thread is not in run state");
-		return;
+		return BOOL_FALSE;
+	}
+	//the thread may turn from STARTED to RUN meanwhile
+	while(state == THREAD_STATE_STARTED || state == THREAD_STATE_RUN){
+		__sync_bool_compare_and_swap(&thread->state, state, THREAD_STATE_STOP);
+		state = thread->state;
 	}
-	thread->state = THREAD_STATE_STOP;
 	while(thread->state != THREAD_STATE_STOPPED && wait++ < wait_limit){
 		thread_sleep(50);
 	}
-	if(wait >= wait_limit){
+	if(thread->state != THREAD_STATE_STOPPED){
+		//a task can not be cancelled, it stops at the beginning of its next run
+		if(thread->executor){
+			WARNINGPRINT("task is not stopped in time");
+			return BOOL_FALSE;
+		}
 		WARNINGPRINT("thread must be cancelled");
 		pthread_cancel(thread->handler);
 	}
 	thread->state = THREAD_STATE_READY;
+	return BOOL_TRUE;
+}
+
+//asks the thread to stop without waiting for it, the thread is STOPPED
+//after its main process has returned
+void retire_thread(thread_t* thread)
+{
+	__sync_bool_compare_and_swap(&thread->state, THREAD_STATE_RUN, THREAD_STATE_STOP);
+}
+
+//joins the thread if it has exited, without waiting for it
+bool_t thread_tryjoin(thread_t* thread)
+{
+	if(thread->state != THREAD_STATE_STOPPED || thread->executor){
+		return BOOL_FALSE;
+	}
+	return pthread_tryjoin_np(thread->handler, NULL) == 0;
+}
+
+//joins a stopped or cancelled thread, BOOL_FALSE if it has not exited in ms,
+//a thread blocked where it can not be cancelled must not be disposed then
+bool_t thread_timedjoin(thread_t* thread, int32_t ms)
+{
+	struct timespec deadline;
+	if(thread->executor){
+		return BOOL_FALSE;
+	}
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += ms / 1000;
+	deadline.tv_nsec += (ms % 1000) * 1000000L;
+	if(1000000000L <= deadline.tv_nsec){
+		deadline.tv_sec += 1;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	return pthread_timedjoin_np(thread->handler, NULL, &deadline) == 0;
 }
 
 void thread_dtor(void *thread)
@@ -345,11 +1431,444 @@ void thread_dtor(void *thread)
 		return;
 	}
 	target = (thread_t*) thread;
-	if(target->state == THREAD_STATE_RUN){
-		stop_thread(target);
+	if(target->state == THREAD_STATE_STARTED || target->state == THREAD_STATE_RUN ||
+	   (target->state == THREAD_STATE_STOP && target->executor)){
+		if(!stop_thread(target) && target->executor){
+			WARNINGPRINT("task is still queued, the thread is not freed");
+			return;
+		}
 	}
 	pthread_attr_destroy(&(target->handler_attr));
 	target->process = NULL;
 	target->thread_id = -1;
 	free(target);
 }
+
+
+
+static __thread executor_t *_executor_current = NULL;   ///< executor of the calling worker
+static __thread int32_t     _executor_index = -1;       ///< deque index of the calling worker
+
+static bool_t _taskdeque_push(taskdeque_t *deque, task_t *task)
+{
+	int64_t bottom, top;
+	bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+	top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+	if(bottom - top >= EXECUTOR_DEQUE_SIZE){
+		return BOOL_FALSE;
+	}
+	__atomic_store_n(&deque->tasks[bottom & (EXECUTOR_DEQUE_SIZE - 1)], task, __ATOMIC_RELAXED);
+	__atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+	return BOOL_TRUE;
+}
+
+static task_t* _taskdeque_pop(taskdeque_t *deque)
+{
+	int64_t bottom, top;
+	task_t *result;
+	bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+	__atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+	if(bottom < top){
+		__atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+	result = __atomic_load_n(&deque->tasks[bottom & (EXECUTOR_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+	if(top == bottom){
+		//the last task, race with the thieves for it
+		if(!__atomic_compare_exchange_n(&deque->top, &top, top + 1, BOOL_FALSE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)){
+			result = NULL;
+		}
+		__atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+	}
+	return result;
+}
+
+static task_t* _taskdeque_steal(taskdeque_t *deque)
+{
+	int64_t bottom, top;
+	task_t *result;
+	top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+	if(bottom <= top){
+		return NULL;
+	}
+	result = __atomic_load_n(&deque->tasks[top & (EXECUTOR_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+	if(!__atomic_compare_exchange_n(&deque->top, &top, top + 1, BOOL_FALSE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)){
+		return NULL;
+	}
+	return result;
+}
+
+static void _executor_inject(executor_t *executor, task_t *task)
+{
+	task->next = NULL;
+	spin_lock(executor->injected_lock);
+	if(executor->injected_last){
+		executor->injected_last->next = task;
+	}else{
+		__atomic_store_n(&executor->injected_first, task, __ATOMIC_RELAXED);
+	}
+	executor->injected_last = task;
+	spin_unlock(executor->injected_lock);
+}
+
+static task_t* _executor_take_injected(executor_t *executor)
+{
+	task_t *result;
+	if(!__atomic_load_n(&executor->injected_first, __ATOMIC_RELAXED)){
+		return NULL;
+	}
+	spin_lock(executor->injected_lock);
+	result = executor->injected_first;
+	if(result){
+		__atomic_store_n(&executor->injected_first, result->next, __ATOMIC_RELAXED);
+		if(!executor->injected_first){
+			executor->injected_last = NULL;
+		}
+	}
+	spin_unlock(executor->injected_lock);
+	return result;
+}
+
+static void _executor_push(executor_t *executor, task_t *task, bool_t local)
+{
+	__atomic_add_fetch(&executor->pending, 1, __ATOMIC_SEQ_CST);
+	if(!local || _executor_current != executor || !_taskdeque_push(&executor->deques[_executor_index], task)){
+		_executor_inject(executor, task);
+	}
+	if(__atomic_load_n(&executor->idle, __ATOMIC_SEQ_CST)){
+		signal_lock(executor->signal);
+		signal_set(executor->signal);
+		signal_unlock(executor->signal);
+	}
+}
+
+static task_t* _executor_take(executor_t *executor, int32_t index)
+{
+	task_t *result;
+	int32_t i, victim;
+	result = _taskdeque_pop(&executor->deques[index]);
+	if(!result){
+		result = _executor_take_injected(executor);
+	}
+	for(i = 1; !result && i < executor->workers_num; ++i){
+		victim = (index + i) % executor->workers_num;
+		result = _taskdeque_steal(&executor->deques[victim]);
+	}
+	if(result){
+		__atomic_sub_fetch(&executor->pending, 1, __ATOMIC_SEQ_CST);
+	}
+	return result;
+}
+
+executor_t* executor_ctor(int32_t workers_num)
+{
+	executor_t* result;
+	if(workers_num < 1){
+		workers_num = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if(workers_num < 1){
+		workers_num = 1;
+	}
+	result = (executor_t*) malloc(sizeof(executor_t));
+	BZERO(result, sizeof(executor_t));
+	result->workers_num = workers_num;
+	result->workers = (thread_t**) calloc(workers_num, sizeof(thread_t*));
+	result->deques = (taskdeque_t*) calloc(workers_num, sizeof(taskdeque_t));
+	result->injected_lock = spin_ctor();
+	result->signal = signal_ctor();
+	return result;
+}
+
+void executor_dtor(executor_t *executor)
+{
+	task_t *task;
+	int32_t i;
+	if(executor == NULL){
+		return;
+	}
+	//the workers are owned by the thread table and have to be disposed before
+	for(i = 0; i < executor->workers_num; ++i){
+		while((task = _taskdeque_pop(&executor->deques[i])) != NULL){
+			free(task);
+		}
+	}
+	while((task = _executor_take_injected(executor)) != NULL){
+		free(task);
+	}
+	spin_dtor(executor->injected_lock);
+	free((void*) executor->injected_lock);
+	signal_dtor(executor->signal);
+	free(executor->deques);
+	free(executor->workers);
+	free(executor);
+}
+
+void executor_submit(executor_t *executor, void *(*process)(void*), void *arg)
+{
+	task_t *task;
+	task = (task_t*) malloc(sizeof(task_t));
+	task->process = process;
+	task->arg = arg;
+	task->next = NULL;
+	_executor_push(executor, task, BOOL_TRUE);
+}
+
+void* executor_worker_process(void *arg)
+{
+	thread_t   *thread = (thread_t*) arg;
+	executor_t *executor = (executor_t*) thread->arg;
+	task_t     *task;
+	int32_t     index;
+
+	for(index = 0; index < executor->workers_num && executor->workers[index] != thread; ++index);
+	if(index == executor->workers_num){
+		WARNINGPRINT("The worker thread is not found in its executor");
+		thread->state = THREAD_STATE_STOPPED;
+		return NULL;
+	}
+	_executor_current = executor;
+	_executor_index = index;
+	thread->state = THREAD_STATE_RUN;
+	while(thread->state == THREAD_STATE_RUN){
+		task = _executor_take(executor, index);
+		if(task){
+			if(task->process(task->arg) != NULL){
+				//rescheduled tasks queue up behind the others instead of running again at once
+				_executor_push(executor, task, BOOL_FALSE);
+			}else{
+				free(task);
+			}
+			continue;
+		}
+		signal_lock(executor->signal);
+		__atomic_add_fetch(&executor->idle, 1, __ATOMIC_SEQ_CST);
+		if(!__atomic_load_n(&executor->pending, __ATOMIC_SEQ_CST) && thread->state == THREAD_STATE_RUN){
+			signal_timedwait(executor->signal, EXECUTOR_IDLE_WAIT_MS);
+		}
+		__atomic_sub_fetch(&executor->idle, 1, __ATOMIC_SEQ_CST);
+		signal_unlock(executor->signal);
+	}
+	_executor_current = NULL;
+	_executor_index = -1;
+	thread->state = THREAD_STATE_STOPPED;
+	return NULL;
+}
+
+static volatile int32_t _executor_test_runs = 0;
+static volatile int32_t _executor_test_inits = 0;
+static volatile int32_t _executor_test_deinits = 0;
+
+static void* _executor_test_once(void *arg __attribute__((unused)))
+{
+	__atomic_add_fetch(&_executor_test_runs, 1, __ATOMIC_SEQ_CST);
+	return NULL;
+}
+
+//runs again until its counter is used up
+static void* _executor_test_again(void *arg)
+{
+	int32_t *left = (int32_t*) arg;
+	int32_t result = --(*left);
+	__atomic_add_fetch(&_executor_test_runs, 1, __ATOMIC_SEQ_CST);
+	return result > 0 ? arg : NULL;
+}
+
+static void _executor_test_init(thread_t *thread __attribute__((unused)))
+{
+	__atomic_add_fetch(&_executor_test_inits, 1, __ATOMIC_SEQ_CST);
+}
+
+static void _executor_test_main(thread_t *thread __attribute__((unused)))
+{
+	__atomic_add_fetch(&_executor_test_runs, 1, __ATOMIC_SEQ_CST);
+	thread_sleep(1);
+}
+
+static void _executor_test_deinit(thread_t *thread __attribute__((unused)))
+{
+	__atomic_add_fetch(&_executor_test_deinits, 1, __ATOMIC_SEQ_CST);
+}
+
+LIB_DEF_TASK(_executor_test_task, _executor_test_init, _executor_test_main, _executor_test_deinit);
+
+static bool_t _executor_test_wait(volatile int32_t *value, int32_t expected)
+{
+	int32_t waited;
+	for(waited = 0; *value < expected && waited < 5000; waited += 10){
+		thread_sleep(10);
+	}
+	return *value == expected;
+}
+
+void executor_test(void)
+{
+	int32_t      failed = 0;
+	int32_t      i, again;
+	taskdeque_t *deque;
+	task_t      *tasks;
+	executor_t  *executor;
+	thread_t    *task;
+
+	//the local deque at its empty and full boundaries and across the wrap of its indexes
+	deque = (taskdeque_t*) malloc(sizeof(taskdeque_t));
+	BZERO(deque, sizeof(taskdeque_t));
+	tasks = (task_t*) calloc(2 * EXECUTOR_DEQUE_SIZE, sizeof(task_t));
+	if(_taskdeque_pop(deque) != NULL || _taskdeque_steal(deque) != NULL){
+		++failed;
+	}
+	for(i = 0; i < EXECUTOR_DEQUE_SIZE; ++i){
+		failed += !_taskdeque_push(deque, &tasks[i]);
+	}
+	if(_taskdeque_push(deque, &tasks[EXECUTOR_DEQUE_SIZE])){
+		++failed;
+	}
+	if(_taskdeque_pop(deque) != &tasks[EXECUTOR_DEQUE_SIZE - 1] || _taskdeque_steal(deque) != &tasks[0]){
+		++failed;
+	}
+	for(i = 1; i < EXECUTOR_DEQUE_SIZE / 2; ++i){
+		failed += _taskdeque_steal(deque) != &tasks[i];
+	}
+	for(i = EXECUTOR_DEQUE_SIZE; i < EXECUTOR_DEQUE_SIZE + EXECUTOR_DEQUE_SIZE / 2 + 1; ++i){
+		failed += !_taskdeque_push(deque, &tasks[i]);
+	}
+	if(_taskdeque_push(deque, &tasks[i])){
+		++failed;
+	}
+	for(i = EXECUTOR_DEQUE_SIZE / 2; i < EXECUTOR_DEQUE_SIZE - 1; ++i){
+		failed += _taskdeque_steal(deque) != &tasks[i];
+	}
+	for(i = EXECUTOR_DEQUE_SIZE + EXECUTOR_DEQUE_SIZE / 2; i >= EXECUTOR_DEQUE_SIZE; --i){
+		failed += _taskdeque_pop(deque) != &tasks[i];
+	}
+	if(_taskdeque_pop(deque) != NULL || _taskdeque_steal(deque) != NULL){
+		++failed;
+	}
+	free(tasks);
+	free(deque);
+	printf("executor_test: deque boundaries: %s\n", failed ? "FAILED" : "passed");
+
+	//a task stopped while it is still queued must not run its init or deinit
+	executor = executor_ctor(2);
+	task = thread_ctor();
+	setup_thread(task, _executor_test_task, NULL);
+	task->executor = executor;
+	start_thread(task);
+	if(stop_thread(task) || task->state != THREAD_STATE_STOP){
+		++failed;
+	}
+	for(i = 0; i < executor->workers_num; ++i){
+		executor->workers[i] = thread_ctor();
+		setup_thread(executor->workers[i], executor_worker_process, executor);
+	}
+	for(i = 0; i < executor->workers_num; ++i){
+		start_thread(executor->workers[i]);
+	}
+	for(i = 0; i < 500 && task->state != THREAD_STATE_STOPPED; ++i){
+		thread_sleep(10);
+	}
+	if(task->state != THREAD_STATE_STOPPED || _executor_test_inits || _executor_test_deinits || _executor_test_runs){
+		++failed;
+	}
+	thread_dtor(task);
+
+	//tasks submitted from outside the workers, some of them rescheduled
+	again = 100;
+	executor_submit(executor, _executor_test_again, &again);
+	for(i = 0; i < 2 * EXECUTOR_DEQUE_SIZE; ++i){
+		executor_submit(executor, _executor_test_once, NULL);
+	}
+	if(!_executor_test_wait(&_executor_test_runs, 2 * EXECUTOR_DEQUE_SIZE + 100) || again){
+		++failed;
+	}
+
+	//a running task is stopped after its init and runs its deinit once
+	_executor_test_runs = 0;
+	task = thread_ctor();
+	setup_thread(task, _executor_test_task, NULL);
+	task->executor = executor;
+	start_thread(task);
+	_executor_test_wait(&_executor_test_runs, 10);
+	if(!stop_thread(task) || task->state != THREAD_STATE_READY || _executor_test_inits != 1 || _executor_test_deinits != 1){
+		++failed;
+	}
+	thread_dtor(task);
+
+	for(i = 0; i < executor->workers_num; ++i){
+		stop_thread(executor->workers[i]);
+		pthread_join(executor->workers[i]->handler, NULL);
+		thread_dtor(executor->workers[i]);
+	}
+	executor_dtor(executor);
+	printf("executor_test: %s\n", failed ? "FAILED" : "passed");
+}
+
+
+threadscaler_t* threadscaler_ctor(int32_t min_workers, int32_t max_workers)
+{
+	threadscaler_t *result;
+	result = (threadscaler_t*) malloc(sizeof(threadscaler_t));
+	BZERO(result, sizeof(threadscaler_t));
+	result->min_workers = min_workers < 1 ? 1 : min_workers;
+	result->max_workers = max_workers < result->min_workers ? result->min_workers : max_workers;
+	result->period_ms = THREADSCALER_PERIOD_MS;
+	result->grow_depth = THREADSCALER_GROW_DEPTH;
+	result->shrink_depth = THREADSCALER_SHRINK_DEPTH;
+	result->grow_samples = THREADSCALER_GROW_SAMPLES;
+	result->shrink_samples = THREADSCALER_IDLE_SAMPLES;
+	return result;
+}
+
+void threadscaler_dtor(threadscaler_t *scaler)
+{
+	free(scaler);
+}
+
+//called by the workers with the time they spent on an item, in any unit
+void threadscaler_report(threadscaler_t *scaler, uint64_t latency)
+{
+	__atomic_add_fetch(&scaler->latency_sum, latency, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&scaler->latency_num, 1, __ATOMIC_RELAXED);
+}
+
+//called by the supervisor in every period with the number of the running
+//workers and the depth of their queue, returns the number of workers to
+//add, or to retire if it is negative
+int32_t threadscaler_sample(threadscaler_t *scaler, int32_t workers_num, int32_t depth)
+{
+	uint64_t latency_sum, latency_num, latency = 0;
+	bool_t   overloaded, idle;
+
+	latency_sum = __atomic_exchange_n(&scaler->latency_sum, 0, __ATOMIC_RELAXED);
+	latency_num = __atomic_exchange_n(&scaler->latency_num, 0, __ATOMIC_RELAXED);
+	if(latency_num){
+		latency = latency_sum / latency_num;
+	}
+	scaler->workers_num = workers_num;
+	if(workers_num < scaler->min_workers){
+		return scaler->min_workers - workers_num;
+	}
+	if(scaler->max_workers < workers_num){
+		return scaler->max_workers - workers_num;
+	}
+
+	overloaded = scaler->grow_depth * workers_num < depth ||
+			(scaler->grow_latency && scaler->grow_latency < latency);
+	idle = depth <= scaler->shrink_depth * (workers_num - 1) &&
+			(!scaler->grow_latency || latency < scaler->grow_latency / 2);
+	scaler->overloaded = overloaded ? scaler->overloaded + 1 : 0;
+	scaler->idle = idle ? scaler->idle + 1 : 0;
+
+	if(scaler->grow_samples <= scaler->overloaded && workers_num < scaler->max_workers){
+		scaler->overloaded = 0;
+		return 1;
+	}
+	if(scaler->shrink_samples <= scaler->idle && scaler->min_workers < workers_num){
+		scaler->idle = 0;
+		return -1;
+	}
+	return 0;
+}
@@ -5,9 +5,23 @@
 #include "lib_defs.h"
 //#include "lib_descs.h"
 #include <pthread.h>
+#include <time.h>
 
 #define NTRT_USE_SPINLOCK
 
+#define EXECUTOR_DEQUE_SIZE       1024   ///< tasks a worker keeps locally, must be a power of two
+#define EXECUTOR_IDLE_WAIT_MS     100    ///< idle workers check their thread state this often
+#define THREAD_MAX_CPUS           256    ///< cpus a thread affinity can refer to
+#define TICKETLOCK_BACKOFF        64     ///< pauses per thread ahead of a ticket lock waiter
+#define ADAPTIVELOCK_SPIN_LIMIT   1024   ///< pauses an adaptive lock waiter spins before yielding
+#define EBR_MAX_THREADS           256    ///< threads taking part in the epoch based reclamation at the same time
+#define EBR_RECLAIM_THRESHOLD     64     ///< objects a thread retires before it tries to free them
+#define THREADSCALER_PERIOD_MS    100    ///< time between two samples of a thread scaler
+#define THREADSCALER_GROW_DEPTH   8      ///< queued items per worker taken as overload
+#define THREADSCALER_SHRINK_DEPTH 1      ///< queued items per worker taken as idle
+#define THREADSCALER_GROW_SAMPLES 2      ///< overloaded samples in a row before a worker is added
+#define THREADSCALER_IDLE_SAMPLES 30     ///< idle samples in a row before a worker is retired
+
 typedef pthread_spinlock_t    spin_t;
 typedef pthread_mutex_t       mutex_t;
 typedef pthread_cond_t        cond_t;
@@ -16,14 +30,92 @@ typedef pthread_attr_t        threader_attr_t;
 typedef pthread_rwlock_t      rwmutex_t;
 typedef pthread_rwlockattr_t  rwmutex_attr_t;
 
+struct fiber_struct_t;
+
+//fibers waiting on a signal or an eventcount, they park instead of
+//blocking the worker thread, see lib_fiber
+typedef struct fiberwaitq_struct_t
+{
+	volatile int32_t        lock;
+	struct fiber_struct_t  *first;
+	struct fiber_struct_t  *last;
+}fiberwaitq_t;
+
 typedef struct signal_struct_t
 {
 	mutex_t           *mutex;
 	cond_t             cond;
 	volatile bool_t    waiting;
 	volatile int32_t   waiters;
+	fiberwaitq_t       fibers;
 }signal_t;
 
+//Futex based eventcount: a waiter takes a key by eventcount_prepare_wait,
+//checks its condition and then commits or cancels the wait. Notifying
+//costs no syscall while nobody waits.
+typedef struct eventcount_struct_t
+{
+	volatile uint32_t  epoch;     ///< the futex word, changed by notifies finding waiters
+	volatile int32_t   waiters;
+	int32_t            spins;     ///< polls of the epoch before the waiter sleeps
+	fiberwaitq_t       fibers;
+}eventcount_t;
+
+//counters of a lock, collected only if the lock has them
+typedef struct lockstats_struct_t
+{
+	volatile uint64_t  acquisitions;
+	volatile uint64_t  contended;     ///< acquisitions which had to wait
+	volatile uint64_t  spin_cycles;   ///< cpu cycles the contended acquisitions waited
+}lockstats_t;
+
+//fair spin lock: waiters are served in the order they arrived
+typedef struct ticketlock_struct_t
+{
+	volatile uint32_t  next;
+	volatile uint32_t  owner;
+	lockstats_t       *stats;
+}ticketlock_t;
+
+//queued spin lock: every waiter spins on its own node, given by the caller
+typedef struct mcsnode_struct_t
+{
+	struct mcsnode_struct_t *volatile next;
+	volatile bool_t                   locked;
+}mcsnode_t;
+
+typedef struct mcslock_struct_t
+{
+	mcsnode_t *volatile  tail;
+	lockstats_t         *stats;
+}mcslock_t;
+
+//spins with exponential backoff and yields the cpu if it waits long
+typedef struct adaptivelock_struct_t
+{
+	volatile int32_t   locked;
+	lockstats_t       *stats;
+}adaptivelock_t;
+
+//an object unlinked from a shared structure, freed after a grace period
+typedef struct ebrretired_struct_t
+{
+	void                        *ptr;
+	void                       (*disposer)(void*);
+	uint64_t                     epoch;
+	struct ebrretired_struct_t  *next;
+}ebrretired_t;
+
+//a thread taking part in the epoch based reclamation, on its own cache line
+typedef struct ebrrecord_struct_t
+{
+	volatile uint64_t  epoch;         ///< the epoch the thread reads in, 0 if it is not reading
+	volatile int32_t   used;
+	int32_t            depth;
+	ebrretired_t      *retired;       ///< objects the thread retired and not freed yet
+	int32_t            retired_num;
+} __attribute__((aligned(64))) ebrrecord_t;
+
 typedef struct barrier_struct_t
 {
 	uint32_t         gatenum;
@@ -41,6 +133,17 @@ typedef enum{
 	THREAD_STATE_STOPPED = 6,
 }thread_state_t;
 
+struct executor_struct_t;
+
+//placement and scheduling of a thread, applied when the thread is started
+typedef struct threadattrs_struct_t
+{
+	uint64_t         cpus[THREAD_MAX_CPUS / 64];   ///< cpus the thread may run on, none set means all
+	int32_t          numa_node;                    ///< -1 if the thread is not bound to a node
+	int32_t          sched_policy;                 ///< SCHED_OTHER, SCHED_FIFO or SCHED_RR
+	int32_t          sched_priority;
+}threadattrs_t;
+
 typedef struct thread_struct_t
 {
 	int32_t          thread_id;
@@ -49,8 +152,61 @@ typedef struct thread_struct_t
 	volatile thread_state_t state;
 	void *(*process)(void*);
 	void *arg;
+	struct executor_struct_t *executor;   ///< if set the process runs as repeated tasks of the executor
+	volatile bool_t  initialized;         ///< the init procedure of the task has run
+	threadattrs_t    attrs;
 } thread_t;
 
+typedef struct task_struct_t
+{
+	void                 *(*process)(void*);   ///< the task is scheduled again while it returns non-NULL
+	void                 *arg;
+	struct task_struct_t *next;
+}task_t;
+
+//Chase-Lev deque: the owner worker pushes and pops at the bottom, the others steal from the top
+typedef struct taskdeque_struct_t
+{
+	volatile int64_t  top;
+	char              padding[64 - sizeof(int64_t)];
+	volatile int64_t  bottom;
+	task_t           *tasks[EXECUTOR_DEQUE_SIZE];
+}taskdeque_t;
+
+typedef struct executor_struct_t
+{
+	int32_t           workers_num;
+	thread_t        **workers;
+	taskdeque_t      *deques;
+	spin_t           *injected_lock;
+	task_t           *injected_first;   ///< tasks submitted from outside of the workers
+	task_t           *injected_last;
+	volatile int32_t  pending;          ///< tasks waiting in the deques and the injected list
+	volatile int32_t  idle;             ///< workers waiting on the signal
+	signal_t         *signal;
+}executor_t;
+
+//Decides on the number of workers serving a queue. Load counts as overload
+//or idle only if it stays so for several samples in a row, and the depth
+//taken as idle is far below the one taken as overload, so the number of
+//workers does not flap.
+typedef struct threadscaler_struct_t
+{
+	int32_t           min_workers;
+	int32_t           max_workers;
+	int32_t           period_ms;
+	int32_t           grow_depth;        ///< queued items per worker
+	int32_t           shrink_depth;
+	uint64_t          grow_latency;      ///< mean reported latency taken as overload, 0 if it is not considered
+	int32_t           grow_samples;
+	int32_t           shrink_samples;
+	int32_t           overloaded;        ///< samples in a row
+	int32_t           idle;
+	volatile uint64_t latency_sum;       ///< reported since the last sample
+	volatile uint64_t latency_num;
+	volatile int32_t  workers_num;
+}threadscaler_t;
+
 mutex_t* mutex_ctor();
 void mutex_dtor(void *mutex);
 void mutex_lock(mutex_t* mutex);
@@ -66,10 +222,54 @@ void signal_dtor(signal_t *signal);
 void signal_set(signal_t *signal);
 void signal_setall(signal_t *signal);
 void signal_wait(signal_t *signal);
+void signal_timedwait(signal_t *signal, int32_t ms);
 void signal_lock(signal_t *signal);
 void signal_unlock(signal_t *signal);
 void signal_release(signal_t *signal);
 
+eventcount_t* eventcount_ctor(int32_t spins);
+void eventcount_dtor(eventcount_t *eventcount);
+uint32_t eventcount_prepare_wait(eventcount_t *eventcount);
+void eventcount_cancel_wait(eventcount_t *eventcount);
+void eventcount_commit_wait(eventcount_t *eventcount, uint32_t key);
+void eventcount_commit_timedwait(eventcount_t *eventcount, uint32_t key, int32_t ms);
+void eventcount_notify(eventcount_t *eventcount);
+void eventcount_notify_all(eventcount_t *eventcount);
+void eventcount_test(void);
+
+lockstats_t* lockstats_ctor();
+void lockstats_dtor(lockstats_t *stats);
+void lockstats_print(const char_t *name, lockstats_t *stats);
+
+ticketlock_t* ticketlock_ctor();
+void ticketlock_dtor(ticketlock_t *lock);
+void ticketlock_lock(ticketlock_t *lock);
+bool_t ticketlock_trylock(ticketlock_t *lock);
+void ticketlock_unlock(ticketlock_t *lock);
+
+mcslock_t* mcslock_ctor();
+void mcslock_dtor(mcslock_t *lock);
+void mcslock_lock(mcslock_t *lock, mcsnode_t *node);
+void mcslock_unlock(mcslock_t *lock, mcsnode_t *node);
+
+adaptivelock_t* adaptivelock_ctor();
+void adaptivelock_dtor(adaptivelock_t *lock);
+void adaptivelock_lock(adaptivelock_t *lock);
+bool_t adaptivelock_trylock(adaptivelock_t *lock);
+void adaptivelock_unlock(adaptivelock_t *lock);
+void spinlocks_test(void);
+
+void ebr_thread_register();
+void ebr_thread_unregister();
+void ebr_enter();
+void ebr_leave();
+int32_t ebr_get_depth();
+void* ebr_read(void *volatile *slot);
+void ebr_publish(void *volatile *slot, void *version, void (*disposer)(void*));
+void ebr_retire(void *ptr, void (*disposer)(void*));
+void ebr_synchronize();
+void ebr_test(void);
+
 barrier_t* barrier_ctor();
 void barrier_dtor(barrier_t *barrier);
 int barrier_wait(barrier_t *barrier);
@@ -88,7 +288,55 @@ thread_t* thread_ctor();
 void thread_dtor(void *thread);
 
 void start_thread(thread_t*);
-void stop_thread(thread_t*);
+bool_t stop_thread(thread_t*);
+void retire_thread(thread_t*);
+bool_t thread_tryjoin(thread_t*);
+bool_t thread_timedjoin(thread_t*, int32_t ms);
 void setup_thread(thread_t*, void* (*)(void*), void*);
+void threadattrs_init(threadattrs_t *attrs);
+int32_t threadattrs_set_cpus(threadattrs_t *attrs, const char_t *cpulist);
+int32_t threadattrs_set_numa_node(threadattrs_t *attrs, int32_t node);
+int32_t threadattrs_set_sched(threadattrs_t *attrs, int32_t policy, int32_t priority);
+int32_t threadattrs_parse_sched_policy(const char_t *name);
+void numa_set_preferred(int32_t node);
+
+executor_t* executor_ctor(int32_t workers_num);
+void executor_dtor(executor_t *executor);
+void executor_submit(executor_t *executor, void *(*process)(void*), void *arg);
+void* executor_worker_process(void *arg);
+void executor_test(void);
+
+threadscaler_t* threadscaler_ctor(int32_t min_workers, int32_t max_workers);
+void threadscaler_dtor(threadscaler_t *scaler);
+void threadscaler_report(threadscaler_t *scaler, uint64_t latency);
+int32_t threadscaler_sample(threadscaler_t *scaler, int32_t workers_num, int32_t depth);
+
+//a fast, monotonic cycle counter of the cpu, nanoseconds where there is none
+static inline uint64_t cpu_cycles()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	uint32_t low, high;
+	__asm__ __volatile__("rdtsc" : "=a"(low), "=d"(high));
+	return ((uint64_t) high << 32) | low;
+#elif defined(__aarch64__)
+	uint64_t result;
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(result));
+	return result;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+//tells the cpu the caller spins, which frees resources for its sibling
+static inline void cpu_relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
 
 #endif //INCGUARD_NTRT_LIBRARY_THREADING_H_
@@ -97,7 +97,7 @@ void vector_shift(vector_t *v, void *elem)
 void vector_unshift(vector_t *v, void *elem)
 {
 	if (!VECTOR_HASSPACE(v))
-		vector_grow(v, v->items_num + 1);
+		vector_grow(v, 0);
 
 	memmove(VECTOR_INDEX(1), v->items, v->items_num * v->item_size);
 	memcpy(v->items, elem, v->item_size);
@@ -112,7 +112,7 @@ void vector_transpose(vector_t *v, size_t index1, size_t index2)
 
 void vector_grow(vector_t *v, size_t size)
 {
-	if (size > v->items_alloc_num)
+	if (size > v->items_alloc_num * 2)
 		v->items_alloc_num = size;
 	else
 		v->items_alloc_num *= 2;
@@ -193,3 +193,82 @@ void vector_swap(void *elemp1, void *elemp2, size_t elem_size)
 
              free(tmp); /* Thanks to gromit */
 }
+
+VECTOR_DEF(, vector_int32, int32_t, VECTOR_LESS)
+VECTOR_DEF_RADIX_SORT(, vector_int32, int32_t, uint32_t, radix_key_int32)
+VECTOR_DEF(, vector_uint32, uint32_t, VECTOR_LESS)
+VECTOR_DEF_RADIX_SORT(, vector_uint32, uint32_t, uint32_t, radix_key_uint32)
+VECTOR_DEF(, vector_int64, int64_t, VECTOR_LESS)
+VECTOR_DEF_RADIX_SORT(, vector_int64, int64_t, uint64_t, radix_key_int64)
+VECTOR_DEF(, vector_uint64, uint64_t, VECTOR_LESS)
+VECTOR_DEF_RADIX_SORT(, vector_uint64, uint64_t, uint64_t, radix_key_uint64)
+VECTOR_DEF(, vector_float, float, VECTOR_LESS)
+VECTOR_DEF_RADIX_SORT(, vector_float, float, uint32_t, radix_key_float)
+VECTOR_DEF(, vector_double, double, VECTOR_LESS)
+VECTOR_DEF_RADIX_SORT(, vector_double, double, uint64_t, radix_key_double)
+
+static int vector_test_cmp_int32(const void *a, const void *b)
+{
+	int32_t x = *(const int32_t *) a, y = *(const int32_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+static int vector_test_sorted(vector_int32_t *v, int32_t *expected)
+{
+	qsort(expected, v->length, sizeof(int32_t), vector_test_cmp_int32);
+	return v->length == 0 || memcmp(v->items, expected, v->length * sizeof(int32_t)) == 0;
+}
+
+/* sorts around the insertion sort limit, sorted, reversed and equal inputs,
+ * and the empty and single item vectors, with both sorts */
+void vector_test(void)
+{
+	size_t lengths[] = {0, 1, 2, VECTOR_INSERTION_SORT_LIMIT - 1, VECTOR_INSERTION_SORT_LIMIT,
+	                    VECTOR_INSERTION_SORT_LIMIT + 1, 1000, 4097};
+	vector_int32_t v, r;
+	vector_float_t f;
+	int32_t *expected;
+	uint32_t seed = 12345;
+	size_t i, l, pattern;
+	int failed = 0;
+
+	vector_int32_init(&v, 0);
+	vector_int32_init(&r, 1);
+	expected = (int32_t *) malloc(sizeof(int32_t) * 4097);
+	for (l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+		for (pattern = 0; pattern < 4; pattern++) {
+			vector_int32_clear(&v);
+			vector_int32_clear(&r);
+			for (i = 0; i < lengths[l]; i++) {
+				seed = seed * 1103515245 + 12345;
+				switch (pattern) {
+				case 0: expected[i] = (int32_t) seed; break;
+				case 1: expected[i] = (int32_t) i - 100; break;
+				case 2: expected[i] = (int32_t) (lengths[l] - i); break;
+				default: expected[i] = 7; break;
+				}
+				vector_int32_push(&v, expected[i]);
+				vector_int32_push(&r, expected[i]);
+			}
+			failed += v.length != lengths[l] || v.capacity < v.length;
+			vector_int32_sort(&v);
+			vector_int32_radix_sort(&r);
+			failed += !vector_test_sorted(&v, expected);
+			failed += !vector_test_sorted(&r, expected);
+		}
+	}
+	failed += vector_int32_pop(&v) != 7;
+	vector_float_init(&f, 0);
+	vector_float_push(&f, 1.5f);
+	vector_float_push(&f, -0.5f);
+	vector_float_push(&f, 0.0f);
+	vector_float_push(&f, -2.0f);
+	vector_float_radix_sort(&f);
+	failed += f.items[0] != -2.0f || f.items[1] != -0.5f || f.items[2] != 0.0f || f.items[3] != 1.5f;
+	vector_float_dispose(&f);
+	vector_int32_dispose(&v);
+	vector_int32_dispose(&r);
+	free(expected);
+	printf("vector_test: %s\n", failed ? "FAILED" : "passed");
+}
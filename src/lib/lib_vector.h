@@ -6,11 +6,14 @@
 #include <ctype.h>
 #include <string.h>
 #include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #define VECTOR_INIT_SIZE    4
 #define VECTOR_HASSPACE(v)  (((v)->items_num + 1) <= (v)->items_alloc_num)
 #define VECTOR_INBOUNDS(i)	(((int) i) >= 0 && (i) < (v)->items_num)
 #define VECTOR_INDEX(i)		((char *) (v)->items + ((v)->item_size * (i)))
+#define VECTOR_INSERTION_SORT_LIMIT 16
 
 typedef struct _vector {
 	void *items;
@@ -39,6 +42,259 @@ void vector_cmp_all(vector_t *, void *, int (*cmp_func)(const void *, const void
 void vector_qsort(vector_t *, int (*cmp_func)(const void *, const void *));
 void vector_grow(vector_t *, size_t);
 void vector_swap(void *, void *, size_t);
+void vector_test(void);
 
 
+/**
+ * Typed vectors.
+ *
+ * VECTOR_DECL(DECL_TYPE, NAME, TYPE) declares NAME_t holding TYPE items
+ * contiguously together with its functions, VECTOR_DEF(DECL_TYPE, NAME,
+ * TYPE, LESS) generates them. LESS(a, b) is expanded inline by the sort, so it can be a
+ * macro or a static inline function. Items are accessed directly through
+ * v->items[i] for i < v->length.
+ *
+ * VECTOR_DEF_RADIX_SORT(DECL_TYPE, NAME, TYPE, KEY_TYPE, RADIX_KEY) adds
+ * NAME_radix_sort(), a stable LSD radix sort. RADIX_KEY(item) must map the
+ * item to an unsigned KEY_TYPE (uint32_t or uint64_t) whose order matches
+ * the wanted item order; radix_key_*() below do it for the numeric types.
+ * Use it instead of NAME_sort() for large sets of numeric samples.
+ */
+
+#define VECTOR_LESS(a, b)	((a) < (b))
+
+static inline uint32_t radix_key_uint32(uint32_t x) { return x; }
+static inline uint32_t radix_key_int32(int32_t x) { return (uint32_t) x ^ 0x80000000u; }
+static inline uint64_t radix_key_uint64(uint64_t x) { return x; }
+static inline uint64_t radix_key_int64(int64_t x) { return (uint64_t) x ^ 0x8000000000000000ull; }
+
+static inline uint32_t radix_key_float(float x)
+{
+	uint32_t u;
+
+	memcpy(&u, &x, sizeof(u));
+	return (u & 0x80000000u) ? ~u : u | 0x80000000u;
+}
+
+static inline uint64_t radix_key_double(double x)
+{
+	uint64_t u;
+
+	memcpy(&u, &x, sizeof(u));
+	return (u & 0x8000000000000000ull) ? ~u : u | 0x8000000000000000ull;
+}
+
+#define VECTOR_DECL(DECL_TYPE, NAME, TYPE)                                              \
+	typedef struct NAME##_struct_t {                                                    \
+		TYPE *items;                                                                    \
+		size_t length;                                                                  \
+		size_t capacity;                                                                \
+	} NAME##_t;                                                                         \
+	DECL_TYPE void NAME##_init(NAME##_t *, size_t);                                     \
+	DECL_TYPE void NAME##_dispose(NAME##_t *);                                          \
+	DECL_TYPE void NAME##_reserve(NAME##_t *, size_t);                                  \
+	DECL_TYPE TYPE *NAME##_emplace(NAME##_t *);                                         \
+	DECL_TYPE void NAME##_push(NAME##_t *, TYPE);                                       \
+	DECL_TYPE TYPE NAME##_pop(NAME##_t *);                                              \
+	DECL_TYPE void NAME##_clear(NAME##_t *);                                            \
+	DECL_TYPE void NAME##_sort(NAME##_t *);
+
+#define VECTOR_DEF(DECL_TYPE, NAME, TYPE, LESS)                                         \
+	DECL_TYPE void NAME##_init(NAME##_t *v, size_t capacity)                            \
+	{                                                                                   \
+		v->length = 0;                                                                  \
+		v->capacity = capacity > 0 ? capacity : VECTOR_INIT_SIZE;                       \
+		v->items = (TYPE *) malloc(sizeof(TYPE) * v->capacity);                         \
+		assert(v->items != NULL);                                                       \
+	}                                                                                   \
+                                                                                        \
+	DECL_TYPE void NAME##_dispose(NAME##_t *v)                                          \
+	{                                                                                   \
+		free(v->items);                                                                 \
+		v->items = NULL;                                                                \
+		v->length = v->capacity = 0;                                                    \
+	}                                                                                   \
+                                                                                        \
+	DECL_TYPE void NAME##_reserve(NAME##_t *v, size_t capacity)                         \
+	{                                                                                   \
+		if (capacity <= v->capacity)                                                    \
+			return;                                                                     \
+		/* geometric growth keeps pushes amortized O(1) */                              \
+		if (capacity < v->capacity * 2)                                                 \
+			capacity = v->capacity * 2;                                                 \
+		v->items = (TYPE *) realloc(v->items, sizeof(TYPE) * capacity);                 \
+		assert(v->items != NULL);                                                       \
+		v->capacity = capacity;                                                         \
+	}                                                                                   \
+                                                                                        \
+	DECL_TYPE TYPE *NAME##_emplace(NAME##_t *v)                                         \
+	{                                                                                   \
+		if (v->length == v->capacity)                                                   \
+			NAME##_reserve(v, v->length + 1);                                           \
+		return &v->items[v->length++];                                                  \
+	}                                                                                   \
+                                                                                        \
+	DECL_TYPE void NAME##_push(NAME##_t *v, TYPE item)                                  \
+	{                                                                                   \
+		*NAME##_emplace(v) = item;                                                      \
+	}                                                                                   \
+                                                                                        \
+	DECL_TYPE TYPE NAME##_pop(NAME##_t *v)                                              \
+	{                                                                                   \
+		assert(v->length > 0);                                                          \
+		return v->items[--v->length];                                                   \
+	}                                                                                   \
+                                                                                        \
+	DECL_TYPE void NAME##_clear(NAME##_t *v)                                            \
+	{                                                                                   \
+		v->length = 0;                                                                  \
+	}                                                                                   \
+                                                                                        \
+	static void NAME##_insertion_sort(TYPE *items, size_t n)                            \
+	{                                                                                   \
+		size_t i, j;                                                                    \
+		TYPE tmp;                                                                       \
+                                                                                        \
+		for (i = 1; i < n; i++) {                                                       \
+			tmp = items[i];                                                             \
+			for (j = i; j > 0 && LESS(tmp, items[j - 1]); j--)                          \
+				items[j] = items[j - 1];                                                \
+			items[j] = tmp;                                                             \
+		}                                                                               \
+	}                                                                                   \
+                                                                                        \
+	static void NAME##_sift_down(TYPE *items, size_t root, size_t n)                    \
+	{                                                                                   \
+		size_t child;                                                                   \
+		TYPE tmp = items[root];                                                         \
+                                                                                        \
+		for (; (child = 2 * root + 1) < n; root = child) {                              \
+			if (child + 1 < n && LESS(items[child], items[child + 1]))                  \
+				child++;                                                                \
+			if (!LESS(tmp, items[child]))                                               \
+				break;                                                                  \
+			items[root] = items[child];                                                 \
+		}                                                                               \
+		items[root] = tmp;                                                              \
+	}                                                                                   \
+                                                                                        \
+	static void NAME##_heap_sort(TYPE *items, size_t n)                                 \
+	{                                                                                   \
+		size_t i;                                                                       \
+		TYPE tmp;                                                                       \
+                                                                                        \
+		for (i = n / 2; i > 0; i--)                                                     \
+			NAME##_sift_down(items, i - 1, n);                                          \
+		for (i = n - 1; i > 0; i--) {                                                   \
+			tmp = items[0];                                                             \
+			items[0] = items[i];                                                        \
+			items[i] = tmp;                                                             \
+			NAME##_sift_down(items, 0, i);                                              \
+		}                                                                               \
+	}                                                                                   \
+                                                                                        \
+	static void NAME##_introsort(TYPE *items, size_t n, size_t depth)                   \
+	{                                                                                   \
+		ptrdiff_t i, j;                                                                 \
+		TYPE pivot, tmp;                                                                \
+                                                                                        \
+		while (n > VECTOR_INSERTION_SORT_LIMIT) {                                       \
+			if (depth-- == 0) {                                                         \
+				NAME##_heap_sort(items, n);                                             \
+				return;                                                                 \
+			}                                                                           \
+			i = n / 2;                                                                  \
+			if (LESS(items[i], items[0])) {                                             \
+				tmp = items[i]; items[i] = items[0]; items[0] = tmp;                    \
+			}                                                                           \
+			if (LESS(items[n - 1], items[i])) {                                         \
+				tmp = items[i]; items[i] = items[n - 1]; items[n - 1] = tmp;            \
+				if (LESS(items[i], items[0])) {                                         \
+					tmp = items[i]; items[i] = items[0]; items[0] = tmp;                \
+				}                                                                       \
+			}                                                                           \
+			pivot = items[i];                                                           \
+			i = -1;                                                                     \
+			j = n;                                                                      \
+			for (;;) {                                                                  \
+				do i++; while (LESS(items[i], pivot));                                  \
+				do j--; while (LESS(pivot, items[j]));                                  \
+				if (i >= j)                                                             \
+					break;                                                              \
+				tmp = items[i]; items[i] = items[j]; items[j] = tmp;                    \
+			}                                                                           \
+			/* recurse into the smaller half, loop on the larger one */                 \
+			if ((size_t) j + 1 < n - j - 1) {                                           \
+				NAME##_introsort(items, j + 1, depth);                                  \
+				items += j + 1;                                                         \
+				n -= j + 1;                                                             \
+			} else {                                                                    \
+				NAME##_introsort(items + j + 1, n - j - 1, depth);                      \
+				n = j + 1;                                                              \
+			}                                                                           \
+		}                                                                               \
+		NAME##_insertion_sort(items, n);                                                \
+	}                                                                                   \
+                                                                                        \
+	DECL_TYPE void NAME##_sort(NAME##_t *v)                                             \
+	{                                                                                   \
+		size_t depth, n;                                                                \
+                                                                                        \
+		for (depth = 0, n = v->length; n > 0; n >>= 1)                                  \
+			depth += 2;                                                                 \
+		NAME##_introsort(v->items, v->length, depth);                                   \
+	}
+
+#define VECTOR_DEF_RADIX_SORT(DECL_TYPE, NAME, TYPE, KEY_TYPE, RADIX_KEY)               \
+	DECL_TYPE void NAME##_radix_sort(NAME##_t *v)                                       \
+	{                                                                                   \
+		TYPE *src = v->items, *dst, *tmp;                                               \
+		size_t counts[256], i, n = v->length, pos, cnt;                                 \
+		uint32_t shift;                                                                 \
+                                                                                        \
+		if (n < 2)                                                                      \
+			return;                                                                     \
+		dst = (TYPE *) malloc(sizeof(TYPE) * n);                                        \
+		assert(dst != NULL);                                                            \
+		for (shift = 0; shift < sizeof(KEY_TYPE) * 8; shift += 8) {                     \
+			memset(counts, 0, sizeof(counts));                                          \
+			for (i = 0; i < n; i++)                                                     \
+				counts[(RADIX_KEY(src[i]) >> shift) & 0xFF]++;                          \
+			/* every key has the same digit here, nothing to move */                    \
+			if (counts[(RADIX_KEY(src[0]) >> shift) & 0xFF] == n)                       \
+				continue;                                                               \
+			for (pos = 0, i = 0; i < 256; i++) {                                        \
+				cnt = counts[i];                                                        \
+				counts[i] = pos;                                                        \
+				pos += cnt;                                                             \
+			}                                                                           \
+			for (i = 0; i < n; i++)                                                     \
+				dst[counts[(RADIX_KEY(src[i]) >> shift) & 0xFF]++] = src[i];            \
+			tmp = src;                                                                  \
+			src = dst;                                                                  \
+			dst = tmp;                                                                  \
+		}                                                                               \
+		if (src != v->items) {                                                          \
+			memcpy(v->items, src, sizeof(TYPE) * n);                                    \
+			free(src);                                                                  \
+		} else {                                                                        \
+			free(dst);                                                                  \
+		}                                                                               \
+	}
+
+#define VECTOR_DECL_RADIX_SORT(DECL_TYPE, NAME)	DECL_TYPE void NAME##_radix_sort(NAME##_t *);
+
+VECTOR_DECL(extern, vector_int32, int32_t)
+VECTOR_DECL_RADIX_SORT(extern, vector_int32)
+VECTOR_DECL(extern, vector_uint32, uint32_t)
+VECTOR_DECL_RADIX_SORT(extern, vector_uint32)
+VECTOR_DECL(extern, vector_int64, int64_t)
+VECTOR_DECL_RADIX_SORT(extern, vector_int64)
+VECTOR_DECL(extern, vector_uint64, uint64_t)
+VECTOR_DECL_RADIX_SORT(extern, vector_uint64)
+VECTOR_DECL(extern, vector_float, float)
+VECTOR_DECL_RADIX_SORT(extern, vector_float)
+VECTOR_DECL(extern, vector_double, double)
+VECTOR_DECL_RADIX_SORT(extern, vector_double)
+
 #endif /* INCGUARD_NTRT_LIBRARY_VECTOR_H_ */
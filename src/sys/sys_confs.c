@@ -13,8 +13,66 @@
 #include "../lib/lib_makers.h"
 #include "lib_funcs.h"
 
-void conf_load_from_dictionary(dictionary *conf)
+#define CONF_THREAD_SECTION_PREFIX "thread_"
+
+//a [thread_<component unique name>] section places and schedules the thread of the component
+static void _conf_load_thread(dictionary *conf, char_t *section, sysdat_t *sysdat)
 {
+  threadconf_t *threadconf;
+  char_t        key[256];
+  char_t       *value;
+  int32_t       policy;
+
+  if(PROGRAM_MAX_THREADCONF_NUM <= sysdat->threadconfs_num){
+    WARNINGPRINT("Too many thread sections, %s is skipped", section);
+    return;
+  }
+  //the longest key is <section>:numa_node, a truncated one would read another section
+  if(sizeof(key) <= strlen(section) + strlen(":numa_node")){
+    WARNINGPRINT("Thread section name is too long, %s is skipped", section);
+    return;
+  }
+  threadconf = &sysdat->threadconfs[sysdat->threadconfs_num];
+  threadattrs_init(&threadconf->attrs);
+  strncpy(threadconf->name, section + strlen(CONF_THREAD_SECTION_PREFIX), PROGRAM_THREADCONF_NAME_LENGTH - 1);
+  threadconf->name[PROGRAM_THREADCONF_NAME_LENGTH - 1] = '\0';
+
+  snprintf(key, sizeof(key), "%s:cpus", section);
+  value = iniparser_getstring(conf, key, NULL);
+  if(value != NULL && threadattrs_set_cpus(&threadconf->attrs, value) < 0){
+    return;
+  }
+  snprintf(key, sizeof(key), "%s:numa_node", section);
+  if(threadattrs_set_numa_node(&threadconf->attrs, iniparser_getint(conf, key, -1)) < 0){
+    return;
+  }
+  snprintf(key, sizeof(key), "%s:policy", section);
+  value = iniparser_getstring(conf, key, "other");
+  policy = threadattrs_parse_sched_policy(value);
+  if(policy < 0){
+    WARNINGPRINT("Unknown scheduling policy in %s: %s", section, value);
+    return;
+  }
+  snprintf(key, sizeof(key), "%s:priority", section);
+  if(threadattrs_set_sched(&threadconf->attrs, policy, iniparser_getint(conf, key, 0)) < 0){
+    return;
+  }
+  ++sysdat->threadconfs_num;
+}
+
+//fills the copy of sysdat going to be published as the next version
+void conf_load_from_dictionary(dictionary *conf, sysdat_t *sysdat)
+{
+  int32_t  index;
+  char_t  *section;
+
+  sysdat->threadconfs_num = 0;
+  for(index = 0; index < iniparser_getnsec(conf); ++index){
+    section = iniparser_getsecname(conf, index);
+    if(strncmp(section, CONF_THREAD_SECTION_PREFIX, strlen(CONF_THREAD_SECTION_PREFIX)) == 0){
+      _conf_load_thread(conf, section, sysdat);
+    }
+  }
 
   INFOPRINT("Configuration setup complete");
 }
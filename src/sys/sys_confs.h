@@ -3,6 +3,6 @@
 #include "lib_descs.h"
 #include "etc_iniparser.h"
 
-void conf_load_from_dictionary(dictionary *conf);
+void conf_load_from_dictionary(dictionary *conf, sysdat_t *sysdat);
 
 #endif /* INCGUARD_SYS_CONFS_H_ */